@@ -0,0 +1,203 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL bump arena allocator
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <string>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
+#include "arena.h"
+using namespace std;
+
+/// @brief names of the allocation kinds, indexed by kind id
+static vector<string> KindNames;
+
+/// @brief protects KindNames
+static mutex KindMutex;
+
+
+//--------------------------------------------------------------------------------------------------
+// CArena
+//
+CArena::CArena(size_t block_size)
+  : _block_size(block_size), _blocks(NULL), _cur(NULL), _end(NULL), _allocated(0), _reserved(0)
+{
+  assert(block_size > sizeof(SBlock));
+}
+
+CArena::~CArena(void)
+{
+  Release();
+}
+
+void* CArena::Allocate(size_t size, size_t align, unsigned int kind)
+{
+  char *p = (char*)(((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1));
+
+  if ((_cur == NULL) || (p + size > _end)) {
+    NewBlock(size, align);
+    p = (char*)(((uintptr_t)_cur + align - 1) & ~(uintptr_t)(align - 1));
+  }
+
+  _cur = p + size;
+  _allocated += size;
+
+  if (kind >= _stats.size()) _stats.resize(kind + 1, SKindStat{ 0, 0 });
+  _stats[kind].count++;
+  _stats[kind].bytes += size;
+
+  return p;
+}
+
+void CArena::AddFinalizer(void (*fn)(void*), void *obj)
+{
+  _finalizers.push_back(make_pair(fn, obj));
+}
+
+void CArena::Release(void)
+{
+  // objects may refer to each other (also across adopted arenas); run all finalizers before any
+  // memory is returned
+  RunFinalizers();
+
+  for (size_t i=_adopted.size(); i>0; i--) delete _adopted[i-1];
+  _adopted.clear();
+
+  while (_blocks != NULL) {
+    SBlock *b = _blocks;
+    _blocks = b->next;
+    free(b);
+  }
+
+  _cur = _end = NULL;
+  _allocated = _reserved = 0;
+  _stats.clear();
+}
+
+void CArena::Adopt(CArena *arena)
+{
+  assert((arena != NULL) && (arena != this));
+  _adopted.push_back(arena);
+}
+
+size_t CArena::GetAllocated(void) const
+{
+  size_t res = _allocated;
+  for (size_t i=0; i<_adopted.size(); i++) res += _adopted[i]->GetAllocated();
+  return res;
+}
+
+size_t CArena::GetReserved(void) const
+{
+  size_t res = _reserved;
+  for (size_t i=0; i<_adopted.size(); i++) res += _adopted[i]->GetReserved();
+  return res;
+}
+
+void CArena::RunFinalizers(void)
+{
+  // adopted arenas were filled last
+  for (size_t i=_adopted.size(); i>0; i--) _adopted[i-1]->RunFinalizers();
+
+  for (size_t i=_finalizers.size(); i>0; i--) _finalizers[i-1].first(_finalizers[i-1].second);
+  _finalizers.clear();
+}
+
+void CArena::CollectStats(vector<SKindStat> &stats) const
+{
+  if (stats.size() < _stats.size()) stats.resize(_stats.size(), SKindStat{ 0, 0 });
+  for (size_t i=0; i<_stats.size(); i++) {
+    stats[i].count += _stats[i].count;
+    stats[i].bytes += _stats[i].bytes;
+  }
+
+  for (size_t i=0; i<_adopted.size(); i++) _adopted[i]->CollectStats(stats);
+}
+
+void CArena::NewBlock(size_t size, size_t align)
+{
+  // oversized requests get a block of their own
+  size_t bsize = sizeof(SBlock) + size + align;
+  if (bsize < _block_size) bsize = _block_size;
+
+  SBlock *b = (SBlock*)malloc(bsize);
+  if (b == NULL) throw bad_alloc();
+
+  b->next = _blocks;
+  b->size = bsize;
+  _blocks = b;
+  _reserved += bsize;
+
+  _cur = (char*)(b + 1);
+  _end = (char*)b + bsize;
+}
+
+unsigned int CArena::RegisterKind(const char *name)
+{
+  string kind = name;
+
+#ifdef __GNUG__
+  int status;
+  char *demangled = abi::__cxa_demangle(name, NULL, NULL, &status);
+  if (status == 0) kind = demangled;
+  free(demangled);
+#endif
+
+  lock_guard<mutex> lock(KindMutex);
+  KindNames.push_back(kind);
+  return (unsigned int)KindNames.size() - 1;
+}
+
+ostream& CArena::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  out << ind << left << setw(48) << "kind" << right << setw(10) << "count"
+      << setw(12) << "bytes" << endl;
+
+  vector<SKindStat> stats;
+  CollectStats(stats);
+
+  lock_guard<mutex> lock(KindMutex);
+  for (size_t i=0; i<stats.size(); i++) {
+    if (stats[i].count == 0) continue;
+    out << ind << left << setw(48) << KindNames[i] << right << setw(10) << stats[i].count
+        << setw(12) << stats[i].bytes << endl;
+  }
+  out << ind << left << setw(48) << "total allocated" << right << setw(22) << GetAllocated()
+      << endl
+      << ind << left << setw(48) << "total reserved" << right << setw(22) << GetReserved()
+      << endl;
+
+  return out;
+}
@@ -0,0 +1,244 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL bump arena allocator
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __SnuPL_ARENA_H__
+#define __SnuPL_ARENA_H__
+
+#include <cstddef>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------------------
+/// @brief arena finalization trait
+///
+/// Objects allocated in an arena are released together with the arena, without calling their
+/// destructors, if CArenaTrivial<T>::value is true. Otherwise the arena registers the destructor
+/// and runs it upon release. Specialize this trait for classes whose destructors only release
+/// memory that lives in the arena anyway.
+///
+template<typename T, typename Enable=void>
+struct CArenaTrivial : is_trivially_destructible<T> {};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief bump arena
+///
+/// Allocates objects sequentially from large blocks. Individual objects are never freed; all
+/// memory is released at once when the arena is released or destroyed. The arena keeps track of
+/// the number of objects and bytes allocated per kind (i.e., per type).
+///
+class CArena {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param block_size size of the blocks requested from the system
+    CArena(size_t block_size=BLOCK_SIZE);
+
+    /// @brief destructor (releases the arena)
+    ~CArena(void);
+
+    /// @}
+
+    /// @name allocation
+    /// @{
+
+    /// @brief allocate raw memory
+    ///
+    /// @param size number of bytes
+    /// @param align alignment (a power of two)
+    /// @param kind allocation kind (see GetKind())
+    /// @retval pointer to the memory
+    void* Allocate(size_t size, size_t align, unsigned int kind);
+
+    /// @brief allocate and construct an object
+    ///
+    /// The destructor of the object is run upon release unless CArenaTrivial<T> holds.
+    ///
+    /// @param args constructor arguments
+    /// @retval object
+    template<typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+      void *p = Allocate(sizeof(T), alignof(T), GetKind<T>());
+      T *obj = new (p) T(forward<Args>(args)...);
+      if (!CArenaTrivial<T>::value) AddFinalizer(&Finalize<T>, obj);
+      return obj;
+    };
+
+    /// @brief register a function that is called with @a obj upon release
+    ///
+    /// Finalizers run in reverse order of registration.
+    ///
+    /// @param fn finalizer
+    /// @param obj object
+    void AddFinalizer(void (*fn)(void*), void *obj);
+
+    /// @brief release all memory
+    ///
+    /// Runs the registered finalizers and returns all blocks to the system. The arena can be
+    /// used again afterwards.
+    void Release(void);
+
+    /// @brief take over another arena
+    ///
+    /// The objects of @a arena are released together with this arena. @a arena itself is kept
+    /// alive until then, so allocators that refer to it remain valid; its statistics are included
+    /// in those of this arena.
+    ///
+    /// @param arena arena (allocated with new)
+    void Adopt(CArena *arena);
+
+    /// @}
+
+    /// @name statistics
+    /// @{
+
+    /// @brief return the id of the allocation kind of type T
+    template<typename T>
+    static unsigned int GetKind(void)
+    {
+      static const unsigned int kind = RegisterKind(typeid(T).name());
+      return kind;
+    };
+
+    /// @brief return the number of bytes allocated from the arena
+    size_t GetAllocated(void) const;
+
+    /// @brief return the number of bytes obtained from the system
+    size_t GetReserved(void) const;
+
+    /// @brief print the number of objects and bytes allocated per kind
+    ///
+    /// @param out output stream
+    /// @param indent indentation
+    ostream& print(ostream &out, int indent=0) const;
+
+    /// @}
+
+    const static size_t BLOCK_SIZE = 64 << 10; ///< default block size
+
+  private:
+    /// @brief allocation statistics of one kind
+    struct SKindStat {
+      size_t count;                 ///< number of allocations
+      size_t bytes;                 ///< number of bytes
+    };
+
+    /// @brief header of a block
+    struct SBlock {
+      SBlock *next;                 ///< next (older) block
+      size_t  size;                 ///< size of the block including the header
+    };
+
+    /// @brief allocate a new block that can hold at least @a size bytes at alignment @a align
+    void NewBlock(size_t size, size_t align);
+
+    /// @brief register an allocation kind
+    ///
+    /// @param name (mangled) type name
+    /// @retval kind id
+    static unsigned int RegisterKind(const char *name);
+
+    /// @brief run the finalizers of this arena and of all adopted arenas
+    void RunFinalizers(void);
+
+    /// @brief add the statistics of this arena and of all adopted arenas to @a stats
+    void CollectStats(vector<SKindStat> &stats) const;
+
+    /// @brief destroy an object of type T
+    template<typename T>
+    static void Finalize(void *obj) { static_cast<T*>(obj)->~T(); };
+
+    size_t      _block_size;        ///< default block size
+    SBlock     *_blocks;            ///< list of blocks (most recent first)
+    char       *_cur;               ///< next free byte in the current block
+    char       *_end;               ///< end of the current block
+    size_t      _allocated;         ///< bytes allocated
+    size_t      _reserved;          ///< bytes obtained from the system
+    vector<pair<void (*)(void*), void*>> _finalizers; ///< registered finalizers
+    vector<SKindStat> _stats;       ///< statistics indexed by kind
+    vector<CArena*> _adopted;       ///< adopted arenas
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief STL allocator backed by an arena
+///
+/// Allows containers inside arena objects to keep their elements in the arena as well. Memory is
+/// only returned with the arena; containers that grow leave their old buffers behind. Without an
+/// arena (NULL), the allocator falls back to the global heap.
+///
+template<typename T>
+class CArenaAllocator {
+  template<typename U> friend class CArenaAllocator;
+  public:
+    typedef T value_type;
+
+    /// @brief constructor
+    ///
+    /// @param arena arena (or NULL to allocate from the heap)
+    CArenaAllocator(CArena *arena=NULL) : _arena(arena) {};
+
+    /// @brief converting constructor (required by the STL)
+    template<typename U>
+    CArenaAllocator(const CArenaAllocator<U> &a) : _arena(a._arena) {};
+
+    /// @brief allocate storage for @a n elements
+    T* allocate(size_t n)
+    {
+      if (_arena == NULL) return static_cast<T*>(::operator new(n * sizeof(T)));
+      return static_cast<T*>(_arena->Allocate(n * sizeof(T), alignof(T),
+                                              CArena::GetKind<CArenaAllocator<T>>()));
+    };
+
+    /// @brief release storage (a no-op for arena storage)
+    void deallocate(T *p, size_t n)
+    {
+      if (_arena == NULL) ::operator delete(p);
+    };
+
+    /// @brief return the arena
+    CArena* GetArena(void) const { return _arena; };
+
+    bool operator==(const CArenaAllocator &a) const { return _arena == a._arena; };
+    bool operator!=(const CArenaAllocator &a) const { return _arena != a._arena; };
+
+  private:
+    CArena *_arena;                 ///< arena
+};
+
+
+#endif // __SnuPL_ARENA_H__
@@ -35,6 +35,7 @@
 
 #include <iostream>
 #include <cassert>
+#include <climits>
 #include <cstring>
 
 #include <typeinfo>
@@ -46,12 +47,14 @@ using namespace std;
 //--------------------------------------------------------------------------------------------------
 // CAstNode
 //
-int CAstNode::_global_id = 0;
+thread_local int CAstNode::_global_id = 0;
+thread_local vector<CAstNode*> *CAstNode::_log = NULL;
 
 CAstNode::CAstNode(CToken token)
   : _token(token), _addr(NULL)
 {
   _id = _global_id++;
+  if (_log != NULL) _log->push_back(this);
 }
 
 CAstNode::~CAstNode(void)
@@ -64,6 +67,33 @@ int CAstNode::GetID(void) const
   return _id;
 }
 
+int CAstNode::GetNextID(void)
+{
+  return _global_id;
+}
+
+void CAstNode::SetNextID(int id)
+{
+  _global_id = id;
+}
+
+vector<CAstNode*>* CAstNode::SetLog(vector<CAstNode*> *log)
+{
+  vector<CAstNode*> *prev = _log;
+  _log = log;
+  return prev;
+}
+
+vector<CAstNode*>* CAstNode::GetLog(void)
+{
+  return _log;
+}
+
+void CAstNode::SetID(int id)
+{
+  _id = id;
+}
+
 CToken CAstNode::GetToken(void) const
 {
   return _token;
@@ -112,15 +142,16 @@ ostream& operator<<(ostream &out, const CAstNode *t)
 // CAstScope
 //
 CAstScope::CAstScope(CToken t, const string name, CAstScope *parent)
-  : CAstNode(t), _name(name), _symtab(NULL), _parent(parent), _statseq(NULL), _cb(NULL)
+  : CAstNode(t), _name(name), _symtab(NULL), _parent(parent), _statseq(NULL), _cb(NULL),
+    _deferred(NULL), _body_error(false)
 {
   if (_parent != NULL) _parent->AddChild(this);
 }
 
 CAstScope::~CAstScope(void)
 {
+  // the statement sequence lives in the arena of the module
   delete _symtab;
-  delete _statseq;
   delete _cb;
 }
 
@@ -159,10 +190,16 @@ bool CAstScope::RemoveChild(CAstScope* child)
 CSymtab* CAstScope::GetSymbolTable(void) const
 {
   assert(_symtab != NULL);
+  if (_deferred != NULL) Materialize();
   return _symtab;
 }
 
-CSymbol* CAstScope::CreateConst(const string ident, const CType *type, const CDataInitializer *data)
+CArena* CAstScope::GetArena(void) const
+{
+  return _parent != NULL ? _parent->GetArena() : NULL;
+}
+
+CSymbol* CAstScope::CreateConst(const string ident, const CType *type, const CDataValue &data)
 {
   return new CSymConstant(ident, type, data);
 }
@@ -174,14 +211,67 @@ void CAstScope::SetStatementSequence(CAstStatement *statseq)
 
 CAstStatement* CAstScope::GetStatementSequence(void) const
 {
+  if (_deferred != NULL) Materialize();
   return _statseq;
 }
 
+void CAstScope::SetDeferredBody(CAstDeferredBody *body)
+{
+  _deferred = body;
+  _body_error = false;
+}
+
+bool CAstScope::IsDeferred(void) const
+{
+  return _deferred != NULL;
+}
+
+bool CAstScope::Materialize(CToken *t, string *msg) const
+{
+  if (_deferred != NULL) {
+    // the body fills in the symbol table and the statement sequence of this scope
+    CAstDeferredBody *body = _deferred;
+    _deferred = NULL;
+    _body_error = !body->Materialize(const_cast<CAstScope*>(this), &_error_token, &_error_msg);
+  }
+
+  if (_body_error) {
+    if (t != NULL) *t = _error_token;
+    if (msg != NULL) *msg = _error_msg;
+  }
+
+  return !_body_error;
+}
+
+/// @brief type-check a statement sequence
+///
+/// @param s first statement of the sequence (may be NULL)
+/// @param t (out, optional) token of the first erroneous node
+/// @param msg (out, optional) error message
+/// @retval true if all statements pass the type check
+/// @retval false otherwise
+static bool TypeCheckSequence(CAstStatement *s, CToken *t, string *msg)
+{
+  while (s != NULL) {
+    if (!s->TypeCheck(t, msg)) return false;
+    s = s->GetNext();
+  }
+
+  return true;
+}
+
 bool CAstScope::TypeCheck(CToken *t, string *msg) const
 {
   bool result = true;
 
-  // TODO (phase 3)
+  // errors in deferred bodies surface here
+  if (!Materialize(t, msg)) return false;
+
+  result = TypeCheckSequence(GetStatementSequence(), t, msg);
+
+  for (size_t i=0; result && (i<GetNumChildren()); i++) {
+    result = GetChild(i)->TypeCheck(t, msg);
+  }
 
   return result;
 }
@@ -192,7 +282,7 @@ ostream& CAstScope::print(ostream &out, int indent) const
 
   out << ind << "CAstScope: '" << _name << "'" << endl;
   out << ind << "  symbol table:" << endl;
-  _symtab->print(out, indent+4);
+  GetSymbolTable()->print(out, indent+4);
   out << ind << "  statement list:" << endl;
   CAstStatement *s = GetStatementSequence();
   if (s != NULL) {
@@ -274,6 +364,12 @@ CAstModule::CAstModule(CToken t, const string name)
   : CAstScope(t, name, NULL)
 {
   SetSymbolTable(new CSymtab());
+  _strings = new CStringPool(GetSymbolTable());
+}
+
+CAstModule::~CAstModule(void)
+{
+  delete _strings;
 }
 
 CSymbol* CAstModule::CreateVar(const string ident, const CType *type)
@@ -281,6 +377,16 @@ CSymbol* CAstModule::CreateVar(const string ident, const CType *type)
   return new CSymGlobal(ident, type);
 }
 
+CArena* CAstModule::GetArena(void) const
+{
+  return &_arena;
+}
+
+CStringPool* CAstModule::GetStringPool(void) const
+{
+  return _strings;
+}
+
 string CAstModule::dotAttr(void) const
 {
   return " [label=\"m " + GetName() + "\",shape=box]";
@@ -353,7 +459,6 @@ CAstStatement::CAstStatement(CToken token)
 
 CAstStatement::~CAstStatement(void)
 {
-  delete _next;
 }
 
 void CAstStatement::SetNext(CAstStatement *next)
@@ -395,6 +500,9 @@ CAstExpression* CAstStatAssign::GetRHS(void) const
 
 bool CAstStatAssign::TypeCheck(CToken *t, string *msg)
 {
+  if (!_lhs->TypeCheck(t, msg)) return false;
+  if (!_rhs->TypeCheck(t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
@@ -517,6 +625,8 @@ CAstExpression* CAstStatReturn::GetExpression(void) const
 
 bool CAstStatReturn::TypeCheck(CToken *t, string *msg)
 {
+  if ((_expr != NULL) && !_expr->TypeCheck(t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
@@ -603,6 +713,10 @@ CAstStatement* CAstStatIf::GetElseBody(void) const
 
 bool CAstStatIf::TypeCheck(CToken *t, string *msg)
 {
+  if (!_cond->TypeCheck(t, msg)) return false;
+  if (!TypeCheckSequence(_ifBody, t, msg)) return false;
+  if (!TypeCheckSequence(_elseBody, t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
@@ -706,6 +820,9 @@ CAstStatement* CAstStatWhile::GetBody(void) const
 
 bool CAstStatWhile::TypeCheck(CToken *t, string *msg)
 {
+  if (!_cond->TypeCheck(t, msg)) return false;
+  if (!TypeCheckSequence(_body, t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
@@ -767,12 +884,65 @@ CTacAddr* CAstStatWhile::ToTac(CCodeBlock *cb, CTacLabel *next)
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// CAstStatError
+//
+CAstStatError::CAstStatError(CToken t)
+  : CAstStatement(t)
+{
+}
+
+bool CAstStatError::TypeCheck(CToken *t, string *msg)
+{
+  if (t != NULL) *t = GetToken();
+  if (msg != NULL) *msg = "syntax error.";
+
+  return false;
+}
+
+ostream& CAstStatError::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  out << ind << "error" << endl;
+
+  return out;
+}
+
+string CAstStatError::dotAttr(void) const
+{
+  return " [label=\"error\",shape=box]";
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // CAstExpression
 //
 CAstExpression::CAstExpression(CToken t)
-  : CAstNode(t)
+  : CAstNode(t), _parenthesized(false), _cached_type(NULL), _evaluated(false)
+{
+}
+
+bool CAstExpression::TypeCheck(CToken *t, string *msg)
+{
+  if (!CheckType(t, msg)) return false;
+
+  // the operands have been checked as well; their types no longer change
+  if (_cached_type == NULL) _cached_type = ComputeType();
+
+  return true;
+}
+
+const CType* CAstExpression::GetType(void) const
 {
+  if (_cached_type == NULL) return ComputeType();
+
+#ifdef VERIFY_TYPE_CACHE
+  // types are unique, hence a fresh computation must yield the same instance
+  assert(_cached_type == ComputeType());
+#endif
+
+  return _cached_type;
 }
 
 void CAstExpression::SetParenthesized(bool parenthesized)
@@ -785,9 +955,24 @@ bool CAstExpression::GetParenthesized(void) const
   return _parenthesized;
 }
 
-const CDataInitializer* CAstExpression::Evaluate(void) const
+CDataValue CAstExpression::Evaluate(void) const
 {
-  return NULL;
+  if (!_evaluated) {
+    _value = ComputeValue();
+    _evaluated = true;
+  }
+
+  return _value;
+}
+
+CDataValue CAstExpression::ComputeValue(void) const
+{
+  return CDataValue();
+}
+
+bool CAstExpression::IsEvaluated(void) const
+{
+  return _evaluated;
 }
 
 CTacAddr* CAstExpression::ToTac(CCodeBlock *cb)
@@ -802,6 +987,42 @@ CTacAddr* CAstExpression::ToTac(CCodeBlock *cb,
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// constant evaluation
+//
+
+/// @brief return the kind of the values of a type
+/// @param type type
+/// @retval EDataKind kind of scalar values of @a type (dkNone for other types)
+static EDataKind DataKind(const CType *type)
+{
+  if (type->IsBoolean())      return dkBoolean;
+  else if (type->IsChar())    return dkChar;
+  else if (type->IsInteger()) return dkInteger;
+  else if (type->IsLongint()) return dkLongint;
+  else                        return dkNone;
+}
+
+/// @brief create a scalar value
+///
+/// The value is truncated to the size of the kind, i.e., integer values wrap around at 32 bits.
+///
+/// @param kind dkBoolean, dkChar, dkInteger, or dkLongint
+/// @param value value
+/// @retval CDataValue scalar value
+static CDataValue Scalar(EDataKind kind, long long value)
+{
+  switch (kind) {
+    case dkBoolean: return CDataValue::Boolean(value != 0);
+    case dkChar:    return CDataValue::Char((char)value);
+    case dkLongint: return CDataValue::Longint(value);
+    default:
+      assert(kind == dkInteger);
+      return CDataValue::Integer((int)(unsigned int)value);
+  }
+}
+
+
 //--------------------------------------------------------------------------------------------------
 // CAstOperation
 //
@@ -844,25 +1065,87 @@ CAstExpression* CAstBinaryOp::GetRight(void) const
   return _right;
 }
 
-bool CAstBinaryOp::TypeCheck(CToken *t, string *msg)
+bool CAstBinaryOp::CheckType(CToken *t, string *msg)
 {
+  if (!_left->TypeCheck(t, msg)) return false;
+  if (!_right->TypeCheck(t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstBinaryOp::GetType(void) const
+const CType* CAstBinaryOp::ComputeType(void) const
 {
   // TODO (phase 3)
 
   return CTypeManager::Get()->GetInteger();
 }
 
-const CDataInitializer* CAstBinaryOp::Evaluate(void) const
+CDataValue CAstBinaryOp::ComputeValue(void) const
 {
-  // TODO (phase 3)
-
-  return NULL;
+  // evaluate the left spine of long operator chains bottom-up first. The recursion below then
+  // stops at memoized operands, so its depth does not grow with the length of the chain.
+  vector<const CAstBinaryOp*> spine;
+  const CAstBinaryOp *n = dynamic_cast<const CAstBinaryOp*>(_left);
+  while ((n != NULL) && !n->IsEvaluated()) {
+    spine.push_back(n);
+    n = dynamic_cast<const CAstBinaryOp*>(n->GetLeft());
+  }
+  for (auto it = spine.rbegin(); it != spine.rend(); it++) (*it)->Evaluate();
+
+  CDataValue l = _left->Evaluate(), r = _right->Evaluate();
+
+  // there are no implicit type conversions
+  if (!l.IsScalar() || (l.GetKind() != r.GetKind())) return CDataValue();
+
+  long long lv = l.GetNumber(), rv = r.GetNumber();
+  EOperation op = GetOperation();
+  switch (op) {
+    case opAdd:
+    case opSub:
+    case opMul:
+    case opDiv:
+      {
+        if (!l.IsInt()) return CDataValue();
+
+        // compute in unsigned arithmetic to obtain the wrap-around of the target
+        unsigned long long a = lv, b = rv;
+        long long v;
+
+        if (op == opAdd)      v = (long long)(a + b);
+        else if (op == opSub) v = (long long)(a - b);
+        else if (op == opMul) v = (long long)(a * b);
+        else {
+          // division by zero and MIN/-1 trap at run time
+          long long min = l.GetKind() == dkLongint ? LLONG_MIN : INT_MIN;
+          if ((rv == 0) || ((lv == min) && (rv == -1))) return CDataValue();
+          v = lv / rv;
+        }
+
+        return Scalar(l.GetKind(), v);
+      }
+
+    case opAnd:
+    case opOr:
+      if (l.GetKind() != dkBoolean) return CDataValue();
+      return CDataValue::Boolean(op == opAnd ? (lv && rv) : (lv || rv));
+
+    case opEqual:         return CDataValue::Boolean(lv == rv);
+    case opNotEqual:      return CDataValue::Boolean(lv != rv);
+
+    default:
+      // booleans are not ordered
+      if (l.GetKind() == dkBoolean) return CDataValue();
+
+      switch (op) {
+        case opLessThan:    return CDataValue::Boolean(lv <  rv);
+        case opLessEqual:   return CDataValue::Boolean(lv <= rv);
+        case opBiggerThan:  return CDataValue::Boolean(lv >  rv);
+        case opBiggerEqual: return CDataValue::Boolean(lv >= rv);
+        default:            return CDataValue();
+      }
+  }
 }
 
 ostream& CAstBinaryOp::print(ostream &out, int indent) const
@@ -931,25 +1214,42 @@ CAstExpression* CAstUnaryOp::GetOperand(void) const
   return _operand;
 }
 
-bool CAstUnaryOp::TypeCheck(CToken *t, string *msg)
+bool CAstUnaryOp::CheckType(CToken *t, string *msg)
 {
+  if (!_operand->TypeCheck(t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstUnaryOp::GetType(void) const
+const CType* CAstUnaryOp::ComputeType(void) const
 {
   // TODO (phase 3)
 
   return CTypeManager::Get()->GetInteger();
 }
 
-const CDataInitializer* CAstUnaryOp::Evaluate(void) const
+CDataValue CAstUnaryOp::ComputeValue(void) const
 {
-  // TODO (phase 3)
+  CDataValue v = _operand->Evaluate();
 
-  return NULL;
+  switch (GetOperation()) {
+    case opNeg:
+      if (!v.IsInt()) return CDataValue();
+      return Scalar(v.GetKind(), (long long)(0ULL - (unsigned long long)v.GetNumber()));
+
+    case opPos:
+      if (!v.IsInt()) return CDataValue();
+      return v;
+
+    case opNot:
+      if (v.GetKind() != dkBoolean) return CDataValue();
+      return CDataValue::Boolean(!v.GetBoolean());
+
+    default:
+      return CDataValue();
+  }
 }
 
 ostream& CAstUnaryOp::print(ostream &out, int indent) const
@@ -1022,25 +1322,35 @@ CAstExpression* CAstSpecialOp::GetOperand(void) const
   return _operand;
 }
 
-bool CAstSpecialOp::TypeCheck(CToken *t, string *msg)
+bool CAstSpecialOp::CheckType(CToken *t, string *msg)
 {
+  if (!_operand->TypeCheck(t, msg)) return false;
+
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstSpecialOp::GetType(void) const
+const CType* CAstSpecialOp::ComputeType(void) const
 {
   // TODO (phase 3)
 
   return NULL;
 }
 
-const CDataInitializer* CAstSpecialOp::Evaluate(void) const
+CDataValue CAstSpecialOp::ComputeValue(void) const
 {
-  // TODO (phase 3)
+  // addresses are not known at compile time
+  if ((GetOperation() == opAddress) || (GetOperation() == opDeref)) return CDataValue();
 
-  return NULL;
+  // conversions between scalar types
+  EDataKind kind = DataKind(_type);
+  if (kind == dkNone) return CDataValue();
+
+  CDataValue v = _operand->Evaluate();
+  if (!v.IsScalar()) return CDataValue();
+
+  return Scalar(kind, v.GetNumber());
 }
 
 ostream& CAstSpecialOp::print(ostream &out, int indent) const
@@ -1086,10 +1396,11 @@ CTacAddr* CAstSpecialOp::ToTac(CCodeBlock *cb)
 //--------------------------------------------------------------------------------------------------
 // CAstFunctionCall
 //
-CAstFunctionCall::CAstFunctionCall(CToken t, const CSymProc *symbol)
-  : CAstExpression(t), _symbol(symbol)
+CAstFunctionCall::CAstFunctionCall(CToken t, const CSymProc *symbol, CArena *arena)
+  : CAstExpression(t), _symbol(symbol), _arg(CArenaAllocator<CAstExpression*>(arena))
 {
   assert(symbol != NULL);
+  _ref = symbol->GetRef();
 }
 
 const CSymProc* CAstFunctionCall::GetSymbol(void) const
@@ -1122,14 +1433,18 @@ void CAstFunctionCall::SetArg(unsigned int index, CAstExpression *arg)
   _arg[index] = arg;
 }
 
-bool CAstFunctionCall::TypeCheck(CToken *t, string *msg)
+bool CAstFunctionCall::CheckType(CToken *t, string *msg)
 {
+  for (size_t i=0; i<_arg.size(); i++) {
+    if (!_arg[i]->TypeCheck(t, msg)) return false;
+  }
+
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstFunctionCall::GetType(void) const
+const CType* CAstFunctionCall::ComputeType(void) const
 {
   return GetSymbol()->GetDataType();
 }
@@ -1202,6 +1517,7 @@ CAstDesignator::CAstDesignator(CToken t, const CSymbol *symbol)
   : CAstOperand(t), _symbol(symbol)
 {
   assert(symbol != NULL);
+  _ref = symbol->GetRef();
 }
 
 const CSymbol* CAstDesignator::GetSymbol(void) const
@@ -1209,23 +1525,23 @@ const CSymbol* CAstDesignator::GetSymbol(void) const
   return _symbol;
 }
 
-bool CAstDesignator::TypeCheck(CToken *t, string *msg)
+bool CAstDesignator::CheckType(CToken *t, string *msg)
 {
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstDesignator::GetType(void) const
+const CType* CAstDesignator::ComputeType(void) const
 {
   return GetSymbol()->GetDataType();
 }
 
-const CDataInitializer* CAstDesignator::Evaluate(void) const
+CDataValue CAstDesignator::ComputeValue(void) const
 {
-  // TODO (phase 3)
+  const CSymbol *s = GetSymbol();
 
-  return NULL;
+  return s->GetSymbolType() == stConstant ? s->GetData() : CDataValue();
 }
 
 ostream& CAstDesignator::print(ostream &out, int indent) const
@@ -1276,8 +1592,9 @@ CTacAddr* CAstDesignator::ToTac(CCodeBlock *cb,
 //--------------------------------------------------------------------------------------------------
 // CAstArrayDesignator
 //
-CAstArrayDesignator::CAstArrayDesignator(CToken t, const CSymbol *symbol)
-  : CAstDesignator(t, symbol), _done(false), _offset(NULL)
+CAstArrayDesignator::CAstArrayDesignator(CToken t, const CSymbol *symbol, CArena *arena)
+  : CAstDesignator(t, symbol), _done(false), _idx(CArenaAllocator<CAstExpression*>(arena)),
+    _offset(NULL)
 {
 }
 
@@ -1304,22 +1621,45 @@ CAstExpression* CAstArrayDesignator::GetIndex(unsigned int index) const
   return _idx[index];
 }
 
-bool CAstArrayDesignator::TypeCheck(CToken *t, string *msg)
+bool CAstArrayDesignator::CheckType(CToken *t, string *msg)
 {
   assert(_done);
 
+  for (size_t i=0; i<_idx.size(); i++) {
+    if (!_idx[i]->TypeCheck(t, msg)) return false;
+  }
+
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstArrayDesignator::GetType(void) const
+const CType* CAstArrayDesignator::ComputeType(void) const
 {
   // TODO (phase 3)
 
   return NULL;
 }
 
+CDataValue CAstArrayDesignator::ComputeValue(void) const
+{
+  const CSymbol *s = GetSymbol();
+  if ((s->GetSymbolType() != stConstant) || (GetNIndices() != 1)) return CDataValue();
+
+  const CDataValue &str = s->GetData();
+  if (str.GetKind() != dkString) return CDataValue();
+
+  CDataValue idx = GetIndex(0)->Evaluate();
+  if (!idx.IsInt()) return CDataValue();
+
+  // the array includes the terminating \0 character
+  string v = CToken::unescape(str.GetString());
+  long long i = idx.GetNumber(), len = strlen(v.c_str());
+  if ((i < 0) || (i > len)) return CDataValue();
+
+  return CDataValue::Char(i < len ? v[i] : '\0');
+}
+
 ostream& CAstArrayDesignator::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
@@ -1416,23 +1756,33 @@ string CAstConstant::GetValueStr(void) const
   return out.str();
 }
 
-bool CAstConstant::TypeCheck(CToken *t, string *msg)
+bool CAstConstant::CheckType(CToken *t, string *msg)
 {
   // TODO (phase 3)
 
   return true;
 }
 
-const CType* CAstConstant::GetType(void) const
+const CType* CAstConstant::ComputeType(void) const
 {
   return _type;
 }
 
-const CDataInitializer* CAstConstant::Evaluate(void) const
+CDataValue CAstConstant::ComputeValue(void) const
 {
-  // TODO (phase 3)
+  CTypeManager *tm = CTypeManager::Get();
 
-  return NULL;
+  if (_type == tm->GetBool())         return CDataValue::Boolean(_value != 0);
+  else if (_type == tm->GetChar())    return CDataValue::Char((char)_value);
+  else if (_type == tm->GetLongint()) {
+    // LLONG_MAX+1 is only valid when negated (see FoldNeg())
+    if ((_value == LLONG_MIN) && !_negated) return CDataValue();
+    return CDataValue::Longint(_value);
+  } else {
+    // abs(INT_MIN) exceeds INT_MAX; it is only in range after folding the sign
+    if ((_value < INT_MIN) || (_value > INT_MAX)) return CDataValue();
+    return CDataValue::Integer((int)_value);
+  }
 }
 
 ostream& CAstConstant::print(ostream &out, int indent) const
@@ -1475,36 +1825,14 @@ CTacAddr* CAstConstant::ToTac(CCodeBlock *cb,
 //--------------------------------------------------------------------------------------------------
 // CAstStringConstant
 //
-int CAstStringConstant::_idx = 0;
-
-CAstStringConstant::CAstStringConstant(CToken t, const string value, CAstScope *s)
-  : CAstOperand(t)
+CAstStringConstant::CAstStringConstant(CToken t, const CSymGlobal *sym)
+  : CAstOperand(t), _type(sym->GetDataType()), _value(sym->GetData()), _sym(sym)
 {
-  CTypeManager *tm = CTypeManager::Get();
-  CSymtab *st = s->GetSymbolTable();
-
-  _type = tm->GetArray(strlen(CToken::unescape(value).c_str())+1,
-                       tm->GetChar());
-  _value = new CDataInitString(value);
-
-  // in case of name clashes we simply iterate until we find a
-  // name that has not yet been used
-  _sym = NULL;
-  do {
-    ostringstream o;
-    o << "_str_" << ++_idx;
-    if (st->FindSymbol(o.str(), sGlobal) == NULL) {
-      _sym = new CSymGlobal(o.str(), _type);
-    }
-  } while (_sym == NULL);
-
-  _sym->SetData(_value);
-  st->AddSymbol(_sym);
 }
 
 const string CAstStringConstant::GetValue(void) const
 {
-  return _value->GetData();
+  return _value.GetString();
 }
 
 const string CAstStringConstant::GetValueStr(void) const
@@ -1512,23 +1840,21 @@ const string CAstStringConstant::GetValueStr(void) const
   return GetValue();
 }
 
-bool CAstStringConstant::TypeCheck(CToken *t, string *msg)
+bool CAstStringConstant::CheckType(CToken *t, string *msg)
 {
   return true;
 }
 
-const CType* CAstStringConstant::GetType(void) const
+const CType* CAstStringConstant::ComputeType(void) const
 {
   // TODO (phase 3)
 
   return NULL;
 }
 
-const CDataInitializer* CAstStringConstant::Evaluate(void) const
+CDataValue CAstStringConstant::ComputeValue(void) const
 {
-  // TODO (phase 3)
-
-  return NULL;
+  return _value;
 }
 
 ostream& CAstStringConstant::print(ostream &out, int indent) const
@@ -1568,3 +1894,39 @@ CTacAddr* CAstStringConstant::ToTac(CCodeBlock *cb,
 
   return NULL;
 }
+
+
+//--------------------------------------------------------------------------------------------------
+// CAstExprError
+//
+CAstExprError::CAstExprError(CToken t)
+  : CAstExpression(t)
+{
+}
+
+bool CAstExprError::CheckType(CToken *t, string *msg)
+{
+  if (t != NULL) *t = GetToken();
+  if (msg != NULL) *msg = "syntax error.";
+
+  return false;
+}
+
+const CType* CAstExprError::ComputeType(void) const
+{
+  return NULL;
+}
+
+ostream& CAstExprError::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  out << ind << "error <INVALID>" << endl;
+
+  return out;
+}
+
+string CAstExprError::dotAttr(void) const
+{
+  return " [label=\"error\",shape=ellipse]";
+}
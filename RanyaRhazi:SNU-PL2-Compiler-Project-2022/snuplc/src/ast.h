@@ -42,6 +42,7 @@
 #include <map>
 #include <vector>
 
+#include "arena.h"
 #include "scanner.h"
 #include "type.h"
 #include "symtab.h"
@@ -49,6 +50,7 @@
 #include "ir.h"
 using namespace std;
 
+class CAstScope;
 class CAstStatement;
 class CAstExpression;
 class CAstFunctionCall;
@@ -59,6 +61,10 @@ class CAstDesignator;
 ///
 /// base node class for all node types in the AST
 ///
+/// The nodes of a module are allocated in the arena of the module (CAstModule::GetArena()) and
+/// are released together with the module. Apart from scopes, nodes are released without running
+/// their destructors.
+///
 
 class CAstNode {
   public:
@@ -82,6 +88,34 @@ class CAstNode {
 
     /// @}
 
+    /// @name node numbering
+    ///
+    /// Nodes are numbered in order of creation; each thread has its own counter.
+    /// @{
+
+    /// @brief return the ID of the next node created by the calling thread
+    static int GetNextID(void);
+
+    /// @brief set the ID of the next node created by the calling thread
+    static void SetNextID(int id);
+
+    /// @brief record the nodes created by the calling thread
+    ///
+    /// Used to renumber nodes that were created on several threads in the order of a sequential
+    /// run (see SetID()).
+    ///
+    /// @param log vector receiving the nodes in order of creation (NULL to stop recording)
+    /// @retval previous log of the calling thread
+    static vector<CAstNode*>* SetLog(vector<CAstNode*> *log);
+
+    /// @brief return the log of the calling thread (or NULL)
+    static vector<CAstNode*>* GetLog(void);
+
+    /// @brief change the ID of this node
+    void SetID(int id);
+
+    /// @}
+
 
     /// @name type management
     /// @{
@@ -126,7 +160,8 @@ class CAstNode {
                                     ///< the creation of the node. Used for
                                     ///< error reporting purposes)
     int        _id;                 ///< id of the node
-    static int _global_id;          ///< holds the (global) next id
+    static thread_local int _global_id; ///< holds the next id (per thread)
+    static thread_local vector<CAstNode*> *_log; ///< log of created nodes (per thread)
 
   protected:
     CTacAddr   *_addr;              ///< result of this node in three-address
@@ -152,6 +187,27 @@ ostream& operator<<(ostream &out, const CAstNode *t);
 
 /// @}
 
+//--------------------------------------------------------------------------------------------------
+/// @brief deferred body of a scope
+///
+/// Produces the local declarations and the statement sequence of a scope when they are first
+/// needed (see CAstScope::SetDeferredBody()).
+///
+class CAstDeferredBody {
+  public:
+    /// @brief destructor
+    virtual ~CAstDeferredBody(void) {};
+
+    /// @brief parse the body into scope @a s
+    /// @param s scope
+    /// @param t (out) error token
+    /// @param msg (out) error message
+    /// @retval true on success
+    /// @retval false if the body contains an error
+    virtual bool Materialize(CAstScope *s, CToken *t, string *msg) = 0;
+};
+
+
 //--------------------------------------------------------------------------------------------------
 /// @brief AST scope node
 ///
@@ -197,12 +253,14 @@ class CAstScope : public CAstNode {
     /// @brief get the symbol table for this scope
     CSymtab* GetSymbolTable(void) const;
 
+    /// @brief return the arena holding the nodes of this scope
+    virtual CArena* GetArena(void) const;
+
     /// @brief create a new variable on this scope's level
     virtual CSymbol* CreateVar(const string ident, const CType *type) = 0;
 
     /// @brief create a new constant on this scope's level
-    virtual CSymbol* CreateConst(const string ident, const CType *type,
-                                 const CDataInitializer *data);
+    virtual CSymbol* CreateConst(const string ident, const CType *type, const CDataValue &data);
 
     /// @brief set the statement sequence
     void SetStatementSequence(CAstStatement *statement);
@@ -212,6 +270,29 @@ class CAstScope : public CAstNode {
 
     /// @}
 
+    /// @name deferred bodies
+    ///
+    /// The local declarations and the statement sequence of a scope may be produced on demand.
+    /// The body is materialized by the first call to GetSymbolTable(), GetStatementSequence(), or
+    /// Materialize(); materialization is not thread-safe.
+    /// @{
+
+    /// @brief defer the body of this scope
+    /// @param body deferred body (owned by the arena of the module)
+    void SetDeferredBody(CAstDeferredBody *body);
+
+    /// @brief check whether the body of this scope has not been materialized yet
+    bool IsDeferred(void) const;
+
+    /// @brief materialize the body of this scope (if deferred)
+    /// @param t (out, optional) error token
+    /// @param msg (out, optional) error message
+    /// @retval true if the body is available
+    /// @retval false if the body contains an error
+    bool Materialize(CToken *t=NULL, string *msg=NULL) const;
+
+    /// @}
+
     /// @name type management
     /// @{
 
@@ -265,6 +346,10 @@ class CAstScope : public CAstNode {
     CAstStatement* _statseq;        ///< statement sequence
     vector<CAstScope*> _children;   ///< subordinate scopes
     CCodeBlock *_cb;                ///< (entry) code block for this scope
+    mutable CAstDeferredBody *_deferred; ///< body not materialized yet (or NULL)
+    mutable bool _body_error;       ///< materialization of the body failed
+    mutable CToken _error_token;    ///< error token of the body
+    mutable string _error_msg;      ///< error message of the body
 };
 
 
@@ -284,6 +369,9 @@ class CAstModule : public CAstScope {
     /// @param name module name
     CAstModule(CToken t, const string name);
 
+    /// @brief destructor
+    virtual ~CAstModule(void);
+
     /// @}
 
     /// @name scope manipulation/querying
@@ -292,6 +380,12 @@ class CAstModule : public CAstScope {
     /// @brief create a new variable on this scope's level
     virtual CSymbol* CreateVar(const string ident, const CType *type);
 
+    /// @brief return the arena holding the nodes of this module
+    virtual CArena* GetArena(void) const;
+
+    /// @brief return the pool of the string constants of this module
+    CStringPool* GetStringPool(void) const;
+
     /// @}
 
     /// @name output
@@ -302,6 +396,10 @@ class CAstModule : public CAstScope {
     virtual string dotAttr(void) const;
 
     /// @}
+
+  private:
+    mutable CArena _arena;          ///< arena holding all nodes of the module
+    CStringPool   *_strings;        ///< string constants of the module
 };
 
 
@@ -845,6 +943,49 @@ class CAstStatWhile : public CAstStatement {
 };
 
 
+//--------------------------------------------------------------------------------------------------
+/// @brief AST error statement node
+///
+/// node standing in for a statement that could not be parsed (error-recovering parser)
+///
+
+class CAstStatError : public CAstStatement {
+  public:
+    /// @name constructors/destructors
+    /// @{
+
+    /// @param t token at which the error was detected
+    CAstStatError(CToken t);
+
+    /// @}
+
+    /// @name type management
+    /// @{
+
+    /// @brief perform type checking
+    /// @param t (out, optional) type error at token t
+    /// @param msg (out, optional) type error message
+    /// @retval false always
+    virtual bool TypeCheck(CToken *t, string *msg);
+
+    /// @}
+
+    /// @name output
+    /// @{
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    virtual ostream&  print(ostream &out, int indent=0) const;
+
+    /// @brief return the node's attributes in (dot) string format
+    /// @retval string node attributes as a string
+    virtual string dotAttr(void) const;
+
+    /// @}
+};
+
+
 //--------------------------------------------------------------------------------------------------
 /// @brief AST expression node
 ///
@@ -866,14 +1007,31 @@ class CAstExpression : public CAstNode {
     /// @{
 
     /// @brief perform type checking
+    ///
+    /// Runs CheckType(). Once the check succeeds, the type of the expression is final; it is
+    /// computed once and cached for GetType().
+    ///
     /// @param t (out, optional) type error at token t
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg) = 0;
+    virtual bool TypeCheck(CToken *t, string *msg);
 
-    /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const = 0;
+    /// @brief return the type of the expression
+    ///
+    /// Returns the cached type after a successful type check and ComputeType() otherwise. When
+    /// compiled with VERIFY_TYPE_CACHE, the cached type is checked against ComputeType().
+    virtual const CType* GetType(void) const;
+
+    /// @brief perform type checking of this node (not cached)
+    /// @param t (out, optional) type error at token t
+    /// @param msg (out, optional) type error message
+    /// @retval true if no type error has been found
+    /// @retval false otherwise
+    virtual bool CheckType(CToken *t, string *msg) = 0;
+
+    /// @brief compute the type of the expression (not cached)
+    virtual const CType* ComputeType(void) const = 0;
 
     /// @}
 
@@ -895,9 +1053,16 @@ class CAstExpression : public CAstNode {
     /// @name numerical evaluation
     /// @{
 
-    /// @brief performs numerical evaluation of a symbolic constant.
-    /// @retval NULL catch-all for classes that do not support evaluation
-    virtual const CDataInitializer* Evaluate(void) const;
+    /// @brief performs numerical evaluation of a constant expression
+    ///
+    /// Runs ComputeValue() once and caches the result.
+    ///
+    /// @retval CDataValue value of the expression (dkNone if it is not a compile-time constant)
+    CDataValue Evaluate(void) const;
+
+    /// @brief compute the value of the expression (not cached)
+    /// @retval dkNone catch-all for classes that do not support evaluation
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -910,8 +1075,15 @@ class CAstExpression : public CAstNode {
 
     /// @}
 
+  protected:
+    /// @brief check whether Evaluate() has been run on this expression
+    bool IsEvaluated(void) const;
+
   private:
     bool       _parenthesized;      ///< expression was parenthesized
+    const CType *_cached_type;      ///< type cached by TypeCheck() (NULL: not cached)
+    mutable bool _evaluated;        ///< _value is valid
+    mutable CDataValue _value;      ///< value cached by Evaluate()
 };
 
 
@@ -982,10 +1154,10 @@ class CAstBinaryOp : public CAstOperation {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -994,9 +1166,12 @@ class CAstBinaryOp : public CAstOperation {
     /// @{
 
     /// @brief performs numerical evaluation of a binary operation
-    /// @retval CDataInitializer* result of evaluation. Delete after use.
-    /// @retval NULL if numerical evaluation cannot be performed
-    virtual const CDataInitializer* Evaluate(void) const;
+    ///
+    /// Integer and longint arithmetic wraps around like the generated code does. Operands of
+    /// different types, division by zero, and division overflow are not constant.
+    ///
+    /// @retval CDataValue result of evaluation (dkNone if evaluation cannot be performed)
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1071,10 +1246,10 @@ class CAstUnaryOp : public CAstOperation {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -1083,9 +1258,8 @@ class CAstUnaryOp : public CAstOperation {
     /// @{
 
     /// @brief performs numerical evaluation of a unary operation
-    /// @retval CDataInitializer* result of evaluation. Delete after use.
-    /// @retval NULL if numerical evaluation cannot be performed
-    virtual const CDataInitializer* Evaluate(void) const;
+    /// @retval CDataValue result of evaluation (dkNone if evaluation cannot be performed)
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1163,10 +1337,10 @@ class CAstSpecialOp : public CAstOperation {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the expression.
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -1174,11 +1348,10 @@ class CAstSpecialOp : public CAstOperation {
     /// @name numerical evaluation
     /// @{
 
-    /// @brief performs numerical evaluation of special ops. Only widening
-    ///        is supported at the moment.
-    /// @retval CDataInitializer* result of evaluation. Delete after use.
-    /// @retval NULL if numerical evaluation cannot be performed
-    virtual const CDataInitializer* Evaluate(void) const;
+    /// @brief performs numerical evaluation of special ops. Only conversions between scalar
+    ///        types (casts, widening and narrowing) are supported.
+    /// @retval CDataValue result of evaluation (dkNone if evaluation cannot be performed)
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1229,7 +1402,8 @@ class CAstFunctionCall : public CAstExpression {
 
     /// @param t token in input stream (used for error reporting purposes)
     /// @param symbol symbol of function to call
-    CAstFunctionCall(CToken t, const CSymProc *symbol);
+    /// @param arena arena holding the argument list (NULL: heap)
+    CAstFunctionCall(CToken t, const CSymProc *symbol, CArena *arena=NULL);
 
     /// @}
 
@@ -1239,6 +1413,9 @@ class CAstFunctionCall : public CAstExpression {
     /// @brief return the associated symbol
     const CSymProc* GetSymbol(void) const;
 
+    /// @brief return the scope depth and slot of the associated symbol
+    const SSymbolRef& GetRef(void) const { return _ref; };
+
     /// @brief add an argument
     /// @param arg argument
     void AddArg(CAstExpression *arg);
@@ -1260,10 +1437,10 @@ class CAstFunctionCall : public CAstExpression {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return the return type of the call
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -1307,7 +1484,8 @@ class CAstFunctionCall : public CAstExpression {
     /// @}
 
     const CSymProc *_symbol;        ///< symbol
-    vector<CAstExpression*> _arg;   ///< parameter list
+    SSymbolRef     _ref;            ///< scope depth and slot of the symbol
+    vector<CAstExpression*, CArenaAllocator<CAstExpression*>> _arg; ///< parameter list
 };
 
 
@@ -1353,6 +1531,9 @@ class CAstDesignator : public CAstOperand {
     /// @brief return the associated symbol
     const CSymbol* GetSymbol(void) const;
 
+    /// @brief return the scope depth and slot of the associated symbol
+    const SSymbolRef& GetRef(void) const { return _ref; };
+
     /// @}
 
 
@@ -1364,10 +1545,10 @@ class CAstDesignator : public CAstOperand {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the designator.
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -1376,9 +1557,9 @@ class CAstDesignator : public CAstOperand {
     /// @{
 
     /// @brief performs numerical evaluation of a designator
-    /// @retval CDataInitializer* result of evaluation. Delete after use.
-    /// @retval NULL if numerical evaluation cannot be performed
-    virtual const CDataInitializer* Evaluate(void) const;
+    /// @retval CDataValue value of the constant symbol (dkNone if the designator does not refer to
+    ///         a constant)
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1414,6 +1595,7 @@ class CAstDesignator : public CAstOperand {
 
   protected:
     const CSymbol *_symbol;         ///< symbol
+    SSymbolRef     _ref;            ///< scope depth and slot of the symbol
 };
 
 
@@ -1430,7 +1612,8 @@ class CAstArrayDesignator : public CAstDesignator {
 
     /// @param t token in input stream (used for error reporting purposes)
     /// @param symbol variable symbol
-    CAstArrayDesignator(CToken t, const CSymbol *symbol);
+    /// @param arena arena holding the index list (NULL: heap)
+    CAstArrayDesignator(CToken t, const CSymbol *symbol, CArena *arena=NULL);
 
     /// @}
 
@@ -1467,10 +1650,23 @@ class CAstArrayDesignator : public CAstDesignator {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the designator.
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
+
+    /// @}
+
+
+    /// @name numerical evaluation
+    /// @{
+
+    /// @brief performs numerical evaluation of an array designator
+    ///
+    /// Only a character of a constant string with a constant index in range is constant.
+    ///
+    /// @retval CDataValue result of evaluation (dkNone if evaluation cannot be performed)
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1507,7 +1703,7 @@ class CAstArrayDesignator : public CAstDesignator {
   private:
     bool _done;                     ///< flag indicating all index expressions
                                     ///< have been added
-    vector<CAstExpression*> _idx;   ///< index expressions
+    vector<CAstExpression*, CArenaAllocator<CAstExpression*>> _idx; ///< index expressions
     CAstExpression *_offset;        ///< address computation expression
 };
 
@@ -1553,10 +1749,10 @@ class CAstConstant : public CAstOperand {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the constant
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -1565,9 +1761,13 @@ class CAstConstant : public CAstOperand {
     /// @{
 
     /// @brief performs numerical evaluation of a constant
-    /// @retval CDataInitializer* result of evaluation. Delete after use.
-    /// @retval NULL if numerical evaluation cannot be performed
-    virtual const CDataInitializer* Evaluate(void) const;
+    ///
+    /// Integer constants must lie within the range of their type. The sign of a negative
+    /// number is folded into the constant by the parser, so the magnitude of the smallest
+    /// integer is only accepted in folded form (see README_Integer_Constants).
+    ///
+    /// @retval CDataValue result of evaluation (dkNone if the constant is out of range)
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1615,9 +1815,8 @@ class CAstStringConstant : public CAstOperand {
     /// @{
 
     /// @param t token in input stream (used for error reporting purposes)
-    /// @param value constant value
-    /// @param s enclosing scope
-    CAstStringConstant(CToken t, const string value, CAstScope *s);
+    /// @param sym global symbol holding the string (see CStringPool)
+    CAstStringConstant(CToken t, const CSymGlobal *sym);
 
     /// @}
 
@@ -1644,10 +1843,10 @@ class CAstStringConstant : public CAstOperand {
     /// @param msg (out, optional) type error message
     /// @retval true if no type error has been found
     /// @retval false otherwise
-    virtual bool TypeCheck(CToken *t, string *msg);
+    virtual bool CheckType(CToken *t, string *msg);
 
     /// @brief return (compute) the type of the constant
-    virtual const CType* GetType(void) const;
+    virtual const CType* ComputeType(void) const;
 
     /// @}
 
@@ -1656,8 +1855,8 @@ class CAstStringConstant : public CAstOperand {
     /// @{
 
     /// @brief performs numerical evaluation of a string constant
-    /// @retval CDataInitializer* pointer to the internal data. Do not delete!
-    virtual const CDataInitializer* Evaluate(void) const;
+    /// @retval CDataValue string value
+    virtual CDataValue ComputeValue(void) const;
 
     /// @}
 
@@ -1687,11 +1886,70 @@ class CAstStringConstant : public CAstOperand {
 
 
   private:
-    static int       _idx;          ///< static counter
     const CType     *_type;         ///< constant type
-    CDataInitString *_value;        ///< data initializer (holds string data)
-    CSymGlobal      *_sym;          ///< symbol holding the string
+    CDataValue  _value;             ///< string value
+    const CSymGlobal *_sym;         ///< symbol holding the string
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief AST error expression node
+///
+/// node standing in for an expression that could not be parsed (error-recovering parser)
+///
+
+class CAstExprError : public CAstExpression {
+  public:
+    /// @name constructors/destructors
+    /// @{
+
+    /// @param t token at which the error was detected
+    CAstExprError(CToken t);
+
+    /// @}
+
+    /// @name type management
+    /// @{
+
+    /// @brief perform type checking
+    /// @param t (out, optional) type error at token t
+    /// @param msg (out, optional) type error message
+    /// @retval false always
+    virtual bool CheckType(CToken *t, string *msg);
+
+    /// @brief return (compute) the type of the expression
+    /// @retval NULL always
+    virtual const CType* ComputeType(void) const;
+
+    /// @}
+
+    /// @name output
+    /// @{
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    virtual ostream&  print(ostream &out, int indent=0) const;
+
+    /// @brief return the node's attributes in (dot) string format
+    /// @retval string node attributes as a string
+    virtual string dotAttr(void) const;
+
+    /// @}
 };
 
 
+//--------------------------------------------------------------------------------------------------
+/// @brief arena finalization of AST nodes
+///
+/// Statements and expressions only refer to other nodes, symbols and types; their destructors
+/// need not run when the arena of the module is released. Scopes own their symbol table and
+/// code block and are finalized.
+///
+template<typename T>
+struct CArenaTrivial<T, typename enable_if<is_base_of<CAstNode, T>::value &&
+                                           !is_base_of<CAstScope, T>::value>::type>
+  : true_type {};
+
+
 #endif // __SnuPL_AST_H__
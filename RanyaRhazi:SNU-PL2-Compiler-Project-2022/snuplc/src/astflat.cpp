@@ -0,0 +1,738 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL flat (index-based) abstract syntax tree
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cassert>
+
+#include "astflat.h"
+using namespace std;
+
+/// @brief expression flag: the expression was parenthesized
+#define FLAG_PARENTHESIZED 0x1
+
+/// @brief print a type as done by the print() methods of the AST classes
+static void PrintType(ostream &out, const CType *t)
+{
+  if (t != NULL) out << t; else out << "<INVALID>";
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CAstFlat
+//
+CAstFlat::CAstFlat(const CAstModule *module, const CToken *tokens, size_t ntokens)
+  : _tokens(tokens), _ntokens(tokens != NULL ? ntokens : 0)
+{
+  assert(module != NULL);
+
+  _types.push_back(NULL);
+  _ptr_idx[NULL] = 0;
+
+  _scopes.resize(1);
+  EncodeScope(module, 0, NONE);
+
+  // link the copies of procedures to the copies of their parameters. The parameters of external
+  // subroutines belong to no symbol table and are copied here
+  vector<pair<const CSymProc*, CSymProc*>> procs;
+  for (auto it=_copy.begin(); it!=_copy.end(); it++) {
+    if (it->first->GetSymbolType() != stProcedure) continue;
+    procs.push_back(make_pair(static_cast<const CSymProc*>(it->first),
+                              static_cast<CSymProc*>(it->second)));
+  }
+  for (size_t i=0; i<procs.size(); i++) {
+    for (unsigned int p=0; p<procs[i].first->GetNParams(); p++) {
+      const CSymParam *param = procs[i].first->GetParam(p);
+      auto it = _copy.find(param);
+      CSymbol *c = it != _copy.end() ? it->second : NULL;
+      if (c == NULL) {
+        c = CopySymbol(param);
+        _extra.push_back(c);
+      }
+      procs[i].second->AddParam(static_cast<CSymParam*>(c));
+    }
+  }
+
+  // the lookup tables are only needed during encoding
+  unordered_map<const CAstScope*, unsigned int>().swap(_scope_idx);
+  unordered_map<const void*, unsigned int>().swap(_ptr_idx);
+  unordered_map<unsigned int, unsigned int>().swap(_token_idx);
+  unordered_map<const CSymbol*, CSymbol*>().swap(_copy);
+
+  _scopes.shrink_to_fit();
+  _stats.shrink_to_fit();
+  _exprs.shrink_to_fit();
+  _types.shrink_to_fit();
+  _symbols.shrink_to_fit();
+  _strings.shrink_to_fit();
+  _own.shrink_to_fit();
+  _extra.shrink_to_fit();
+}
+
+CAstFlat::~CAstFlat(void)
+{
+  // symbol tables own their symbols
+  for (size_t i=0; i<_scopes.size(); i++) delete _scopes[i].symtab;
+  for (size_t i=0; i<_extra.size(); i++) delete _extra[i];
+}
+
+size_t CAstFlat::GetSize(void) const
+{
+  size_t size = sizeof(*this) +
+                _scopes.capacity() * sizeof(SAstFlatScope) +
+                _stats.capacity() * sizeof(SAstFlatStat) +
+                _exprs.capacity() * sizeof(SAstFlatExpr) +
+                _types.capacity() * sizeof(const CType*) +
+                _symbols.capacity() * sizeof(const CSymbol*) +
+                _strings.capacity() * sizeof(string) +
+                _own.capacity() * sizeof(CToken);
+
+  for (size_t i=0; i<_strings.size(); i++) {
+    if (_strings[i].capacity() > 15) size += _strings[i].capacity() + 1;
+  }
+
+  return size;
+}
+
+void CAstFlat::EncodeScope(const CAstScope *s, unsigned int idx, unsigned int parent)
+{
+  _scope_idx[s] = idx;
+
+  const CAstProcedure *p = dynamic_cast<const CAstProcedure*>(s);
+
+  // statements only refer to symbols of this scope and its ancestors; copy them first
+  SAstFlatScope r;
+  r.symtab = CopySymtab(s->GetSymbolTable(), parent != NONE ? _scopes[parent].symtab : NULL);
+  r.token = TokenIndex(s->GetToken());
+  r.name = StringIndex(s->GetName());
+  r.parent = parent;
+  r.symbol = (p != NULL) ? SymbolIndex(p->GetSymbol()) : NONE;
+  r.child = (unsigned int)_scopes.size();
+  r.nchild = (unsigned int)s->GetNumChildren();
+  _scopes.resize(_scopes.size() + r.nchild);
+  EncodeStatSeq(s->GetStatementSequence(), &r.stat, &r.nstat);
+  _scopes[idx] = r;
+
+  for (unsigned int i=0; i<r.nchild; i++) EncodeScope(s->GetChild(i), r.child + i, idx);
+}
+
+void CAstFlat::EncodeStatSeq(const CAstStatement *s, unsigned int *first, unsigned int *count)
+{
+  // reserve a contiguous span for the sequence before encoding nested sequences
+  unsigned int n = 0;
+  for (const CAstStatement *st = s; st != NULL; st = st->GetNext()) n++;
+
+  *first = (unsigned int)_stats.size();
+  *count = n;
+  _stats.resize(_stats.size() + n);
+
+  unsigned int idx = *first;
+  for (const CAstStatement *st = s; st != NULL; st = st->GetNext()) EncodeStat(st, idx++);
+}
+
+void CAstFlat::EncodeStat(const CAstStatement *s, unsigned int idx)
+{
+  SAstFlatStat r = { 0, 0, 0, TokenIndex(s->GetToken()), TypeIndex(s->GetType()),
+                     NONE, NONE, 0, NONE, 0 };
+
+  if (const CAstStatAssign *a = dynamic_cast<const CAstStatAssign*>(s)) {
+    r.kind = akStatAssign;
+    r.a = EncodeExpr(a->GetLHS());
+    r.b = EncodeExpr(a->GetRHS());
+  } else if (const CAstStatCall *c = dynamic_cast<const CAstStatCall*>(s)) {
+    r.kind = akStatCall;
+    r.a = EncodeExpr(c->GetCall());
+  } else if (const CAstStatReturn *rt = dynamic_cast<const CAstStatReturn*>(s)) {
+    r.kind = akStatReturn;
+    if (rt->GetExpression() != NULL) r.a = EncodeExpr(rt->GetExpression());
+    r.c = _scope_idx[rt->GetScope()];
+  } else if (const CAstStatIf *i = dynamic_cast<const CAstStatIf*>(s)) {
+    r.kind = akStatIf;
+    r.a = EncodeExpr(i->GetCondition());
+    EncodeStatSeq(i->GetIfBody(), &r.b, &r.n);
+    EncodeStatSeq(i->GetElseBody(), &r.c, &r.m);
+  } else if (const CAstStatWhile *w = dynamic_cast<const CAstStatWhile*>(s)) {
+    r.kind = akStatWhile;
+    r.a = EncodeExpr(w->GetCondition());
+    EncodeStatSeq(w->GetBody(), &r.b, &r.n);
+  } else if (dynamic_cast<const CAstStatError*>(s) != NULL) {
+    r.kind = akStatError;
+  } else {
+    assert(false);
+  }
+
+  _stats[idx] = r;
+}
+
+unsigned int CAstFlat::EncodeExpr(const CAstExpression *e)
+{
+  unsigned int idx = (unsigned int)_exprs.size();
+  _exprs.resize(idx + 1);
+  EncodeExpr(e, idx);
+  return idx;
+}
+
+void CAstFlat::EncodeExpr(const CAstExpression *e, unsigned int idx)
+{
+  SAstFlatExpr r = { 0, 0, 0, TokenIndex(e->GetToken()), TypeIndex(e->GetType()),
+                     NONE, NONE, 0 };
+
+  if (e->GetParenthesized()) r.flags |= FLAG_PARENTHESIZED;
+
+  if (const CAstBinaryOp *b = dynamic_cast<const CAstBinaryOp*>(e)) {
+    r.kind = akBinaryOp;
+    r.oper = b->GetOperation();
+    r.a = EncodeExpr(b->GetLeft());
+    r.b = EncodeExpr(b->GetRight());
+  } else if (const CAstUnaryOp *u = dynamic_cast<const CAstUnaryOp*>(e)) {
+    r.kind = akUnaryOp;
+    r.oper = u->GetOperation();
+    r.a = EncodeExpr(u->GetOperand());
+  } else if (const CAstSpecialOp *sp = dynamic_cast<const CAstSpecialOp*>(e)) {
+    r.kind = akSpecialOp;
+    r.oper = sp->GetOperation();
+    r.a = EncodeExpr(sp->GetOperand());
+  } else if (const CAstFunctionCall *f = dynamic_cast<const CAstFunctionCall*>(e)) {
+    // argument and index lists are reserved as contiguous spans
+    r.kind = akFunctionCall;
+    r.a = SymbolIndex(f->GetSymbol());
+    r.b = (unsigned int)_exprs.size();
+    r.n = f->GetNArgs();
+    _exprs.resize(_exprs.size() + r.n);
+    for (unsigned int i=0; i<r.n; i++) EncodeExpr(f->GetArg(i), r.b + i);
+  } else if (const CAstArrayDesignator *ad = dynamic_cast<const CAstArrayDesignator*>(e)) {
+    r.kind = akArrayDesignator;
+    r.a = SymbolIndex(ad->GetSymbol());
+    r.b = (unsigned int)_exprs.size();
+    r.n = ad->GetNIndices();
+    _exprs.resize(_exprs.size() + r.n);
+    for (unsigned int i=0; i<r.n; i++) EncodeExpr(ad->GetIndex(i), r.b + i);
+  } else if (const CAstDesignator *d = dynamic_cast<const CAstDesignator*>(e)) {
+    r.kind = akDesignator;
+    r.a = SymbolIndex(d->GetSymbol());
+  } else if (const CAstConstant *c = dynamic_cast<const CAstConstant*>(e)) {
+    r.kind = akConstant;
+    unsigned long long v = (unsigned long long)c->GetValue();
+    r.b = (unsigned int)v;
+    r.n = (unsigned int)(v >> 32);
+  } else if (const CAstStringConstant *sc = dynamic_cast<const CAstStringConstant*>(e)) {
+    r.kind = akStringConstant;
+    r.a = StringIndex(sc->GetValue());
+  } else if (dynamic_cast<const CAstExprError*>(e) != NULL) {
+    r.kind = akExprError;
+  } else {
+    assert(false);
+  }
+
+  _exprs[idx] = r;
+}
+
+unsigned int CAstFlat::TokenIndex(const CToken &t)
+{
+  if (t.GetOffset() == CToken::NO_OFFSET) return NONE;
+
+  // tokens in the token array are ordered by their offset
+  if (_tokens != NULL) {
+    const CToken *end = _tokens + _ntokens;
+    const CToken *p = lower_bound(_tokens, end, t,
+        [](const CToken &a, const CToken &b) { return a.GetOffset() < b.GetOffset(); });
+    if ((p != end) && (p->GetOffset() == t.GetOffset()) && (p->GetType() == t.GetType())) {
+      return (unsigned int)(p - _tokens);
+    }
+  }
+
+  auto it = _token_idx.find(t.GetOffset());
+  if ((it != _token_idx.end()) && (_own[it->second - _ntokens].GetType() == t.GetType())) {
+    return it->second;
+  }
+
+  unsigned int idx = (unsigned int)(_ntokens + _own.size());
+  _own.push_back(t);
+  _token_idx[t.GetOffset()] = idx;
+  return idx;
+}
+
+unsigned int CAstFlat::TypeIndex(const CType *t)
+{
+  auto it = _ptr_idx.find(t);
+  if (it != _ptr_idx.end()) return it->second;
+
+  unsigned int idx = (unsigned int)_types.size();
+  _types.push_back(t);
+  _ptr_idx[t] = idx;
+  return idx;
+}
+
+unsigned int CAstFlat::SymbolIndex(const CSymbol *s)
+{
+  auto it = _ptr_idx.find(s);
+  if (it != _ptr_idx.end()) return it->second;
+
+  // symbols not found in a symbol table are placeholders of the error-recovering parser
+  auto c = _copy.find(s);
+  CSymbol *copy = c != _copy.end() ? c->second : NULL;
+  if (copy == NULL) {
+    copy = CopySymbol(s);
+    _extra.push_back(copy);
+  }
+
+  unsigned int idx = (unsigned int)_symbols.size();
+  _symbols.push_back(copy);
+  _ptr_idx[s] = idx;
+  return idx;
+}
+
+unsigned int CAstFlat::StringIndex(const string &s)
+{
+  _strings.push_back(s);
+  return (unsigned int)_strings.size() - 1;
+}
+
+CSymtab* CAstFlat::CopySymtab(const CSymtab *s, CSymtab *parent)
+{
+  CSymtab *st = parent != NULL ? new CSymtab(parent) : new CSymtab();
+
+  // copies are inserted in the same order and thus occupy the same slots
+  const vector<CSymbol*> &symbols = s->GetSymbols();
+  for (size_t i=0; i<symbols.size(); i++) st->AddSymbol(CopySymbol(symbols[i]));
+
+  return st;
+}
+
+CSymbol* CAstFlat::CopySymbol(const CSymbol *s)
+{
+  const string name = s->GetName();
+  const CType *type = s->GetDataType();
+  CSymbol *c;
+
+  switch (s->GetSymbolType()) {
+    case stGlobal:    c = new CSymGlobal(name, type); break;
+    case stLocal:     c = new CSymLocal(name, type); break;
+    case stParam:     c = new CSymParam(static_cast<const CSymParam*>(s)->GetIndex(), name, type);
+                      break;
+    case stProcedure: c = new CSymProc(name, type, static_cast<const CSymProc*>(s)->IsExternal());
+                      break;
+    case stConstant:  c = new CSymConstant(name, type, s->GetData()); break;
+    default:          c = new CSymbol(name, s->GetSymbolType(), type); break;
+  }
+  if (s->GetData().IsValid()) c->SetData(s->GetData());
+
+  _copy[s] = c;
+  return c;
+}
+
+CToken CAstFlat::GetToken(unsigned int idx) const
+{
+  if (idx == NONE) return CToken();
+  if (idx < _ntokens) return _tokens[idx];
+  return _own[idx - _ntokens];
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CAstFlatStatSeq
+//
+CAstFlatStatement CAstFlatStatSeq::GetStatement(unsigned int i) const
+{
+  assert(i < _count);
+  return CAstFlatStatement(_ast, _first + i);
+}
+
+ostream& CAstFlatStatSeq::print(ostream &out, int indent) const
+{
+  for (unsigned int i=0; i<_count; i++) GetStatement(i).print(out, indent);
+  return out;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CAstFlatExpression
+//
+EAstKind CAstFlatExpression::GetKind(void) const
+{
+  return (EAstKind)_ast->_exprs[_idx].kind;
+}
+
+CToken CAstFlatExpression::GetToken(void) const
+{
+  return _ast->GetToken(_ast->_exprs[_idx].token);
+}
+
+const CType* CAstFlatExpression::GetType(void) const
+{
+  return _ast->_types[_ast->_exprs[_idx].type];
+}
+
+bool CAstFlatExpression::GetParenthesized(void) const
+{
+  return (_ast->_exprs[_idx].flags & FLAG_PARENTHESIZED) != 0;
+}
+
+EOperation CAstFlatExpression::GetOperation(void) const
+{
+  assert((GetKind() == akBinaryOp) || (GetKind() == akUnaryOp) || (GetKind() == akSpecialOp));
+  return (EOperation)_ast->_exprs[_idx].oper;
+}
+
+CAstFlatExpression CAstFlatExpression::GetLeft(void) const
+{
+  assert(GetKind() == akBinaryOp);
+  return CAstFlatExpression(_ast, _ast->_exprs[_idx].a);
+}
+
+CAstFlatExpression CAstFlatExpression::GetRight(void) const
+{
+  assert(GetKind() == akBinaryOp);
+  return CAstFlatExpression(_ast, _ast->_exprs[_idx].b);
+}
+
+CAstFlatExpression CAstFlatExpression::GetOperand(void) const
+{
+  assert((GetKind() == akUnaryOp) || (GetKind() == akSpecialOp));
+  return CAstFlatExpression(_ast, _ast->_exprs[_idx].a);
+}
+
+const CSymbol* CAstFlatExpression::GetSymbol(void) const
+{
+  assert((GetKind() == akFunctionCall) || (GetKind() == akDesignator) ||
+         (GetKind() == akArrayDesignator));
+  return _ast->_symbols[_ast->_exprs[_idx].a];
+}
+
+unsigned int CAstFlatExpression::GetNArgs(void) const
+{
+  assert(GetKind() == akFunctionCall);
+  return _ast->_exprs[_idx].n;
+}
+
+CAstFlatExpression CAstFlatExpression::GetArg(unsigned int index) const
+{
+  assert(index < GetNArgs());
+  return CAstFlatExpression(_ast, _ast->_exprs[_idx].b + index);
+}
+
+unsigned int CAstFlatExpression::GetNIndices(void) const
+{
+  assert(GetKind() == akArrayDesignator);
+  return _ast->_exprs[_idx].n;
+}
+
+CAstFlatExpression CAstFlatExpression::GetIndex(unsigned int index) const
+{
+  assert(index < GetNIndices());
+  return CAstFlatExpression(_ast, _ast->_exprs[_idx].b + index);
+}
+
+long long CAstFlatExpression::GetValue(void) const
+{
+  assert(GetKind() == akConstant);
+  const SAstFlatExpr &r = _ast->_exprs[_idx];
+  return (long long)(((unsigned long long)r.n << 32) | r.b);
+}
+
+string CAstFlatExpression::GetValueStr(void) const
+{
+  if (GetKind() == akStringConstant) return _ast->_strings[_ast->_exprs[_idx].a];
+
+  ostringstream out;
+
+  if (GetType() == CTypeManager::Get()->GetBool()) {
+    out << (GetValue() == 0 ? "false" : "true");
+  } else {
+    out << dec << GetValue();
+  }
+
+  return out.str();
+}
+
+ostream& CAstFlatExpression::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  switch (GetKind()) {
+    case akBinaryOp:
+      out << ind << GetOperation() << " ";
+      PrintType(out, GetType());
+      out << endl;
+      GetLeft().print(out, indent+2);
+      GetRight().print(out, indent+2);
+      break;
+
+    case akUnaryOp:
+    case akSpecialOp:
+      out << ind << GetOperation() << " ";
+      PrintType(out, GetType());
+      out << endl;
+      GetOperand().print(out, indent+2);
+      break;
+
+    case akFunctionCall:
+      out << ind << "call " << GetSymbol() << " ";
+      PrintType(out, GetType());
+      out << endl;
+      for (unsigned int i=0; i<GetNArgs(); i++) GetArg(i).print(out, indent+2);
+      break;
+
+    case akDesignator:
+    case akArrayDesignator:
+      out << ind << GetSymbol() << " ";
+      PrintType(out, GetType());
+      out << endl;
+      if (GetKind() == akArrayDesignator) {
+        for (unsigned int i=0; i<GetNIndices(); i++) GetIndex(i).print(out, indent+2);
+      }
+      break;
+
+    case akConstant:
+      out << ind << GetValueStr() << " ";
+      PrintType(out, GetType());
+      out << endl;
+      break;
+
+    case akStringConstant:
+      out << ind << '"' << GetValueStr() << '"' << " ";
+      PrintType(out, GetType());
+      out << endl;
+      break;
+
+    case akExprError:
+      out << ind << "error <INVALID>" << endl;
+      break;
+
+    default:
+      assert(false);
+  }
+
+  return out;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CAstFlatStatement
+//
+EAstKind CAstFlatStatement::GetKind(void) const
+{
+  return (EAstKind)_ast->_stats[_idx].kind;
+}
+
+CToken CAstFlatStatement::GetToken(void) const
+{
+  return _ast->GetToken(_ast->_stats[_idx].token);
+}
+
+const CType* CAstFlatStatement::GetType(void) const
+{
+  return _ast->_types[_ast->_stats[_idx].type];
+}
+
+CAstFlatExpression CAstFlatStatement::GetLHS(void) const
+{
+  assert(GetKind() == akStatAssign);
+  return CAstFlatExpression(_ast, _ast->_stats[_idx].a);
+}
+
+CAstFlatExpression CAstFlatStatement::GetRHS(void) const
+{
+  assert(GetKind() == akStatAssign);
+  return CAstFlatExpression(_ast, _ast->_stats[_idx].b);
+}
+
+CAstFlatExpression CAstFlatStatement::GetCall(void) const
+{
+  assert(GetKind() == akStatCall);
+  return CAstFlatExpression(_ast, _ast->_stats[_idx].a);
+}
+
+bool CAstFlatStatement::HasExpression(void) const
+{
+  assert(GetKind() == akStatReturn);
+  return _ast->_stats[_idx].a != CAstFlat::NONE;
+}
+
+CAstFlatExpression CAstFlatStatement::GetExpression(void) const
+{
+  assert(HasExpression());
+  return CAstFlatExpression(_ast, _ast->_stats[_idx].a);
+}
+
+CAstFlatExpression CAstFlatStatement::GetCondition(void) const
+{
+  assert((GetKind() == akStatIf) || (GetKind() == akStatWhile));
+  return CAstFlatExpression(_ast, _ast->_stats[_idx].a);
+}
+
+CAstFlatStatSeq CAstFlatStatement::GetIfBody(void) const
+{
+  assert(GetKind() == akStatIf);
+  return CAstFlatStatSeq(_ast, _ast->_stats[_idx].b, _ast->_stats[_idx].n);
+}
+
+CAstFlatStatSeq CAstFlatStatement::GetElseBody(void) const
+{
+  assert(GetKind() == akStatIf);
+  return CAstFlatStatSeq(_ast, _ast->_stats[_idx].c, _ast->_stats[_idx].m);
+}
+
+CAstFlatStatSeq CAstFlatStatement::GetBody(void) const
+{
+  assert(GetKind() == akStatWhile);
+  return CAstFlatStatSeq(_ast, _ast->_stats[_idx].b, _ast->_stats[_idx].n);
+}
+
+ostream& CAstFlatStatement::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  switch (GetKind()) {
+    case akStatAssign:
+      out << ind << ":=" << " ";
+      PrintType(out, GetType());
+      out << endl;
+      GetLHS().print(out, indent+2);
+      GetRHS().print(out, indent+2);
+      break;
+
+    case akStatCall:
+      GetCall().print(out, indent);
+      break;
+
+    case akStatReturn:
+      out << ind << "return" << " ";
+      PrintType(out, GetType());
+      out << endl;
+      if (HasExpression()) GetExpression().print(out, indent+2);
+      break;
+
+    case akStatIf: {
+      out << ind << "if cond" << endl;
+      GetCondition().print(out, indent+2);
+      out << ind << "if-body" << endl;
+      CAstFlatStatSeq body = GetIfBody();
+      if (body.GetNStatements() > 0) body.print(out, indent+2);
+      else out << ind << "  empty." << endl;
+      out << ind << "else-body" << endl;
+      body = GetElseBody();
+      if (body.GetNStatements() > 0) body.print(out, indent+2);
+      else out << ind << "  empty." << endl;
+      break;
+    }
+
+    case akStatWhile: {
+      out << ind << "while cond" << endl;
+      GetCondition().print(out, indent+2);
+      out << ind << "while-body" << endl;
+      CAstFlatStatSeq body = GetBody();
+      if (body.GetNStatements() > 0) body.print(out, indent+2);
+      else out << ind << "  empty." << endl;
+      break;
+    }
+
+    case akStatError:
+      out << ind << "error" << endl;
+      break;
+
+    default:
+      assert(false);
+  }
+
+  return out;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CAstFlatScope
+//
+CToken CAstFlatScope::GetToken(void) const
+{
+  return _ast->GetToken(_ast->_scopes[_idx].token);
+}
+
+const string& CAstFlatScope::GetName(void) const
+{
+  return _ast->_strings[_ast->_scopes[_idx].name];
+}
+
+bool CAstFlatScope::HasParent(void) const
+{
+  return _ast->_scopes[_idx].parent != CAstFlat::NONE;
+}
+
+CAstFlatScope CAstFlatScope::GetParent(void) const
+{
+  assert(HasParent());
+  return CAstFlatScope(_ast, _ast->_scopes[_idx].parent);
+}
+
+unsigned int CAstFlatScope::GetNumChildren(void) const
+{
+  return _ast->_scopes[_idx].nchild;
+}
+
+CAstFlatScope CAstFlatScope::GetChild(unsigned int i) const
+{
+  assert(i < GetNumChildren());
+  return CAstFlatScope(_ast, _ast->_scopes[_idx].child + i);
+}
+
+const CSymtab* CAstFlatScope::GetSymbolTable(void) const
+{
+  return _ast->_scopes[_idx].symtab;
+}
+
+const CSymProc* CAstFlatScope::GetSymbol(void) const
+{
+  unsigned int sym = _ast->_scopes[_idx].symbol;
+  if (sym == CAstFlat::NONE) return NULL;
+  return dynamic_cast<const CSymProc*>(_ast->_symbols[sym]);
+}
+
+CAstFlatStatSeq CAstFlatScope::GetStatementSequence(void) const
+{
+  return CAstFlatStatSeq(_ast, _ast->_scopes[_idx].stat, _ast->_scopes[_idx].nstat);
+}
+
+ostream& CAstFlatScope::print(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  out << ind << "CAstScope: '" << GetName() << "'" << endl;
+  out << ind << "  symbol table:" << endl;
+  GetSymbolTable()->print(out, indent+4);
+  out << ind << "  statement list:" << endl;
+  CAstFlatStatSeq seq = GetStatementSequence();
+  if (seq.GetNStatements() > 0) seq.print(out, indent+4);
+  else out << ind << "    empty." << endl;
+
+  out << ind << "  nested scopes:" << endl;
+  if (GetNumChildren() > 0) {
+    for (unsigned int i=0; i<GetNumChildren(); i++) GetChild(i).print(out, indent+4);
+  } else {
+    out << ind << "    empty." << endl;
+  }
+  out << ind << endl;
+
+  return out;
+}
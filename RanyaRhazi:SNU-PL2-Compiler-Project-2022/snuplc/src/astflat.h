@@ -0,0 +1,383 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL flat (index-based) abstract syntax tree
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __SnuPL_ASTFLAT_H__
+#define __SnuPL_ASTFLAT_H__
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+using namespace std;
+
+class CAstFlat;
+class CAstFlatStatement;
+
+//--------------------------------------------------------------------------------------------------
+/// @brief node kinds of the flat AST
+///
+enum EAstKind {
+  // statements
+  akStatAssign=0,                   ///< assignment
+  akStatCall,                       ///< procedure call
+  akStatReturn,                     ///< return statement
+  akStatIf,                         ///< if statement
+  akStatWhile,                      ///< while statement
+  akStatError,                      ///< statement that could not be parsed
+
+  // expressions
+  akBinaryOp,                       ///< binary operation
+  akUnaryOp,                        ///< unary operation
+  akSpecialOp,                      ///< special operation
+  akFunctionCall,                   ///< function call
+  akDesignator,                     ///< designator
+  akArrayDesignator,                ///< array designator
+  akConstant,                       ///< constant
+  akStringConstant,                 ///< string constant
+  akExprError,                      ///< expression that could not be parsed
+};
+
+/// @brief flat AST statement record (32 bytes)
+///
+/// a/b hold expression indices, statement spans are (first, count) pairs into the statement
+/// array. assign: a=lhs, b=rhs; call: a=call; return: a=expression, c=scope;
+/// if: a=condition, b/n=if-body, c/m=else-body; while: a=condition, b/n=body.
+struct SAstFlatStat {
+  unsigned char  kind;              ///< node kind (EAstKind)
+  unsigned char  flags;             ///< unused
+  unsigned short pad;               ///< unused
+  unsigned int   token;             ///< token index
+  unsigned int   type;              ///< type index
+  unsigned int   a, b, n, c, m;     ///< operands (see above)
+};
+
+/// @brief flat AST expression record (24 bytes)
+///
+/// binary op: a=left, b=right; unary/special op: a=operand (special: b=type index);
+/// function call: a=symbol, b/n=arguments; designator: a=symbol; array designator: a=symbol,
+/// b/n=indices; constant: b/n=low/high word of the value; string constant: a=string index.
+/// Arguments and indices are spans (first, count) into the expression array.
+struct SAstFlatExpr {
+  unsigned char  kind;              ///< node kind (EAstKind)
+  unsigned char  oper;              ///< operation (EOperation)
+  unsigned short flags;             ///< flags (bit 0: parenthesized)
+  unsigned int   token;             ///< token index
+  unsigned int   type;              ///< type index
+  unsigned int   a, b, n;           ///< operands (see above)
+};
+
+/// @brief flat AST scope record
+///
+/// Statement sequences and nested scopes are spans (first, count) into the statement and scope
+/// arrays, respectively.
+struct SAstFlatScope {
+  CSymtab       *symtab;            ///< symbol table (copy owned by the encoding)
+  unsigned int   token;             ///< token index
+  unsigned int   name;              ///< string index of the name
+  unsigned int   parent;            ///< parent scope (or NONE)
+  unsigned int   symbol;            ///< symbol index of the procedure (or NONE)
+  unsigned int   stat, nstat;       ///< statement sequence
+  unsigned int   child, nchild;     ///< nested scopes
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief flat AST statement sequence view
+///
+class CAstFlatStatSeq {
+  public:
+    /// @brief constructor
+    CAstFlatStatSeq(const CAstFlat *ast, unsigned int first, unsigned int count)
+      : _ast(ast), _first(first), _count(count) {};
+
+    /// @brief return the number of statements
+    unsigned int GetNStatements(void) const { return _count; };
+
+    /// @brief return the @a i-th statement
+    CAstFlatStatement GetStatement(unsigned int i) const;
+
+    /// @brief print the statements to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    ostream& print(ostream &out, int indent=0) const;
+
+  private:
+    const CAstFlat *_ast;           ///< flat AST
+    unsigned int    _first;         ///< first statement
+    unsigned int    _count;         ///< number of statements
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief flat AST expression view
+///
+/// Mirrors the accessors of the CAstExpression class hierarchy.
+///
+class CAstFlatExpression {
+  public:
+    /// @brief constructor
+    CAstFlatExpression(const CAstFlat *ast, unsigned int idx) : _ast(ast), _idx(idx) {};
+
+    /// @brief return the index of the expression in the expression array
+    unsigned int GetId(void) const { return _idx; };
+
+    /// @brief return the node kind
+    EAstKind GetKind(void) const;
+
+    /// @brief return the token associated with this node
+    CToken GetToken(void) const;
+
+    /// @brief return the type of this node (as computed when the AST was encoded)
+    const CType* GetType(void) const;
+
+    /// @brief return whether the expression was parenthesized
+    bool GetParenthesized(void) const;
+
+    /// @name operations
+    /// @{
+    EOperation GetOperation(void) const;
+    CAstFlatExpression GetLeft(void) const;
+    CAstFlatExpression GetRight(void) const;
+    CAstFlatExpression GetOperand(void) const;
+    /// @}
+
+    /// @name function calls and designators
+    /// @{
+    const CSymbol* GetSymbol(void) const;
+    unsigned int GetNArgs(void) const;
+    CAstFlatExpression GetArg(unsigned int index) const;
+    unsigned int GetNIndices(void) const;
+    CAstFlatExpression GetIndex(unsigned int index) const;
+    /// @}
+
+    /// @name constants
+    /// @{
+    long long GetValue(void) const;
+    string GetValueStr(void) const;
+    /// @}
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    ostream& print(ostream &out, int indent=0) const;
+
+  private:
+    const CAstFlat *_ast;           ///< flat AST
+    unsigned int    _idx;           ///< index into the expression array
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief flat AST statement view
+///
+/// Mirrors the accessors of the CAstStatement class hierarchy.
+///
+class CAstFlatStatement {
+  public:
+    /// @brief constructor
+    CAstFlatStatement(const CAstFlat *ast, unsigned int idx) : _ast(ast), _idx(idx) {};
+
+    /// @brief return the node kind
+    EAstKind GetKind(void) const;
+
+    /// @brief return the token associated with this node
+    CToken GetToken(void) const;
+
+    /// @brief return the type of this node (as computed when the AST was encoded)
+    const CType* GetType(void) const;
+
+    /// @name statement operands
+    /// @{
+    CAstFlatExpression GetLHS(void) const;
+    CAstFlatExpression GetRHS(void) const;
+    CAstFlatExpression GetCall(void) const;
+    bool HasExpression(void) const;
+    CAstFlatExpression GetExpression(void) const;
+    CAstFlatExpression GetCondition(void) const;
+    CAstFlatStatSeq GetIfBody(void) const;
+    CAstFlatStatSeq GetElseBody(void) const;
+    CAstFlatStatSeq GetBody(void) const;
+    /// @}
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    ostream& print(ostream &out, int indent=0) const;
+
+  private:
+    const CAstFlat *_ast;           ///< flat AST
+    unsigned int    _idx;           ///< index into the statement array
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief flat AST scope view
+///
+/// Mirrors the accessors of CAstScope/CAstProcedure.
+///
+class CAstFlatScope {
+  public:
+    /// @brief constructor
+    CAstFlatScope(const CAstFlat *ast, unsigned int idx) : _ast(ast), _idx(idx) {};
+
+    /// @brief return the token associated with this node
+    CToken GetToken(void) const;
+
+    /// @brief return the name of the scope
+    const string& GetName(void) const;
+
+    /// @brief return whether the scope has a superordinate scope
+    bool HasParent(void) const;
+
+    /// @brief return the superordinate scope
+    CAstFlatScope GetParent(void) const;
+
+    /// @brief return the number of subordinate scopes
+    unsigned int GetNumChildren(void) const;
+
+    /// @brief return the @a i-th subordinate scope
+    CAstFlatScope GetChild(unsigned int i) const;
+
+    /// @brief return the symbol table of the scope
+    const CSymtab* GetSymbolTable(void) const;
+
+    /// @brief return the symbol of a procedure/function scope (NULL for the module)
+    const CSymProc* GetSymbol(void) const;
+
+    /// @brief return the statement sequence
+    CAstFlatStatSeq GetStatementSequence(void) const;
+
+    /// @brief print the node to an output stream
+    /// @param out output stream
+    /// @param indent indentation
+    ostream& print(ostream &out, int indent=0) const;
+
+  private:
+    const CAstFlat *_ast;           ///< flat AST
+    unsigned int    _idx;           ///< index into the scope array
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief flat (index-based) AST
+///
+/// Alternative encoding of the AST of a module. Scopes, statements and expressions live in
+/// typed contiguous arrays and refer to each other through 32-bit indices. The statements of a
+/// statement sequence as well as the arguments of a call and the indices of an array designator
+/// are stored contiguously. Tokens are referred to by their index in the token array of the
+/// scanner (or of the encoding, if the scanner has no token array); symbols, types and strings
+/// are held in deduplicated side tables.
+///
+/// The encoding holds copies of the symbol tables of the module and of all symbols referred to
+/// by its nodes; the module (including its arena) may be deleted once it has been encoded.
+/// Types and interned strings belong to the compilation context, and tokens to the token array
+/// passed to the constructor; both must outlive the encoding.
+///
+class CAstFlat {
+  friend class CAstFlatStatSeq;
+  friend class CAstFlatExpression;
+  friend class CAstFlatStatement;
+  friend class CAstFlatScope;
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor: encode the AST of a module
+    ///
+    /// @param module module
+    /// @param tokens token array of the module (may be NULL)
+    /// @param ntokens number of tokens in @a tokens
+    CAstFlat(const CAstModule *module, const CToken *tokens=NULL, size_t ntokens=0);
+
+    /// @brief destructor
+    ~CAstFlat(void);
+
+    /// @}
+
+    /// @brief return the module scope
+    CAstFlatScope GetModule(void) const { return CAstFlatScope(this, 0); };
+
+    /// @name statistics
+    /// @{
+
+    /// @brief return the number of expressions
+    size_t GetNExpressions(void) const { return _exprs.size(); };
+
+    /// @brief return the number of statements
+    size_t GetNStatements(void) const { return _stats.size(); };
+
+    /// @brief return the number of bytes used by the encoding (without the symbol tables)
+    size_t GetSize(void) const;
+
+    /// @}
+
+    const static unsigned int NONE = 0xffffffff; ///< null index
+
+  private:
+    /// @name encoding
+    /// @{
+
+    void EncodeScope(const CAstScope *s, unsigned int idx, unsigned int parent);
+    void EncodeStatSeq(const CAstStatement *s, unsigned int *first, unsigned int *count);
+    void EncodeStat(const CAstStatement *s, unsigned int idx);
+    unsigned int EncodeExpr(const CAstExpression *e);
+    void EncodeExpr(const CAstExpression *e, unsigned int idx);
+
+    unsigned int TokenIndex(const CToken &t);
+    unsigned int TypeIndex(const CType *t);
+    unsigned int SymbolIndex(const CSymbol *s);
+    unsigned int StringIndex(const string &s);
+
+    CSymtab* CopySymtab(const CSymtab *s, CSymtab *parent);
+    CSymbol* CopySymbol(const CSymbol *s);
+
+    /// @}
+
+    /// @brief return the token with index @a idx
+    CToken GetToken(unsigned int idx) const;
+
+    vector<SAstFlatScope> _scopes;  ///< scopes (module first)
+    vector<SAstFlatStat>  _stats;   ///< statements
+    vector<SAstFlatExpr>  _exprs;   ///< expressions
+    vector<const CType*>  _types;   ///< types (index 0 = NULL)
+    vector<const CSymbol*> _symbols; ///< symbols (copies)
+    vector<CSymbol*>      _extra;   ///< copies of symbols that belong to no symbol table
+    vector<string>        _strings; ///< names and string constants
+    const CToken         *_tokens;  ///< token array of the module
+    size_t                _ntokens; ///< number of tokens in _tokens
+    vector<CToken>        _own;     ///< tokens not in _tokens (index _ntokens+i)
+
+    unordered_map<const CAstScope*, unsigned int> _scope_idx; ///< scope indices (encoding)
+    unordered_map<const void*, unsigned int> _ptr_idx; ///< type/symbol indices (encoding)
+    unordered_map<unsigned int, unsigned int> _token_idx; ///< own token indices (encoding)
+    unordered_map<const CSymbol*, CSymbol*> _copy; ///< copies of symbols (encoding)
+};
+
+
+#endif // __SnuPL_ASTFLAT_H__
@@ -0,0 +1,693 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL parser benchmark
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <malloc.h>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <typeinfo>
+
+#include "scanner.h"
+#include "parser.h"
+#include "astflat.h"
+using namespace std;
+
+//--------------------------------------------------------------------------------------------------
+// corpus generator
+//
+// Each corpus stresses one construct that machine-generated code produces in bulk. The size
+// parameter is the nesting depth (nested), the number of operands (chain), the number of
+// identifiers (idlist), or the number of statements (mixed).
+//
+
+/// @brief corpus kinds
+enum ECorpus {
+  cNested=0,                        ///< deeply nested parenthesized expression
+  cChain,                           ///< one long expression with mixed precedence
+  cIdList,                          ///< long identifier list in a variable declaration
+  cMixed,                           ///< many short statements
+  cNumCorpora,
+};
+
+const char *ECorpusName[cNumCorpora] = { "nested", "chain", "idlist", "mixed" };
+
+/// @brief corpus sizes
+const unsigned int CorpusSize[] = { 1000, 10000, 100000 };
+const size_t NumCorpusSizes = sizeof(CorpusSize) / sizeof(CorpusSize[0]);
+
+static const char *Operators[] = {
+  " + ", " - ", " * ", " / ", " && ", " || ",
+};
+static const size_t NumOperators = sizeof(Operators) / sizeof(Operators[0]);
+
+static const char *RelOperators[] = {
+  " = ", " # ", " < ", " <= ", " > ", " >= ",
+};
+static const size_t NumRelOperators = sizeof(RelOperators) / sizeof(RelOperators[0]);
+
+/// @brief append a random operand
+static void Operand(unsigned int i, string &s)
+{
+  switch (i % 7) {
+    case 0:  s += to_string(i); break;
+    case 1:  s += "a"; break;
+    case 2:  s += "b[" + to_string(i % 10) + "]"; break;
+    case 3:  s += "f(a, " + to_string(i) + ")"; break;
+    case 4:  s += "(-c)"; break;
+    case 5:  s += "!d"; break;
+    default: s += "c[a][" + to_string(i % 3) + " + a]"; break;
+  }
+}
+
+/// @brief generate a corpus
+static string Generate(ECorpus corpus, unsigned int size)
+{
+  string s;
+
+  s += "module bench;\n\n";
+  s += "var a: integer; b: integer[10]; c: integer[4][4]; d: boolean;\n";
+
+  if (corpus == cIdList) {
+    s += "    ";
+    for (unsigned int i=0; i<size; i++) {
+      if (i > 0) s += (i % 10 == 0) ? ",\n    " : ", ";
+      s += "v" + to_string(i);
+    }
+    s += ": integer;\n";
+  }
+
+  s += "\nfunction f(x, y: integer): integer;\nbegin\n  return x + y\nend f;\n\n";
+  s += "begin\n";
+
+  switch (corpus) {
+    case cNested:
+      s += "  a := ";
+      for (unsigned int i=0; i<size; i++) s += (i % 3 == 0) ? "-(" : "(";
+      s += "a";
+      for (unsigned int i=0; i<size; i++) {
+        s += Operators[i % NumOperators];
+        Operand(i, s);
+        s += ")";
+      }
+      s += "\n";
+      break;
+
+    case cChain:
+      s += "  a := ";
+      for (unsigned int i=0; i<size; i++) {
+        if (i > 0) s += Operators[(i * 7) % NumOperators];
+        Operand(i, s);
+        if (i % 8 == 7) s += "\n      ";
+      }
+      s += RelOperators[size % NumRelOperators];
+      s += "a\n";
+      break;
+
+    case cIdList:
+      s += "  v0 := v" + to_string(size - 1) + "\n";
+      break;
+
+    case cMixed:
+      for (unsigned int i=0; i<size; i++) {
+        if (i > 0) s += ";\n";
+        if (i % 5 == 4) {
+          s += "  if (a" + string(RelOperators[i % NumRelOperators]) + "b[1]) then d := true end";
+        } else {
+          s += "  a := ";
+          for (unsigned int k=0; k<1 + i % 6; k++) {
+            if (k > 0) s += Operators[(i + k) % NumOperators];
+            if (k == 2) s += "(";
+            Operand(i + k, s);
+            if (k == 2) s += " * 2)";
+          }
+        }
+      }
+      s += "\n";
+      break;
+
+    default:
+      break;
+  }
+
+  s += "end bench.\n";
+  return s;
+}
+
+/// @brief generate a corpus of @a n subroutines with a few statements each
+static string GenerateSubroutines(unsigned int n)
+{
+  string s;
+
+  s += "module bench;\n\n";
+  s += "var a: integer; b: integer[10]; c: integer[4][4]; d: boolean;\n";
+  s += "\nfunction f(x, y: integer): integer;\nbegin\n  return x + y\nend f;\n";
+
+  for (unsigned int i=0; i<n; i++) {
+    string name = "p" + to_string(i);
+
+    // module-level declarations between the subroutines
+    if (i % 10 == 0) s += "\nvar g" + to_string(i) + ": integer;\n";
+
+    s += "\nprocedure " + name + "(x: integer; y: integer[]);\n";
+    s += "var t: integer; u: char[8];\nbegin\n";
+    for (unsigned int k=0; k<8; k++) {
+      if (k > 0) s += ";\n";
+      if (k % 4 == 3) {
+        s += "  while (t" + string(RelOperators[(i + k) % NumRelOperators]) + "x) do "
+             "t := t + y[1]; u[1] := 'a' end";
+      } else if (k == 4) {
+        s += "  if (d) then g" + to_string(i / 10 * 10) + " := x; WriteStr(\"" + name + "\") "
+             "else t := 0 end";
+      } else {
+        s += "  a := ";
+        for (unsigned int j=0; j<1 + (i + k) % 6; j++) {
+          if (j > 0) s += Operators[(i + j + k) % NumOperators];
+          Operand(i + j + k, s);
+        }
+      }
+    }
+    s += "\nend " + name + ";\n";
+  }
+
+  s += "\nbegin\n  a := f(a, 1)\nend bench.\n";
+  return s;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// AST digest
+//
+// The digest is computed without recursion so that it also works for ASTs that are too deep
+// for CAstNode::print().
+//
+
+/// @brief FNV-1a hash
+class CDigest {
+  public:
+    CDigest(void) : _hash(0xcbf29ce484222325ULL), _nodes(0) {};
+
+    void Add(const void *data, size_t n)
+    {
+      const unsigned char *p = (const unsigned char*)data;
+      for (size_t i=0; i<n; i++) {
+        _hash ^= p[i];
+        _hash *= 0x100000001b3ULL;
+      }
+    };
+
+    void Add(const string &s) { Add(s.data(), s.size() + 1); };
+    void Add(long long v) { Add(&v, sizeof(v)); };
+
+    /// @brief add a scope, its symbols, statements, and expressions (but not its children)
+    void Add(const CAstScope *s);
+
+    unsigned long long GetDigest(void) const { return _hash; };
+    unsigned long long GetNodes(void) const { return _nodes; };
+
+  private:
+    unsigned long long _hash;
+    unsigned long long _nodes;
+};
+
+void CDigest::Add(const CAstScope *s)
+{
+  Add(s->GetName());
+
+  // the order in which string symbols enter the global symbol table depends on the strategy
+  vector<string> names;
+  for (const CSymbol *sym : s->GetSymbolTable()->GetSymbols()) names.push_back(sym->GetName());
+  sort(names.begin(), names.end());
+  for (const string &name : names) Add(name);
+
+  vector<const CAstNode*> stack;
+  for (const CAstStatement *st = s->GetStatementSequence(); st != NULL; st = st->GetNext()) {
+    stack.push_back(st);
+  }
+  reverse(stack.begin(), stack.end());
+
+  while (!stack.empty()) {
+    const CAstNode *n = stack.back();
+    stack.pop_back();
+    _nodes++;
+
+    Add(string(typeid(*n).name()));
+    Add((long long)n->GetToken().GetOffset());
+    Add((long long)n->GetID());
+
+    vector<const CAstNode*> children;
+
+    if (const CAstStatAssign *a = dynamic_cast<const CAstStatAssign*>(n)) {
+      children = { a->GetLHS(), a->GetRHS() };
+    } else if (const CAstStatCall *c = dynamic_cast<const CAstStatCall*>(n)) {
+      children = { c->GetCall() };
+    } else if (const CAstStatReturn *r = dynamic_cast<const CAstStatReturn*>(n)) {
+      if (r->GetExpression() != NULL) children = { r->GetExpression() };
+    } else if (const CAstStatIf *i = dynamic_cast<const CAstStatIf*>(n)) {
+      children = { i->GetCondition() };
+      Add((long long)-1);
+      for (const CAstStatement *st = i->GetIfBody(); st != NULL; st = st->GetNext()) {
+        children.push_back(st);
+      }
+      Add((long long)children.size());
+      for (const CAstStatement *st = i->GetElseBody(); st != NULL; st = st->GetNext()) {
+        children.push_back(st);
+      }
+    } else if (const CAstStatWhile *w = dynamic_cast<const CAstStatWhile*>(n)) {
+      children = { w->GetCondition() };
+      for (const CAstStatement *st = w->GetBody(); st != NULL; st = st->GetNext()) {
+        children.push_back(st);
+      }
+    } else if (const CAstExpression *e = dynamic_cast<const CAstExpression*>(n)) {
+      Add((long long)e->GetParenthesized());
+
+      if (const CAstBinaryOp *b = dynamic_cast<const CAstBinaryOp*>(e)) {
+        Add((long long)b->GetOperation());
+        children = { b->GetLeft(), b->GetRight() };
+      } else if (const CAstUnaryOp *u = dynamic_cast<const CAstUnaryOp*>(e)) {
+        Add((long long)u->GetOperation());
+        children = { u->GetOperand() };
+      } else if (const CAstFunctionCall *f = dynamic_cast<const CAstFunctionCall*>(e)) {
+        Add(f->GetSymbol()->GetName());
+        for (unsigned int i=0; i<f->GetNArgs(); i++) children.push_back(f->GetArg(i));
+      } else if (const CAstArrayDesignator *ad = dynamic_cast<const CAstArrayDesignator*>(e)) {
+        Add(ad->GetSymbol()->GetName());
+        for (unsigned int i=0; i<ad->GetNIndices(); i++) children.push_back(ad->GetIndex(i));
+      } else if (const CAstDesignator *d = dynamic_cast<const CAstDesignator*>(e)) {
+        Add(d->GetSymbol()->GetName());
+      } else if (const CAstConstant *k = dynamic_cast<const CAstConstant*>(e)) {
+        Add(k->GetValue());
+      }
+    }
+
+    Add((long long)children.size());
+    stack.insert(stack.end(), children.rbegin(), children.rend());
+  }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// allocation counter
+//
+// The global allocation functions are replaced to count heap allocations. The parser must not
+// allocate while consuming punctuation and keyword tokens. The two corpora of each pair below
+// build the same AST and differ only in such tokens, so parsing them must perform the same
+// number of allocations.
+//
+// The bytes held by objects allocated through operator new are tracked as well, including their
+// peak. Arena blocks are allocated with malloc() and only show up in the heap usage (HeapBytes()).
+//
+
+static atomic<unsigned long long> NumAllocations(0);
+static atomic<long long> LiveBytes(0);
+static atomic<long long> PeakBytes(0);
+
+void* operator new(size_t size)
+{
+  NumAllocations++;
+  void *p = malloc(size > 0 ? size : 1);
+  if (p == NULL) throw bad_alloc();
+
+  long long live = LiveBytes += malloc_usable_size(p);
+  long long peak = PeakBytes;
+  while ((live > peak) && !PeakBytes.compare_exchange_weak(peak, live));
+
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  if (p != NULL) LiveBytes -= malloc_usable_size(p);
+  free(p);
+}
+
+/// @brief return the number of bytes in use on the heap
+static long long HeapBytes(void)
+{
+  return (long long)mallinfo2().uordblks;
+}
+
+/// @brief statements differing only in punctuation/keyword tokens
+struct SAllocPair {
+  const char *name;                 ///< name
+  const char *base;                 ///< base statement
+  const char *extra;                ///< base statement with additional tokens
+  unsigned int ntokens;             ///< number of additional tokens
+} AllocPairs[] = {
+  { "parentheses", "a := a + b[1] * f(a, 2)",
+                   "a := ((a) + (b[(1)]) * (f(((a)), (2))))", 16 },
+  { "else",        "if (a <= 1) then a := 1 end", "if (a <= 1) then a := 1 else end", 1 },
+};
+const size_t NumAllocPairs = sizeof(AllocPairs) / sizeof(AllocPairs[0]);
+
+/// @brief generate a corpus of @a n copies of statement @a stat
+static string Generate(const char *stat, unsigned int n)
+{
+  string s = "module bench;\n\n"
+             "var a: integer; b: integer[10]; d: boolean;\n\n"
+             "function f(x, y: integer): integer;\nbegin\n  return x + y\nend f;\n\n"
+             "begin\n";
+  for (unsigned int i=0; i<n; i++) {
+    if (i > 0) s += ";\n";
+    s += "  ";
+    s += stat;
+  }
+  s += "\nend bench.\n";
+  return s;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// benchmark
+//
+
+const char *EParseModeName[] = { "iterative", "recursive" };
+
+/// @brief parse a corpus
+///
+/// @param text corpus
+/// @param mode parsing strategy
+/// @param digest if not NULL, the AST is added to this digest
+/// @param nthreads number of threads parsing subroutine bodies
+/// @param lazy parse subroutine bodies on demand (the digest materializes them)
+/// @retval true on success
+static bool Parse(const string &text, EParseMode mode, CDigest *digest, unsigned int nthreads=1,
+                  bool lazy=false)
+{
+  CScanner s(new CBufferSource(text.data(), text.size()));
+  CActiveContext active(s.GetContext());
+  // node ids and names of string symbols are part of the digest; both are numbered per context
+  CParser p(&s, mode, nthreads, lazy);
+
+  CAstModule *m = dynamic_cast<CAstModule*>(p.Parse());
+
+  if (p.HasError()) {
+    const CToken *error = p.GetErrorToken();
+    cerr << "syntax error at " << error->GetLineNumber() << ":" << error->GetCharPosition()
+         << " : " << p.GetErrorMessage() << endl;
+    return false;
+  }
+
+  if (digest != NULL) {
+    digest->Add(m);
+    for (size_t i=0; i<m->GetNumChildren(); i++) digest->Add(m->GetChild(i));
+  }
+
+  delete m;
+  return true;
+}
+
+/// @brief memory held by the pointer-based and the flat AST of a corpus
+struct SFlatMemory {
+  long long   ast;                  ///< pointer AST
+  long long   peak;                 ///< peak while encoding (pointer AST and flat AST)
+  long long   flat;                 ///< flat AST after the pointer AST has been deleted
+  bool        match;                ///< the flat AST prints like the pointer AST
+};
+
+/// @brief encode the AST of a corpus and measure the heap usage
+///
+/// @param text corpus
+/// @param m (out) heap usage
+/// @retval true on success
+static bool MeasureFlat(const string &text, SFlatMemory *m)
+{
+  CScanner s(new CBufferSource(text.data(), text.size()));
+  CActiveContext active(s.GetContext());
+
+  // the flat AST refers to tokens by their index in the token array
+  size_t ntokens;
+  if (!s.Tokenize(1)) return false;
+  const CToken *tokens = s.GetTokens(&ntokens);
+
+  CParser p(&s);
+  long long base = HeapBytes();
+  CAstModule *module = dynamic_cast<CAstModule*>(p.Parse());
+  if (p.HasError()) return false;
+  m->ast = HeapBytes() - base;
+
+  // the printed reference is not part of either AST
+  ostringstream reference;
+  module->print(reference);
+  long long before = HeapBytes(), live = LiveBytes;
+  base = before - m->ast;
+
+  PeakBytes = live;
+  CAstFlat *flat = new CAstFlat(module, tokens, ntokens);
+  m->peak = before - base + (PeakBytes - live);
+
+  delete module;
+  m->flat = HeapBytes() - base;
+
+  ostringstream out;
+  flat->GetModule().print(out);
+  m->match = out.str() == reference.str();
+
+  delete flat;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int reps = 5;
+  unsigned int maxdepth = 10000;
+  size_t nsizes = NumCorpusSizes;
+
+  for (int i=1; i<argc; i++) {
+    if ((strcmp(argv[i], "-r") == 0) && (i+1 < argc)) reps = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-d") == 0) && (i+1 < argc)) maxdepth = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-q") == 0) nsizes = 2;
+    else {
+      cerr << "usage: " << argv[0] << " [-r reps] [-d depth] [-q]" << endl
+           << "  -r reps   number of timed runs per corpus and mode (best run is reported)" << endl
+           << "  -d depth  largest nesting depth/identifier list given to the recursive parser"
+           << endl
+           << "  -q        skip the largest corpora" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (reps < 1) reps = 1;
+
+  bool ok = true;
+
+  cout << left << setw(8) << "corpus" << right << setw(8) << "size" << setw(10) << "bytes"
+       << setw(10) << "nodes" << "  " << left << setw(10) << "mode" << right
+       << setw(10) << "ms" << setw(10) << "MB/s" << "  check" << endl;
+
+  for (int c=0; c<cNumCorpora; c++) {
+    for (size_t sz=0; sz<nsizes; sz++) {
+      ECorpus corpus = (ECorpus)c;
+      unsigned int size = CorpusSize[sz];
+      string text = Generate(corpus, size);
+
+      // the recursive parser uses a few stack frames per nesting level or list element
+      bool deep = ((corpus == cNested) || (corpus == cIdList)) && (size > maxdepth);
+
+      CDigest reference;
+      bool parsed = Parse(text, pmIterative, &reference);
+      ok = ok && parsed;
+
+      for (int md=pmIterative; md<=pmRecursive; md++) {
+        EParseMode mode = (EParseMode)md;
+
+        cout << left << setw(8) << ECorpusName[corpus] << right << setw(8) << size
+             << setw(10) << text.size() << setw(10) << reference.GetNodes() << "  "
+             << left << setw(10) << EParseModeName[mode] << right;
+
+        if (!parsed || ((mode == pmRecursive) && deep)) {
+          cout << setw(10) << "-" << setw(10) << "-" << "  "
+               << (parsed ? "skipped (too deep)" : "ERROR") << endl;
+          continue;
+        }
+
+        // both strategies must build the same AST
+        bool match = true;
+        if (mode != pmIterative) {
+          CDigest digest;
+          match = Parse(text, mode, &digest) && (digest.GetDigest() == reference.GetDigest()) &&
+                  (digest.GetNodes() == reference.GetNodes());
+          ok = ok && match;
+        }
+
+        double best = 0.0;
+        for (int r=0; r<reps; r++) {
+          chrono::steady_clock::time_point start = chrono::steady_clock::now();
+          Parse(text, mode, NULL);
+          chrono::duration<double> d = chrono::steady_clock::now() - start;
+          if ((r == 0) || (d.count() < best)) best = d.count();
+        }
+
+        cout << fixed << setprecision(2) << setw(10) << best * 1e3
+             << setprecision(1) << setw(10) << text.size() / best / 1e6
+             << "  " << (match ? "ok" : "MISMATCH") << endl;
+      }
+    }
+  }
+
+  cout << endl << (ok ? "all ASTs match." : "AST MISMATCH.") << endl << endl;
+
+  // parallel parsing of subroutine bodies
+  unsigned int ncores = thread::hardware_concurrency();
+  bool same = true;
+
+  cout << left << setw(8) << "subrs" << right << setw(10) << "bytes" << setw(10) << "nodes"
+       << setw(10) << "threads" << setw(10) << "ms" << setw(10) << "MB/s" << "  check" << endl;
+
+  for (size_t sz=0; sz<nsizes; sz++) {
+    unsigned int size = CorpusSize[sz] / 10;
+    string text = GenerateSubroutines(size);
+
+    CDigest reference;
+    bool parsed = Parse(text, pmIterative, &reference);
+    same = same && parsed;
+
+    for (unsigned int nthreads=1; nthreads<=max(4u, ncores); nthreads*=2) {
+      cout << left << setw(8) << size << right << setw(10) << text.size()
+           << setw(10) << reference.GetNodes() << setw(10) << nthreads;
+
+      if (!parsed) {
+        cout << setw(10) << "-" << setw(10) << "-" << "  ERROR" << endl;
+        continue;
+      }
+
+      // the parallel parse must be identical to the sequential one, including node ids
+      CDigest digest;
+      bool match = Parse(text, pmIterative, &digest, nthreads) &&
+                   (digest.GetDigest() == reference.GetDigest()) &&
+                   (digest.GetNodes() == reference.GetNodes());
+      same = same && match;
+
+      double best = 0.0;
+      for (int r=0; r<reps; r++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Parse(text, pmIterative, NULL, nthreads);
+        chrono::duration<double> d = chrono::steady_clock::now() - start;
+        if ((r == 0) || (d.count() < best)) best = d.count();
+      }
+
+      cout << fixed << setprecision(2) << setw(10) << best * 1e3
+           << setprecision(1) << setw(10) << text.size() / best / 1e6
+           << "  " << (match ? "ok" : "MISMATCH") << endl;
+    }
+
+    // lazy parsing skips the bodies; materialized bodies are numbered after the module
+    if (parsed) {
+      CDigest digest;
+      bool match = Parse(text, pmIterative, &digest, 1, true) &&
+                   (digest.GetNodes() == reference.GetNodes());
+      same = same && match;
+
+      double best = 0.0;
+      for (int r=0; r<reps; r++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        Parse(text, pmIterative, NULL, 1, true);
+        chrono::duration<double> d = chrono::steady_clock::now() - start;
+        if ((r == 0) || (d.count() < best)) best = d.count();
+      }
+
+      cout << left << setw(8) << size << right << setw(10) << text.size()
+           << setw(10) << reference.GetNodes() << setw(10) << "lazy"
+           << fixed << setprecision(2) << setw(10) << best * 1e3
+           << setprecision(1) << setw(10) << text.size() / best / 1e6
+           << "  " << (match ? "ok" : "MISMATCH") << endl;
+    }
+  }
+
+  cout << endl << (same ? "parallel and lazy parses match." : "PARALLEL/LAZY PARSE MISMATCH.")
+       << endl
+       << "(" << ncores << " hardware threads)" << endl << endl;
+  ok = ok && same;
+
+  // memory of the flat AST once the pointer AST has been deleted
+  bool flatok = true;
+
+  cout << left << setw(8) << "flat" << right << setw(8) << "size" << setw(10) << "bytes"
+       << setw(12) << "AST" << setw(12) << "peak" << setw(12) << "flat" << "  check" << endl;
+
+  for (size_t sz=0; sz<nsizes; sz++) {
+    const char *name[] = { "mixed", "subrs" };
+    unsigned int size[] = { CorpusSize[sz], CorpusSize[sz] / 10 };
+    string text[] = { Generate(cMixed, size[0]), GenerateSubroutines(size[1]) };
+
+    for (int c=0; c<2; c++) {
+      SFlatMemory m;
+      bool match = MeasureFlat(text[c], &m) && m.match;
+      flatok = flatok && match;
+
+      cout << left << setw(8) << name[c] << right << setw(8) << size[c]
+           << setw(10) << text[c].size();
+      if (match) {
+        cout << setw(12) << m.ast << setw(12) << m.peak << setw(12) << m.flat << "  ok" << endl;
+      } else {
+        cout << setw(12) << "-" << setw(12) << "-" << setw(12) << "-" << "  MISMATCH" << endl;
+      }
+    }
+  }
+
+  cout << endl << (flatok ? "flat ASTs of deleted modules match."
+                          : "FLAT AST MISMATCH.") << endl << endl;
+  ok = ok && flatok;
+
+  // allocations per additional punctuation/keyword token
+  const unsigned int nstats = 10000;
+  bool noalloc = true;
+
+  cout << left << setw(12) << "tokens" << "  " << setw(10) << "mode" << right << setw(12)
+       << "allocs" << setw(12) << "+tokens" << setw(12) << "+allocs" << "  check" << endl;
+
+  for (size_t i=0; i<NumAllocPairs; i++) {
+    const SAllocPair &pair = AllocPairs[i];
+    string base = Generate(pair.base, nstats), extra = Generate(pair.extra, nstats);
+
+    for (int md=pmIterative; md<=pmRecursive; md++) {
+      unsigned long long a0 = NumAllocations;
+      Parse(base, (EParseMode)md, NULL);
+      unsigned long long a1 = NumAllocations;
+      Parse(extra, (EParseMode)md, NULL);
+      unsigned long long a2 = NumAllocations;
+
+      long long delta = (long long)(a2 - a1) - (long long)(a1 - a0);
+      noalloc = noalloc && (delta == 0);
+
+      cout << left << setw(12) << pair.name << "  " << setw(10) << EParseModeName[md] << right
+           << setw(12) << a1 - a0 << setw(12) << pair.ntokens * nstats << setw(12) << delta
+           << "  " << (delta == 0 ? "ok" : "ALLOCATES") << endl;
+    }
+  }
+
+  cout << endl << (noalloc ? "no allocations for punctuation and keyword tokens."
+                           : "PUNCTUATION/KEYWORD TOKENS ALLOCATE.") << endl;
+  ok = ok && noalloc;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,531 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL scanner benchmark
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#include "scanner.h"
+using namespace std;
+
+//--------------------------------------------------------------------------------------------------
+// corpus generator
+//
+// Corpora are generated from a fixed seed and are identical on every run and host. Each mix
+// stresses one part of the scanner: identifiers/keywords, line comments, string and character
+// constants, or numbers.
+//
+
+/// @brief corpus mixes
+enum EMix {
+  mIdent=0,                         ///< identifier-heavy
+  mComment,                         ///< comment-heavy
+  mString,                          ///< string-heavy
+  mNumber,                          ///< number-heavy
+  mNumMixes,
+};
+
+const char *EMixName[mNumMixes] = { "ident", "comment", "string", "number" };
+
+/// @brief corpus sizes in bytes
+const size_t CorpusSize[] = { 64 << 10, 1 << 20, 16 << 20 };
+const size_t NumCorpusSizes = sizeof(CorpusSize) / sizeof(CorpusSize[0]);
+
+/// @brief token digests of the corpora as produced by the reference scanner
+///
+/// The digest is the FNV-1a hash of the text dump (CToken::print format) of all tokens. If a
+/// change to the scanner alters these values, it changed the scanner's output.
+struct SGolden {
+  unsigned long long ntokens;       ///< number of tokens (including tEOF)
+  unsigned long long digest;        ///< digest of the token dump
+} Golden[mNumMixes][NumCorpusSizes] = {
+  { {   11171, 0xe5e1d30a0ebf0bcdULL },     // ident
+    {  180889, 0x2f0938c160ab9438ULL },
+    { 2896278, 0xa2d455cce6d8c733ULL } },
+  { {    2983, 0xab7ff38661693529ULL },     // comment
+    {   47250, 0x0ef46b64c7bb83f7ULL },
+    {  766090, 0x5b033aaf8b05fcb4ULL } },
+  { {    7674, 0x440c486f75b2b235ULL },     // string
+    {  121551, 0xac480c977235063aULL },
+    { 1952789, 0x160a4f6e47f240aeULL } },
+  { {    9932, 0x6ebb85bd2ffad61bULL },     // number
+    {  157107, 0x3e4722324b4114d0ULL },
+    { 2507019, 0x6da84afa31290401ULL } },
+};
+
+/// @brief deterministic pseudo-random number generator (xorshift64*)
+class CRandom {
+  public:
+    CRandom(unsigned long long seed) : _state(seed * 0x9e3779b97f4a7c15ULL + 1) {};
+
+    /// @brief return a random number in [0, n)
+    unsigned int Next(unsigned int n)
+    {
+      _state ^= _state >> 12;
+      _state ^= _state << 25;
+      _state ^= _state >> 27;
+      return (unsigned int)((_state * 0x2545f4914f6cdd1dULL) >> 32) % n;
+    };
+
+  private:
+    unsigned long long _state;
+};
+
+static const char *Words[] = {
+  "alpha", "beta", "gamma", "delta", "counter", "index", "result", "value", "buffer", "length",
+  "matrix", "row", "col", "sum", "tmp", "x", "y", "z", "node_count", "very_long_identifier_name",
+};
+static const size_t NumWords = sizeof(Words) / sizeof(Words[0]);
+
+static const char *Keywords[] = {
+  "if", "then", "else", "while", "do", "return", "integer", "longint", "boolean", "char",
+  "true", "false", "var", "begin", "end",
+};
+static const size_t NumKeywords = sizeof(Keywords) / sizeof(Keywords[0]);
+
+static const char *Operators[] = {
+  " + ", " - ", " * ", " / ", " && ", " || ", " = ", " # ", " < ", " <= ", " > ", " >= ",
+};
+static const size_t NumOperators = sizeof(Operators) / sizeof(Operators[0]);
+
+/// @brief append an identifier
+static void Ident(CRandom &r, string &s)
+{
+  s += Words[r.Next(NumWords)];
+  if (r.Next(3) == 0) s += to_string(r.Next(1000));
+}
+
+/// @brief append a number
+static void Number(CRandom &r, string &s)
+{
+  switch (r.Next(4)) {
+    case 0:  s += to_string(r.Next(10)); break;
+    case 1:  s += to_string(r.Next(100000)); break;
+    case 2:  s += to_string(r.Next(1000000000)) + to_string(r.Next(1000000000)) + "L"; break;
+    default: s += to_string(r.Next(1 << 30)); break;
+  }
+}
+
+/// @brief append a string or character constant
+static void String(CRandom &r, string &s)
+{
+  static const char *escapes[] = { "\\n", "\\t", "\\\"", "\\'", "\\\\", "\\0", "\\x41" };
+
+  if (r.Next(4) == 0) {
+    s += '\'';
+    if (r.Next(3) == 0) s += escapes[r.Next(7)];
+    else s += (char)('a' + r.Next(26));
+    s += '\'';
+    return;
+  }
+
+  s += '"';
+  unsigned int n = 4 + r.Next(60);
+  for (unsigned int i=0; i<n; i++) {
+    if (r.Next(16) == 0) s += escapes[r.Next(7)];
+    else if (r.Next(6) == 0) s += ' ';
+    else s += (char)('a' + r.Next(26));
+  }
+  s += '"';
+}
+
+/// @brief append a comment (up to the end of the line)
+static void Comment(CRandom &r, string &s)
+{
+  s += "// ";
+  unsigned int n = 3 + r.Next(12);
+  for (unsigned int i=0; i<n; i++) {
+    s += Words[r.Next(NumWords)];
+    s += (r.Next(5) == 0) ? ", " : " ";
+  }
+}
+
+/// @brief append an expression whose operands are chosen according to the mix
+static void Expression(CRandom &r, EMix mix, string &s)
+{
+  unsigned int n = 1 + r.Next(5);
+  for (unsigned int i=0; i<n; i++) {
+    if (i > 0) s += Operators[r.Next(NumOperators)];
+
+    unsigned int k = r.Next(8);
+    if ((mix == mNumber) && (k < 6)) Number(r, s);
+    else if ((mix == mString) && (k < 5)) String(r, s);
+    else if (k < 2) Number(r, s);
+    else if (k == 2) {
+      Ident(r, s);
+      s += "[";
+      Ident(r, s);
+      s += "]";
+    } else Ident(r, s);
+  }
+}
+
+/// @brief generate a corpus of (at least) @a size bytes
+static string Generate(EMix mix, size_t size)
+{
+  CRandom r(mix * 1000003 + size);
+  string s;
+  s.reserve(size + 256);
+
+  s += "module bench;\n\n";
+  s += "begin\n";
+
+  while (s.size() < size) {
+    unsigned int k = r.Next(10);
+    s += "  ";
+
+    if ((mix == mComment) && (k < 6)) {
+      Comment(r, s);
+    } else if ((mix == mIdent) && (k < 3)) {
+      s += Keywords[r.Next(NumKeywords)];
+      s += " ";
+      Ident(r, s);
+      s += " ";
+      Ident(r, s);
+      s += ";";
+    } else if (k == 0) {
+      s += "WriteStr(";
+      String(r, s);
+      s += ")";
+    } else {
+      Ident(r, s);
+      s += " := ";
+      Expression(r, mix, s);
+      s += ";";
+      if ((mix == mComment) || (r.Next(8) == 0)) {
+        s += " ";
+        Comment(r, s);
+      }
+    }
+
+    s += "\n";
+  }
+
+  s += "end bench.\n";
+  return s;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// token digest
+//
+
+/// @brief stream buffer computing the FNV-1a hash of everything written to it
+class CDigestBuf : public streambuf {
+  public:
+    CDigestBuf(void) : _hash(0xcbf29ce484222325ULL) {};
+
+    unsigned long long GetDigest(void) const { return _hash; };
+
+  protected:
+    virtual int overflow(int c)
+    {
+      if (c != EOF) Add((const char*)&c, 1);
+      return c;
+    };
+
+    virtual streamsize xsputn(const char *s, streamsize n)
+    {
+      Add(s, n);
+      return n;
+    };
+
+  private:
+    void Add(const char *s, size_t n)
+    {
+      for (size_t i=0; i<n; i++) {
+        _hash ^= (unsigned char)s[i];
+        _hash *= 0x100000001b3ULL;
+      }
+    };
+
+    unsigned long long _hash;
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// benchmark
+//
+
+/// @brief scanner modes
+enum EMode {
+  mdMemory=0,                       ///< in-memory source, sequential scanning
+  mdStream,                         ///< stream source, sequential scanning
+  mdTokenized,                      ///< in-memory source, tokenized on worker threads
+  mdNumModes,
+};
+
+const char *EModeName[mdNumModes] = { "memory", "stream", "tokenized" };
+
+/// @brief scan a corpus in a given mode
+///
+/// @param text corpus
+/// @param mode scanner mode
+/// @param nthreads number of threads (tokenized mode)
+/// @param out if not NULL, the token dump is written to this stream
+/// @retval number of tokens (including tEOF)
+static unsigned long long Scan(const string &text, EMode mode, unsigned int nthreads,
+                               ostream *out)
+{
+  istringstream in(text);
+  CScanner *s;
+
+  if (mode == mdStream) s = new CScanner(&in);
+  else s = new CScanner(new CBufferSource(text.data(), text.size()));
+
+  if (mode == mdTokenized) s->Tokenize(nthreads);
+
+  // the token writer resolves values and positions through the active context
+  CActiveContext active(s->GetContext());
+
+  CTokenWriter *w = (out != NULL) ? new CTokenWriter(out) : NULL;
+  unsigned long long ntokens = 0;
+
+  while (s->Good()) {
+    const CToken &t = s->Peek();
+    ntokens++;
+    if (w != NULL) w->Write(t, 2);
+    if (t.GetType() == tEOF) break;
+    s->Get();
+  }
+
+  delete w;
+  delete s;
+
+  return ntokens;
+}
+
+/// @brief dump a token sequence (type, offset, and value of each token)
+///
+/// @param tokens tokens
+/// @param ntokens number of tokens
+/// @param ctx context of the tokens
+/// @retval dump
+static string Dump(const CToken *tokens, size_t ntokens, CContext *ctx)
+{
+  CActiveContext active(ctx);
+  ostringstream out;
+
+  for (size_t i=0; i<ntokens; i++) {
+    out << tokens[i].GetName() << " " << tokens[i].GetOffset() << " " << tokens[i].GetValue()
+        << endl;
+  }
+
+  return out.str();
+}
+
+/// @brief check that the token array of @a text is the token stream of the sequential scanner
+///
+/// @param text input
+/// @param nthreads number of threads tokenizing the input
+/// @retval true if the token array and the token stream are identical
+static bool CheckTokenize(const string &text, unsigned int nthreads)
+{
+  CScanner seq(text);
+  vector<CToken> stream;
+  while (seq.Good()) {
+    stream.push_back(seq.Get());
+    if (stream.back().GetType() == tEOF) break;
+  }
+
+  // the constructor has filled the lookahead already
+  CScanner tok(text);
+  size_t ntokens;
+  if (!tok.Tokenize(nthreads)) return false;
+  const CToken *tokens = tok.GetTokens(&ntokens);
+
+  return Dump(stream.data(), stream.size(), seq.GetContext()) ==
+         Dump(tokens, ntokens, tok.GetContext());
+}
+
+/// @brief text fragments inserted by random edits
+const char *EditText[] = {
+  "", "x", "i2", "42", "3L", " ", "\n", "\n\n", "\"", "'", "\"a\\n\"", "'\\t'", "//", "// c\n",
+  "begin", "end", ":=", "<=", "#", "(", ")", ";", "\\",
+};
+static const size_t NumEditText = sizeof(EditText) / sizeof(EditText[0]);
+
+/// @brief check re-lexing against tokenizing the edited input from scratch
+///
+/// Applies a series of random edits to a corpus, re-lexing the input after each edit.
+///
+/// @param mix corpus mix
+/// @param nedits number of edits
+/// @retval true if every re-lexed token array matches that of the edited input
+static bool CheckRelex(EMix mix, unsigned int nedits)
+{
+  CRandom r(mix + 4711);
+  string text = Generate(mix, 16 << 10);
+
+  CScanner s(new CMemorySource(text));
+  if (!s.Tokenize(1)) return false;
+
+  for (unsigned int e=0; e<nedits; e++) {
+    size_t offset = r.Next((unsigned int)text.size() + 1);
+    size_t len = min<size_t>(r.Next(24), text.size() - offset);
+    string edit;
+    for (unsigned int k=r.Next(4); k>0; k--) edit += EditText[r.Next(NumEditText)];
+
+    text.replace(offset, len, edit);
+    if (!s.Relex(offset, len, edit)) return false;
+
+    CScanner fresh(text);
+    size_t n, nfresh;
+    if (!fresh.Tokenize(1)) return false;
+    const CToken *tokens = s.GetTokens(&n), *ftokens = fresh.GetTokens(&nfresh);
+
+    if (Dump(tokens, n, s.GetContext()) != Dump(ftokens, nfresh, fresh.GetContext())) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// @brief small inputs whose lookahead reaches the end of the input
+const char *Degenerate[] = {
+  "", " ", "\n\n\t", "// comment", "// comment\n// comment\n", "module", "x // comment\n",
+};
+static const size_t NumDegenerate = sizeof(Degenerate) / sizeof(Degenerate[0]);
+
+int main(int argc, char *argv[])
+{
+  int reps = 5;
+  unsigned int nthreads = thread::hardware_concurrency();
+  size_t nsizes = NumCorpusSizes;
+  const char *dir = NULL;
+  bool update = false;
+
+  for (int i=1; i<argc; i++) {
+    if ((strcmp(argv[i], "-r") == 0) && (i+1 < argc)) reps = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-j") == 0) && (i+1 < argc)) nthreads = atoi(argv[++i]);
+    else if ((strcmp(argv[i], "-w") == 0) && (i+1 < argc)) dir = argv[++i];
+    else if (strcmp(argv[i], "-q") == 0) nsizes = 2;
+    else if (strcmp(argv[i], "-g") == 0) update = true;
+    else {
+      cerr << "usage: " << argv[0] << " [-r reps] [-j threads] [-q] [-w dir] [-g]" << endl
+           << "  -r reps     number of timed runs per corpus and mode (best run is reported)" << endl
+           << "  -j threads  number of threads in tokenized mode" << endl
+           << "  -q          skip the largest corpora" << endl
+           << "  -w dir      write the corpora to <dir>/<mix>_<size>.mod" << endl
+           << "  -g          print the golden digests of the current scanner" << endl;
+      return EXIT_FAILURE;
+    }
+  }
+  if (reps < 1) reps = 1;
+  if (nthreads < 1) nthreads = 1;
+
+  bool ok = true;
+
+  if (!update) {
+    cout << left << setw(10) << "corpus" << right << setw(10) << "size"
+         << setw(10) << "tokens" << "  " << left << setw(10) << "mode" << right
+         << setw(10) << "MB/s" << setw(12) << "Mtokens/s" << "  check" << endl;
+  }
+
+  for (int m=0; m<mNumMixes; m++) {
+    for (size_t sz=0; sz<nsizes; sz++) {
+      EMix mix = (EMix)m;
+      string text = Generate(mix, CorpusSize[sz]);
+
+      if (dir != NULL) {
+        ostringstream fn;
+        fn << dir << "/" << EMixName[mix] << "_" << CorpusSize[sz] << ".mod";
+        ofstream f(fn.str().c_str(), ios::out | ios::binary);
+        f << text;
+      }
+
+      // check the output of every mode against the reference scanner
+      unsigned long long ntokens[mdNumModes], digest[mdNumModes];
+      for (int md=0; md<mdNumModes; md++) {
+        CDigestBuf buf;
+        ostream out(&buf);
+        ntokens[md] = Scan(text, (EMode)md, nthreads, &out);
+        digest[md] = buf.GetDigest();
+      }
+
+      if (update) {
+        // all modes must agree before their output can serve as a reference
+        for (int md=1; md<mdNumModes; md++) {
+          if ((ntokens[md] != ntokens[0]) || (digest[md] != digest[0])) {
+            cout << "MISMATCH in mode " << EModeName[md] << endl;
+            ok = false;
+          }
+        }
+
+        cout << "  { " << ntokens[mdMemory] << ", 0x" << hex << setw(16) << setfill('0')
+             << digest[mdMemory] << dec << setfill(' ') << "ULL },  // " << EMixName[mix]
+             << " " << CorpusSize[sz] << endl;
+        continue;
+      }
+
+      const SGolden &g = Golden[mix][sz];
+
+      for (int md=0; md<mdNumModes; md++) {
+        bool match = (ntokens[md] == g.ntokens) && (digest[md] == g.digest);
+        ok = ok && match;
+
+        double best = 0.0;
+        for (int r=0; r<reps; r++) {
+          chrono::steady_clock::time_point start = chrono::steady_clock::now();
+          Scan(text, (EMode)md, nthreads, NULL);
+          chrono::duration<double> d = chrono::steady_clock::now() - start;
+          if ((r == 0) || (d.count() < best)) best = d.count();
+        }
+
+        cout << left << setw(10) << EMixName[mix] << right << setw(10) << text.size()
+             << setw(10) << ntokens[md] << "  " << left << setw(10) << EModeName[md] << right
+             << fixed << setprecision(1) << setw(10) << text.size() / best / 1e6
+             << setprecision(2) << setw(12) << ntokens[md] / best / 1e6
+             << "  " << (match ? "ok" : "MISMATCH") << endl;
+      }
+    }
+  }
+
+  if (!update) cout << endl << (ok ? "all outputs match." : "OUTPUT MISMATCH.") << endl;
+
+  // token arrays of inputs that are exhausted by the lookahead of the scanner
+  if (!update) {
+    bool same = true;
+    for (size_t i=0; i<NumDegenerate; i++) same = CheckTokenize(Degenerate[i], nthreads) && same;
+    cout << (same ? "token arrays of degenerate inputs match."
+                  : "DEGENERATE INPUT TOKEN ARRAY MISMATCH.") << endl;
+    ok = ok && same;
+
+    bool relex = true;
+    for (int m=0; m<mNumMixes; m++) relex = CheckRelex((EMix)m, 500) && relex;
+    cout << (relex ? "re-lexed token arrays match." : "RE-LEXED TOKEN ARRAY MISMATCH.") << endl;
+    ok = ok && relex;
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
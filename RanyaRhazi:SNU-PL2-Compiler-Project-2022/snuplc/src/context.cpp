@@ -0,0 +1,223 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL per-compilation context
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <cassert>
+
+#include "context.h"
+#include "type.h"
+using namespace std;
+
+
+//--------------------------------------------------------------------------------------------------
+// CInterner
+//
+CInterner::CInterner(void)
+  : _table(64, 0)
+{
+  _strings.push_back("");
+  _hashes.push_back(Hash("", 0));
+  _table[_hashes[0] & (_table.size()-1)] = 1;
+}
+
+unsigned int CInterner::Hash(const char *str, size_t len)
+{
+  // FNV-1a
+  unsigned int h = 2166136261U;
+  for (size_t i=0; i<len; i++) h = (h ^ (unsigned char)str[i]) * 16777619U;
+  return h;
+}
+
+size_t CInterner::Probe(const char *str, size_t len, unsigned int h) const
+{
+  size_t mask = _table.size() - 1;
+  size_t slot = h & mask;
+
+  while (_table[slot] != 0) {
+    unsigned int id = _table[slot] - 1;
+    const string &s = _strings[id];
+
+    if ((_hashes[id] == h) && (s.size() == len) && (memcmp(s.data(), str, len) == 0)) break;
+    slot = (slot + 1) & mask;
+  }
+
+  return slot;
+}
+
+unsigned int CInterner::Intern(const char *str, size_t len)
+{
+  unsigned int h = Hash(str, len);
+  size_t slot = Probe(str, len, h);
+
+  if (_table[slot] != 0) return _table[slot] - 1;
+
+  unsigned int id = (unsigned int)_strings.size();
+  _strings.push_back(string(str, len));
+  _hashes.push_back(h);
+  _table[slot] = id + 1;
+
+  // keep the load factor below 1/2
+  if (2*_strings.size() > _table.size()) Grow();
+
+  return id;
+}
+
+unsigned int CInterner::Find(const string &str) const
+{
+  size_t slot = Probe(str.data(), str.size(), Hash(str.data(), str.size()));
+
+  return _table[slot] != 0 ? _table[slot] - 1 : NONE;
+}
+
+void CInterner::Grow(void)
+{
+  vector<unsigned int> table(2*_table.size(), 0);
+  size_t mask = table.size() - 1;
+
+  for (unsigned int id=0; id<_strings.size(); id++) {
+    size_t slot = _hashes[id] & mask;
+    while (table[slot] != 0) slot = (slot + 1) & mask;
+    table[slot] = id + 1;
+  }
+
+  _table.swap(table);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CContext
+//
+static thread_local CContext *_active_ctx = NULL;
+
+CContext::CContext(CSource *src, bool delete_src)
+  : _src(src), _delete_src(delete_src), _lines(1, 0), _lines_end(0), _tm(NULL), _node_id(0),
+    _scanners(0)
+{
+  assert(src != NULL);
+}
+
+CContext::~CContext(void)
+{
+  if (_active_ctx == this) _active_ctx = NULL;
+  if (_delete_src) delete _src;
+  delete _tm;
+}
+
+CContext* CContext::Get(void)
+{
+  return _active_ctx;
+}
+
+CContext* CContext::Activate(CContext *ctx)
+{
+  CContext *prev = _active_ctx;
+  _active_ctx = ctx;
+  return prev;
+}
+
+void CContext::Replace(size_t offset, size_t len, const string &text)
+{
+  // attached scanners would continue to read the deleted source
+  assert(_scanners == 0);
+
+  _src->Load();
+
+  const char *data = _src->GetData();
+  size_t size = _src->GetSize();
+  assert(offset + len <= size);
+
+  string edited;
+  edited.reserve(size - len + text.size());
+  edited.append(data, offset);
+  edited.append(text);
+  edited.append(data + offset + len, size - offset - len);
+
+  // patch the line starts: lines starting in the replaced range are removed, those after it
+  // are shifted, and the lines of the replacement text are inserted
+  vector<unsigned int>::iterator first = upper_bound(_lines.begin(), _lines.end(), offset);
+  if (_lines_end >= offset + len) {
+    long delta = (long)text.size() - (long)len;
+    vector<unsigned int> tail(upper_bound(first, _lines.end(), offset + len), _lines.end());
+
+    _lines.erase(first, _lines.end());
+    for (size_t i=0; i<text.size(); i++) {
+      if (text[i] == '\n') _lines.push_back((unsigned int)(offset + i + 1));
+    }
+    for (size_t i=0; i<tail.size(); i++) _lines.push_back((unsigned int)(tail[i] + delta));
+    _lines_end += delta;
+  } else {
+    _lines.erase(first, _lines.end());
+    _lines_end = min(_lines_end, offset);
+  }
+
+  if (_delete_src) delete _src;
+  _src = new CMemorySource(move(edited));
+  _delete_src = true;
+}
+
+void CContext::GetPosition(unsigned int offset, int *line, int *col)
+{
+  // extend the table of line starts lazily, up to the data available so far
+  if ((offset >= _lines_end) && (_lines_end < _src->GetSize())) {
+    const char *data = _src->GetData();
+    const char *end = data + _src->GetSize();
+    const char *p = data + _lines_end;
+
+    while ((p = (const char*)memchr(p, '\n', end - p)) != NULL) {
+      p++;
+      _lines.push_back((unsigned int)(p - data));
+    }
+    _lines_end = _src->GetSize();
+  }
+
+  size_t l = upper_bound(_lines.begin(), _lines.end(), offset) - _lines.begin() - 1;
+  *line = (int)l + 1;
+  *col = (int)(offset - _lines[l]) + 1;
+}
+
+CTypeManager* CContext::GetTypeManager(void)
+{
+  // subroutine bodies parsed in parallel may request it concurrently
+  call_once(_tm_once, [this]() { _tm = new CTypeManager(); });
+
+  return _tm;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CActiveContext
+//
+CActiveContext::CActiveContext(CContext *ctx)
+{
+  _prev = CContext::Activate(ctx);
+}
+
+CActiveContext::~CActiveContext(void)
+{
+  CContext::Activate(_prev);
+}
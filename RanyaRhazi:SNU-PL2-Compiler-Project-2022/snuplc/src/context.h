@@ -0,0 +1,235 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL per-compilation context
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __SnuPL_CONTEXT_H__
+#define __SnuPL_CONTEXT_H__
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "source.h"
+using namespace std;
+
+class CTypeManager;
+
+//--------------------------------------------------------------------------------------------------
+/// @brief string interner
+///
+/// Maps strings to dense, stable ids. Id 0 always denotes the empty string.
+///
+class CInterner {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    CInterner(void);
+
+    /// @}
+
+    /// @brief intern a string
+    ///
+    /// @param str characters (need not be zero-terminated)
+    /// @param len number of characters
+    /// @retval id of the string
+    unsigned int Intern(const char *str, size_t len);
+
+    /// @brief intern a string
+    ///
+    /// @param str string
+    /// @retval id of the string
+    unsigned int Intern(const string &str) { return Intern(str.data(), str.size()); };
+
+    /// @brief look up the id of a string without interning it
+    ///
+    /// Only reads the interner; may thus run concurrently with other lookups and with Intern()
+    /// calls of strings that are already interned.
+    ///
+    /// @param str string
+    /// @retval id of the string or NONE if the string has not been interned
+    unsigned int Find(const string &str) const;
+
+    /// @brief return the string with a given id
+    ///
+    /// @param id id of the string
+    /// @retval string
+    const string& GetString(unsigned int id) const { return _strings[id]; };
+
+    /// @brief return the number of interned strings
+    unsigned int GetSize(void) const { return (unsigned int)_strings.size(); };
+
+    const static unsigned int NONE = 0xffffffff; ///< id of strings that are not interned
+
+  private:
+    /// @brief compute the hash value of a string
+    static unsigned int Hash(const char *str, size_t len);
+
+    /// @brief return the slot of a string in the hash table (or the empty slot it would occupy)
+    size_t Probe(const char *str, size_t len, unsigned int h) const;
+
+    /// @brief double the size of the hash table
+    void Grow(void);
+
+    deque<string>        _strings;  ///< strings indexed by id (references remain valid)
+    vector<unsigned int> _hashes;   ///< hash values indexed by id
+    vector<unsigned int> _table;    ///< open-addressing hash table (id+1, 0 = empty slot)
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief per-compilation context
+///
+/// Holds the state shared by all phases of the compilation of one module: the input source, the
+/// string interner, the table of line starts used to map source offsets to line/column
+/// positions, the type manager, and the numbering of AST nodes. Tokens only store offsets and
+/// interned ids; they are resolved through the context that is active in the calling thread.
+/// Modules with separate contexts can thus be compiled concurrently.
+///
+class CContext {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param src input source
+    /// @param delete_src delete @a src upon destruction
+    CContext(CSource *src, bool delete_src=true);
+
+    /// @brief destructor
+    ~CContext(void);
+
+    /// @}
+
+    /// @name active context
+    /// @{
+
+    /// @brief return the context active in the calling thread
+    static CContext* Get(void);
+
+    /// @brief make @a ctx the context of the calling thread
+    ///
+    /// @param ctx context (may be NULL)
+    /// @retval previously active context
+    static CContext* Activate(CContext *ctx);
+
+    /// @}
+
+    /// @brief return the input source
+    CSource* GetSource(void) const { return _src; };
+
+    /// @brief return the string interner
+    CInterner* GetInterner(void) { return &_interner; };
+
+    /// @brief replace a byte range of the input
+    ///
+    /// The source is replaced by an in-memory copy of the edited input; the table of line starts
+    /// is patched. Offsets into the old input (e.g., in tokens) are no longer valid afterwards.
+    /// Scanners refer to the buffer of the source; no scanner may be attached to the context
+    /// (see CScanner::Relex() to edit the input of a scanner).
+    ///
+    /// @param offset start of the replaced byte range
+    /// @param len length of the replaced byte range
+    /// @param text replacement text
+    void Replace(size_t offset, size_t len, const string &text);
+
+    /// @name scanners reading the input
+    /// @{
+
+    /// @brief register a scanner reading the input
+    void Attach(void) { _scanners++; };
+
+    /// @brief unregister a scanner reading the input
+    void Detach(void) { _scanners--; };
+
+    /// @brief return the number of scanners reading the input
+    int GetNumScanners(void) const { return _scanners; };
+
+    /// @}
+
+    /// @brief map a source offset to a line/column position
+    ///
+    /// Offsets past the end of the input are reported on the last line.
+    ///
+    /// @param offset offset into the source
+    /// @param line line number (1-based)
+    /// @param col column (1-based)
+    void GetPosition(unsigned int offset, int *line, int *col);
+
+    /// @name per-compilation state
+    /// @{
+
+    /// @brief return the type manager of the compilation (created on first use)
+    CTypeManager* GetTypeManager(void);
+
+    /// @brief return the id of the next AST node
+    int GetNextNodeID(void) const { return _node_id; };
+
+    /// @brief set the id of the next AST node
+    void SetNextNodeID(int id) { _node_id = id; };
+
+    /// @}
+
+  private:
+    CSource             *_src;      ///< input source
+    bool                 _delete_src; ///< delete input source upon destruction
+    CInterner            _interner; ///< string interner
+    vector<unsigned int> _lines;    ///< start offsets of lines
+    size_t               _lines_end; ///< number of source bytes covered by _lines
+    CTypeManager        *_tm;       ///< type manager
+    once_flag            _tm_once;  ///< creation of the type manager
+    int                  _node_id;  ///< id of the next AST node
+    atomic<int>          _scanners; ///< number of scanners reading the input
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief context activation
+///
+/// Makes a context the active context of the calling thread for the lifetime of the object and
+/// restores the previously active context upon destruction. Activations nest; the previously
+/// active context must outlive the activation.
+///
+class CActiveContext {
+  public:
+    /// @brief constructor
+    ///
+    /// @param ctx context to activate (may be NULL)
+    CActiveContext(CContext *ctx);
+
+    /// @brief destructor
+    ~CActiveContext(void);
+
+  private:
+    CContext            *_prev;     ///< previously active context
+};
+
+
+#endif // __SnuPL_CONTEXT_H__
@@ -27,147 +27,63 @@
 /// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
 /// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
 /// DAMAGE.
-//--------------------------------------------------------------------------------------------------
 
 #include <cassert>
 #include <iomanip>
 
 #include "data.h"
+#include "context.h"
 #include "scanner.h"
 using namespace std;
 
 
 //--------------------------------------------------------------------------------------------------
-// CDataInitializer
+// CDataValue
 //
-CDataInitializer::CDataInitializer(void)
+CDataValue CDataValue::String(unsigned int id)
 {
+  CDataValue v;
+  v._kind = dkString;
+  v._id = id;
+  return v;
 }
 
-CDataInitializer::~CDataInitializer(void)
+CDataValue CDataValue::String(const string &data)
 {
-}
+  CInterner *strings = CContext::Get()->GetInterner();
 
-ostream& operator<<(ostream &out, const CDataInitializer &t)
-{
-  return t.print(out);
-}
+  // strings of bodies that are parsed in parallel are interned beforehand; look them up first
+  unsigned int id = strings->Find(data);
+  if (id == CInterner::NONE) id = strings->Intern(data);
 
-ostream& operator<<(ostream &out, const CDataInitializer *t)
-{
-  return t->print(out);
-}
-
-
-//--------------------------------------------------------------------------------------------------
-// CDataInitLongint
-//
-CDataInitLongint::CDataInitLongint(const long long data)
-  : CDataInitializer(), _data(data)
-{
+  return String(id);
 }
 
-long long CDataInitLongint::GetData(void) const
+const string& CDataValue::GetString(void) const
 {
-  return _data;
+  assert(_kind == dkString);
+  return CContext::Get()->GetInterner()->GetString(_id);
 }
 
-ostream& CDataInitLongint::print(ostream &out, int indent) const
+ostream& CDataValue::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
-  out << ind << "[ data: " << dec << _data << " ]";
-  return out;
-}
-
+  out << ind << "[ data: ";
+  switch (_kind) {
+    case dkBoolean: out << (_number != 0 ? "true" : "false"); break;
+    case dkChar:    out << "'" << CToken::escape(tCharConst, string(1, GetChar())) << "'"; break;
+    case dkInteger:
+    case dkLongint: out << dec << _number; break;
+    case dkString:  out << "\"" << GetString() << "\""; break;
+    default:        out << "none"; break;
+  }
+  out << " ]";
 
-//--------------------------------------------------------------------------------------------------
-// CDataInitInteger
-//
-CDataInitInteger::CDataInitInteger(const int data)
-  : CDataInitializer(), _data(data)
-{
-}
-
-int CDataInitInteger::GetData(void) const
-{
-  return _data;
-}
-
-ostream& CDataInitInteger::print(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  out << ind << "[ data: " << dec << _data << " ]";
   return out;
 }
 
-
-//--------------------------------------------------------------------------------------------------
-// CDataInitBoolean
-//
-CDataInitBoolean::CDataInitBoolean(const bool data)
-  : CDataInitializer(), _data(data)
-{
-}
-
-bool CDataInitBoolean::GetData(void) const
+ostream& operator<<(ostream &out, const CDataValue &v)
 {
-  return _data;
+  return v.print(out);
 }
-
-ostream& CDataInitBoolean::print(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  out << ind << "[ data: " << (_data ? "true" : "false" ) << " ]";
-  return out;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-// CDataInitChar
-//
-CDataInitChar::CDataInitChar(const char data)
-  : CDataInitializer(), _data(data)
-{
-}
-
-char CDataInitChar::GetData(void) const
-{
-  return _data;
-}
-
-ostream& CDataInitChar::print(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-  string data;
-
-  data = _data;
-
-  out << ind << "[ data: '" << CToken::escape(tCharConst, data) << "' ]";
-  return out;
-}
-
-
-//--------------------------------------------------------------------------------------------------
-// CDataInitString
-//
-CDataInitString::CDataInitString(const string data)
-  : CDataInitializer(), _data(data)
-{
-}
-
-string CDataInitString::GetData(void) const
-{
-  return _data;
-}
-
-ostream& CDataInitString::print(ostream &out, int indent) const
-{
-  string ind(indent, ' ');
-
-  out << ind << "[ data: \"" << _data << "\" ]";
-  return out;
-}
-
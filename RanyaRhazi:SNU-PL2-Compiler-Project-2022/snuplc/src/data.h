@@ -27,117 +27,63 @@
 /// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
 /// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
 /// DAMAGE.
-//--------------------------------------------------------------------------------------------------
 
 #ifndef __SnuPL_DATA_H__
 #define __SnuPL_DATA_H__
 
 #include <iostream>
-#include <map>
-#include <vector>
+#include <string>
 
 #include "type.h"
 using namespace std;
 
 //--------------------------------------------------------------------------------------------------
-/// @brief SnuPL data initializer
-///
-/// base class for all data initializers
-///
-class CDataInitializer {
-  public:
-    /// @name constructor/destructor
-    /// @{
-
-    /// @brief constructor
-    CDataInitializer(void);
-
-    /// @brief destructor
-    virtual ~CDataInitializer(void);
-
-    /// @}
-
-
-    /// @brief print the data initializer to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const = 0;
-
-  private:
+/// @brief kinds of data values
+///
+enum EDataKind {
+  dkNone=0,                         ///< no value
+  dkBoolean,                        ///< boolean
+  dkChar,                           ///< character
+  dkInteger,                        ///< integer
+  dkLongint,                        ///< longint
+  dkString,                         ///< string
 };
 
-/// @name CDataInitializer output operators
-/// @{
-
-/// @brief CDataInitializer output operator
-///
-/// @param out output stream
-/// @param t reference to CDataInitializer
-/// @retval output stream
-ostream& operator<<(ostream &out, const CDataInitializer &t);
-
-/// @brief CDataInitializer output operator
-///
-/// @param out output stream
-/// @param t reference to CDataInitializer
-/// @retval output stream
-ostream& operator<<(ostream &out, const CDataInitializer *t);
-
-/// @}
-
 
 //--------------------------------------------------------------------------------------------------
-/// @brief longint data initializer
+/// @brief SnuPL data value
 ///
-/// class representing longint data initializers
+/// Constant value of a scalar or string type that is passed by value. Strings are kept in escaped
+/// form (i.e., as they appear in the source) and referenced by their id in the string interner of
+/// the context that is active in the calling thread (see CContext::Get()).
 ///
-class CDataInitLongint : public CDataInitializer {
+class CDataValue {
   public:
-    /// @name constructor/destructor
+    /// @name constructors
     /// @{
 
-    /// @brief constructor
-    ///
-    /// @param data data value
-    CDataInitLongint(const long long data);
-
-    /// @}
-
-
-    /// @name data access
-    /// @{
+    /// @brief constructor (no value)
+    CDataValue(void) : _kind(dkNone), _number(0) {};
 
-    /// @brief get the longint data value
-    /// @retval longint longint value
-    long long GetData(void) const;
-
-    /// @}
+    /// @brief return a boolean value
+    static CDataValue Boolean(bool data) { return CDataValue(dkBoolean, data ? 1 : 0); };
 
+    /// @brief return a character value
+    static CDataValue Char(char data) { return CDataValue(dkChar, (unsigned char)data); };
 
-    /// @brief print the symbol to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
-
-  private:
-    long long      _data;         ///< longint data
-};
+    /// @brief return an integer value
+    static CDataValue Integer(int data) { return CDataValue(dkInteger, data); };
 
+    /// @brief return a longint value
+    static CDataValue Longint(long long data) { return CDataValue(dkLongint, data); };
 
-//--------------------------------------------------------------------------------------------------
-/// @brief integer data initializer
-///
-/// class representing integer data initializers
-///
-class CDataInitInteger : public CDataInitializer {
-  public:
-    /// @name constructor/destructor
-    /// @{
+    /// @brief return a string value
+    /// @param id id of the (escaped) string in the string interner
+    static CDataValue String(unsigned int id);
 
-    /// @brief constructor
-    ///
-    /// @param data data value
-    CDataInitInteger(const int data);
+    /// @brief return a string value
+    /// @param data escaped string (interned in the active context)
+    static CDataValue String(const string &data);
 
     /// @}
 
@@ -145,135 +91,69 @@ class CDataInitInteger : public CDataInitializer {
     /// @name data access
     /// @{
 
-    /// @brief get the integer data value
-    /// @retval int integer value
-    int GetData(void) const;
+    /// @brief return the kind of the value
+    EDataKind GetKind(void) const { return (EDataKind)_kind; };
 
-    /// @}
+    /// @brief check whether this is a value (i.e., the kind is not dkNone)
+    bool IsValid(void) const { return _kind != dkNone; };
 
+    /// @brief check whether this is a boolean, character, integer, or longint value
+    bool IsScalar(void) const { return (_kind != dkNone) && (_kind != dkString); };
 
-    /// @brief print the symbol to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    /// @brief check whether this is an integer or longint value
+    bool IsInt(void) const { return (_kind == dkInteger) || (_kind == dkLongint); };
 
-  private:
-    int            _data;         ///< integer data
-};
+    /// @brief return the value of a scalar as a number (characters are unsigned)
+    long long GetNumber(void) const { return _number; };
 
+    /// @brief return the boolean value
+    bool GetBoolean(void) const { return _number != 0; };
 
-//--------------------------------------------------------------------------------------------------
-/// @brief boolean data initializer
-///
-/// class representing boolean data initializers
-///
-class CDataInitBoolean : public CDataInitializer {
-  public:
-    /// @name constructor/destructor
-    /// @{
+    /// @brief return the character value
+    char GetChar(void) const { return (char)_number; };
 
-    /// @brief constructor
-    ///
-    /// @param data data value
-    CDataInitBoolean(const bool data);
+    /// @brief return the integer value
+    int GetInteger(void) const { return (int)_number; };
 
-    /// @}
+    /// @brief return the longint value
+    long long GetLongint(void) const { return _number; };
 
+    /// @brief return the interner id of a string value
+    unsigned int GetStringId(void) const { return _id; };
 
-    /// @name data access
-    /// @{
-
-    /// @brief get the boolean data value
-    /// @retval bool boolean value
-    bool GetData(void) const;
+    /// @brief return the (escaped) string of a string value
+    const string& GetString(void) const;
 
     /// @}
 
 
-    /// @brief print the symbol to an output stream
+    /// @brief print the value to an output stream
     /// @param out output stream
     /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+    ostream&  print(ostream &out, int indent=0) const;
 
   private:
-    bool           _data;         ///< boolean data
-};
-
-
-//--------------------------------------------------------------------------------------------------
-/// @brief character data initializer
-///
-/// class representing character data initializers
-///
-class CDataInitChar : public CDataInitializer {
-  public:
-    /// @name constructor/destructor
-    /// @{
-
     /// @brief constructor
-    ///
-    /// @param data data value
-    CDataInitChar(const char data);
-
-    /// @}
-
-
-    /// @name data access
-    /// @{
-
-    /// @brief get the character data value
-    /// @retval char character value
-    char GetData(void) const;
-
-    /// @}
+    CDataValue(EDataKind kind, long long number) : _kind(kind), _number(number) {};
 
-
-    /// @brief print the symbol to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
-
-  private:
-    char           _data;         ///< character data
+    unsigned char  _kind;           ///< kind of the value (EDataKind)
+    union {
+      long long    _number;         ///< value of a scalar
+      unsigned int _id;             ///< interner id of a string
+    };
 };
 
+/// @name CDataValue output operator
+/// @{
 
-//--------------------------------------------------------------------------------------------------
-/// @brief string data initializer
+/// @brief CDataValue output operator
 ///
-/// class representing string data initializers
-///
-class CDataInitString : public CDataInitializer {
-  public:
-    /// @name constructor/destructor
-    /// @{
-
-    /// @brief constructor
-    ///
-    /// @param data data value
-    CDataInitString(const string data);
-
-    /// @}
-
-
-    /// @name data access
-    /// @{
-
-    /// @brief get the string data
-    /// @retval string string data
-    string GetData(void) const;
-
-    /// @}
-
-
-    /// @brief print the symbol to an output stream
-    /// @param out output stream
-    /// @param indent indentation
-    virtual ostream&  print(ostream &out, int indent=0) const;
+/// @param out output stream
+/// @param v reference to CDataValue
+/// @retval output stream
+ostream& operator<<(ostream &out, const CDataValue &v);
 
-  private:
-    string         _data;         ///< string data
-};
+/// @}
 
 
 #endif // __SnuPL_DATA_H__
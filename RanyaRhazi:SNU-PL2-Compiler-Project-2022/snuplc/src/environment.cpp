@@ -32,6 +32,7 @@
 #include <cassert>
 #include <cstring>
 #include <iomanip>
+#include <mutex>
 #include <tuple>
 
 #include "environment.h"
@@ -103,10 +104,12 @@ void CEnvironment::InitDefaultConfig(void)
 
 CEnvironment* CEnvironment::Get(void)
 {
-  if (_globenv == NULL) {
+  // modules compiled concurrently may request the environment at the same time
+  static once_flag once;
+  call_once(once, []() {
     _globenv = new CEnvironment();
     RegisterTargets(_globenv);
-  }
+  });
 
   return _globenv;
 }
@@ -360,11 +363,13 @@ CTarget* CEnvironment::GetTarget(void) const
 
 void CEnvironment::AddFile(const string file)
 {
+  lock_guard<mutex> guard(_files_lock);
   _files.push_back(file);
 }
 
 string CEnvironment::GetNextFile(void)
 {
+  lock_guard<mutex> guard(_files_lock);
   _active_file = "";
 
   if (!_files.empty()) {
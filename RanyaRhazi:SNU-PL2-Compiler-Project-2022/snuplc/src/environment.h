@@ -33,6 +33,7 @@
 
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include "target.h"
@@ -114,7 +115,8 @@ class CEnvironment {
     void AddFile(string file);
 
     /// @brief next file to be compiled. Returns the empty string if
-    ///        no further files are to be compiled.
+    ///        no further files are to be compiled. Several threads may
+    ///        take files concurrently.
     string GetNextFile(void);
 
     /// @}
@@ -150,6 +152,7 @@ class CEnvironment {
     CTarget*        _active_target; ///< active target
     vector<string>         _files;  ///< files to compile
     string            _active_file; ///< active file (currently being compiled)
+    mutex              _files_lock; ///< protects _files and _active_file
 
     static CEnvironment  *_globenv; ///< global CEnvironment instance
 };
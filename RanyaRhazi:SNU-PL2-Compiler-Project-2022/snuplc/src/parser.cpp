@@ -25,44 +25,61 @@
 ///
 /// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
 /// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
-/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
-/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
-/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
-/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
-/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
-/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
-/// DAMAGE.
-//--------------------------------------------------------------------------------------------------
 
 #include <limits.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <errno.h>
 #include <cstdlib>
 #include <vector>
 #include <iostream>
+#include <sstream>
 #include <exception>
 #include <string.h>
+#include <thread>
 
 #include "parser.h"
 #include "symtab.h"
 using namespace std;
 
 //--------------------------------------------------------------------------------------------------
-// EBNF of SnuPL/-1
-//   module        =  statSequence "."
-//   digit         =  "0".."9".
-//   letter        =  "a".."z".
-//   factOp        =  "*" | "/".
-//   termOp        =  "+" | "-".
-//   relOp         =  "=" | "#".
-//   factor        =  digit | "(" expression ")".
-//   term          =  factor { factOp factor }.
-//   simpleexpr    =  term { termOp term }.
-//   expression    =  simpleexpr [ relOp simpleexpr ].
-//   assignment    =  letter ":=" expression.
-//   statement     =  assignment.
-//   statSequence  =  [ statement { ";" statement } ].
-//   whitespace    =  { " " | \n }+.
+// EBNF of SnuPL/2
+//   module            = "module" ident ";"
+//                       { constDeclaration | varDeclaration | subroutineDecl }
+//                       [ "begin" statSequence ] "end" ident ".".
+//   type              = basetype | type "[" [ simpleexpr ] "]".
+//   basetype          = "boolean" | "char" | "integer" | "longint".
+//   qualident         = ident { "[" simpleexpr "]" }.
+//   factOp            = "*" | "/" | "&&".
+//   termOp            = "+" | "-" | "||".
+//   relOp             = "=" | "#" | "<" | "<=" | ">" | ">=".
+//   factor            = qualident | number | boolean | char | string |
+//                       "(" expression ")" | subroutineCall | "!" factor.
+//   term              = factor { factOp factor }.
+//   simpleexpr        = ["+"|"-"] term { termOp term }.
+//   expression        = simpleexpr [ relOp simplexpr ].
+//   assignment        = qualident ":=" expression.
+//   subroutineCall    = ident "(" [ expression {"," expression} ] ")".
+//   ifStatement       = "if" "(" expression ")" "then" statSequence
+//                       [ "else" statSequence ] "end".
+//   whileStatement    = "while" "(" expression ")" "do" statSequence "end".
+//   returnStatement   = "return" [ expression ].
+//   statement         = assignment | subroutineCall | ifStatement
+//                       | whileStatement | returnStatement.
+//   statSequence      = [ statement { ";" statement } ].
+//   constDeclaration  = [ "const" constDeclSequence ].
+//   constDeclSequence = constDecl ";" { constDecl ";" }
+//   constDecl         = varDecl "=" expression.
+//   varDeclaration    = [ "var" varDeclSequence ";" ].
+//   varDeclSequence   = varDecl { ";" varDecl }.
+//   varDecl           = ident { "," ident } ":" type.
+//   subroutineDecl    = (procedureDecl | functionDecl)
+//                       ( "extern" | subroutineBody ident ) ";".
+//   procedureDecl     = "procedure" ident [ formalParam ] ";".
+//   functionDecl      = "function" ident [ formalParam ] ":" type ";".
+//   formalParam       = "(" [ varDeclSequence ] ")".
+//   subroutineBody    = constDeclaration varDeclaration
+//                       "begin" statSequence "end".
 
 // Global Symbol Table
 CSymtab GST();
@@ -70,24 +87,80 @@ CSymtab GST();
 //--------------------------------------------------------------------------------------------------
 // CParser
 //
-CParser::CParser(CScanner *scanner)
+
+/// finalizer of symbols that the error-recovering parser keeps outside of any symbol table
+static void DeleteSymbol(void *sym)
+{
+  delete static_cast<CSymbol*>(sym);
+}
+
+CParser::CParser(CScanner *scanner, EParseMode mode, unsigned int nthreads, bool lazy,
+                 bool recover)
 {
   _scanner = scanner;
+  _mode = mode;
+  _nthreads = nthreads > 0 ? nthreads : 1;
+  _lazy = lazy;
+  _recover = recover;
+  _jobs = NULL;
+  _env = NULL;
+  _job = NULL;
   _module = NULL;
+  _arena = NULL;
+  _abort = false;
+  _panic = false;
+
+  // typical expressions never grow the stacks of opexpression()
+  _operands.reserve(64);
+  _ops.reserve(64);
+  _frames.reserve(16);
 }
 
 CAstNode* CParser::Parse(void)
 {
   _abort = false;
+  _panic = false;
+  _diagnostics.clear();
 
   if (_module != NULL) { delete _module; _module = NULL; }
+  if (_scanner == NULL) return NULL;
+
+  // tokens and types are resolved through the context of the scanner
+  CContext *ctx = _scanner->GetContext();
+  CActiveContext active(ctx);
+
+  // AST nodes are numbered per compilation. The parser works with the counter of the calling
+  // thread; it is loaded from and saved back to the context.
+  int tid = CAstNode::GetNextID();
+  CAstNode::SetNextID(ctx->GetNextNodeID());
+
+  // parallel and lazy parsing operate on the token array of the entire input. Bodies with
+  // errors are parsed again sequentially, hence the error-recovering parser does not defer them.
+  bool done = false;
+  if (!_recover && ((_nthreads > 1) || _lazy) && _scanner->Tokenize(_nthreads)) {
+    size_t index = _scanner->GetTokenIndex();
+
+    done = ParseDeferred();
+
+    if (!done) {
+      // start over
+      _abort = false;
+      _scanner->SetTokenIndex(index);
+      CAstNode::SetNextID(ctx->GetNextNodeID());
+    }
+  }
 
-  try {
-    if (_scanner != NULL) _module = module();
-  } catch (...) {
-    _module = NULL;
+  if (!done) {
+    try {
+      _module = module();
+    } catch (...) {
+      _module = NULL;
+    }
   }
 
+  ctx->SetNextNodeID(CAstNode::GetNextID());
+  CAstNode::SetNextID(tid);
+
   return _module;
 }
 
@@ -103,8 +176,16 @@ string CParser::GetErrorMessage(void) const
   else return "";
 }
 
-void CParser::SetError(CToken t, const string message)
+void CParser::SetError(const CToken &t, const string &message)
 {
+  if (_recover) {
+    // only the first of a series of errors is recorded; the following ones are usually caused
+    // by the parser being out of sync with the input
+    ReportError(t, message);
+    _panic = true;
+    return;
+  }
+
   _error_token = t;
   _message = message;
   string throwmessage = message;
@@ -117,45 +198,462 @@ void CParser::SetError(CToken t, const string message)
   throw message;
 }
 
-bool CParser::Consume(EToken type, CToken *token)
+void CParser::ReportError(const CToken &t, const string &message)
+{
+  if (!_recover) SetError(t, message);
+  else if (!_panic) {
+    if (!_abort) {
+      _error_token = t;
+      _message = message;
+      _abort = true;
+    }
+    SDiagnostic d = { t, message };
+    _diagnostics.push_back(d);
+  }
+}
+
+void CParser::Synchronize(initializer_list<EToken> follow)
 {
-  if (_abort) return false;
+  if (!_panic) return;
+
+  unsigned int depth = 0;
+
+  while (true) {
+    EToken tt = _scanner->Peek().GetType();
+
+    if (tt == tEOF) break;
+    if ((depth == 0) && (find(follow.begin(), follow.end(), tt) != follow.end())) break;
 
-  CToken t = _scanner->Get();
+    if ((tt == tBegin) || (tt == tIf) || (tt == tWhile)) depth++;
+    else if ((tt == tEnd) && (depth > 0)) depth--;
 
-  if (t.GetType() != type) {
-    SetError(t, "expected '" + CToken::Name(type) + "', got '" +
-             t.GetName() + "'");
+    _scanner->Get();
   }
 
-  if (token != NULL) *token = t;
+  _panic = false;
+}
+
+const CToken& CParser::Consume(EToken type)
+{
+  if ((_abort && !_recover) || _panic) return _token;
+
+  // in recovery mode, unexpected tokens are left to Synchronize()
+  if (_recover && (_scanner->Peek().GetType() != type)) {
+    SetError(_scanner->Peek(), "expected '" + CToken::Name(type) + "', got '" +
+             _scanner->Peek().GetName() + "'");
+    return _token;
+  }
 
-  return t.GetType() == type;
+  _token = _scanner->Get();
+
+  if (_token.GetType() != type) {
+    SetError(_token, "expected '" + CToken::Name(type) + "', got '" +
+             _token.GetName() + "'");
+  }
+
+  return _token;
 }
 
 void CParser::InitSymbolTable(CSymtab *st)
 {
-  // TODO (phase 2)
-  // add predefined functions here
-  //_module->SetSymbolTable(st);
+  CTypeManager *tm = CTypeManager::Get();
+  CInterner *names = _scanner->GetContext()->GetInterner();
+
+  // predefined procedures and functions of the runtime library
+  const struct {
+    const char *name;               // name
+    const CType *type;              // return type
+    const char *pname[2];           // parameter names (NULL: none)
+    const CType *ptype[2];          // parameter types
+  } predefined[] = {
+    { "DIM",       tm->GetInteger(), { "array", "dim" }, { tm->GetVoidPtr(), tm->GetInteger() } },
+    { "DOFS",      tm->GetInteger(), { "array", NULL },  { tm->GetVoidPtr(), NULL } },
+    { "ReadInt",   tm->GetInteger(), { NULL, NULL },     { NULL, NULL } },
+    { "ReadLong",  tm->GetLongint(), { NULL, NULL },     { NULL, NULL } },
+    { "WriteChar", tm->GetNull(),    { "c", NULL },      { tm->GetChar(), NULL } },
+    { "WriteInt",  tm->GetNull(),    { "i", NULL },      { tm->GetInteger(), NULL } },
+    { "WriteLn",   tm->GetNull(),    { NULL, NULL },     { NULL, NULL } },
+    { "WriteLong", tm->GetNull(),    { "l", NULL },      { tm->GetLongint(), NULL } },
+    { "WriteStr",  tm->GetNull(),    { "string", NULL },
+      { tm->GetPointer(tm->GetArray(CArrayType::OPEN, tm->GetChar())), NULL } },
+  };
+
+  for (const auto &p : predefined) {
+    CSymProc *proc = new CSymProc(p.name, p.type, true);
+
+    // the parameters of external subroutines belong to no scope
+    for (int i=0; (i<2) && (p.pname[i] != NULL); i++) {
+      CSymParam *param = new CSymParam(i, p.pname[i], p.ptype[i]);
+      proc->AddParam(param);
+      _arena->AddFinalizer(&DeleteSymbol, param);
+    }
+
+    st->AddSymbol(proc);
+
+    // deferred bodies look up module-level symbols by identifier id
+    if (_env != NULL) {
+      SGlobalSymbol g = { proc, _env->globals.size() };
+      _env->globals[names->Intern(p.name)] = g;
+    }
+  }
+}
+
+EOperation CParser::GetOperation(const CToken &t)
+{
+  EOperation op = opNop;
+
+  // the scanner classifies operators by their subkind
+  switch (t.GetSubkind()) {
+    case skEqual:       op = opEqual; break;
+    case skNotEqual:    op = opNotEqual; break;
+    case skLessEqual:   op = opLessEqual; break;
+    case skBiggerEqual: op = opBiggerEqual; break;
+    case skLessThan:    op = opLessThan; break;
+    case skBiggerThan:  op = opBiggerThan; break;
+    case skPlus:        op = opAdd; break;
+    case skMinus:       op = opSub; break;
+    case skMul:         op = opMul; break;
+    case skDiv:         op = opDiv; break;
+
+    default:
+      if (t.GetType() == tLogicOR) op = opOr;
+      else if (t.GetType() == tLogicAND) op = opAnd;
+      break;
+  }
+
+  if (op == opNop) SetError(t, "invalid operator.");
+
+  return op;
+}
+
+bool CParser::ParseDeferred(void)
+{
+  vector<SBodyJob> jobs;
+  vector<CAstNode*> nodes;
+  int id = CAstNode::GetNextID();
+  bool ok = true;
+
+  SBodyEnv *env = new SBodyEnv();
+  env->ctx = _scanner->GetContext();
+  env->tokens = _scanner->GetTokens(&env->ntokens);
+  env->mode = _mode;
+  env->lazy = _lazy;
+  env->module = NULL;
+
+  _jobs = _lazy ? NULL : &jobs;
+  _env = env;
+  vector<CAstNode*> *log = CAstNode::SetLog(&nodes);
+
+  try {
+    module();
+  } catch (...) {
+    ok = false;
+  }
+
+  CAstNode::SetLog(log);
+  _jobs = NULL;
+  _env = NULL;
+
+  for (size_t i=0; i<jobs.size(); i++) ok = ok && jobs[i].ok;
+
+  if (!ok) {
+    delete env;
+    delete _module;
+    _module = NULL;
+    return false;
+  }
+
+  // lazy bodies refer to the environment until the module is released
+  if (_lazy) {
+    _arena->AddFinalizer([](void *p) { delete static_cast<SBodyEnv*>(p); }, env);
+  } else {
+    delete env;
+  }
+
+  // number the nodes as a sequential parse would have: the nodes of each body follow those the
+  // main thread created before skipping the body
+  size_t n = 0;
+  for (size_t i=0; i<jobs.size(); i++) {
+    for (; n<jobs[i].mark; n++) nodes[n]->SetID(id++);
+    for (size_t j=0; j<jobs[i].nodes.size(); j++) jobs[i].nodes[j]->SetID(id++);
+  }
+  for (; n<nodes.size(); n++) nodes[n]->SetID(id++);
+  CAstNode::SetNextID(id);
+
+  return true;
+}
+
+bool CParser::DeferBody(CAstProcedure *s, const CToken &ident)
+{
+  size_t ntokens;
+  const CToken *tokens = _scanner->GetTokens(&ntokens);
+  size_t start = _scanner->GetTokenIndex(), i;
+  unsigned int depth = 0;
+  vector<size_t> strings;
+
+  // pre-pass: declarations contain no keywords of statements, hence the body ends with the "end"
+  // that matches its "begin". "if" and "while" statements are closed by "end" as well.
+  for (i=start; i<ntokens; i++) {
+    EToken tt = tokens[i].GetType();
+
+    if ((tt == tBegin) || (tt == tIf) || (tt == tWhile)) depth++;
+    else if (tt == tEnd) {
+      if (depth <= 1) break;
+      depth--;
+    }
+    else if (tt == tStringConst) strings.push_back(i);
+    else if ((tt == tProcedure) || (tt == tFunction) || (tt == tEOF)) return false;
+  }
+
+  // the body is followed by the identifier of the subroutine
+  if ((depth != 1) || (i + 2 >= ntokens)) return false;
+
+  SBodyJob job;
+  job.proc = s;
+  job.ident = ident;
+  job.start = start;
+  job.end = i + 2;
+  job.visible = _env->globals.size();
+  job.mark = CAstNode::GetLog()->size();
+  job.ok = false;
+
+  // deferred bodies only look up their string constants; pool them in source order as a
+  // sequential parse would
+  CStringPool *pool = _module->GetStringPool();
+  for (size_t j=0; j<strings.size(); j++) pool->Add(tokens[strings[j]].GetValue());
+
+  if (_lazy) s->SetDeferredBody(_arena->New<CLazyBody>(_env, job));
+  else _jobs->push_back(job);
+
+  // continue as if the body had been parsed
+  _scanner->SetTokenIndex(job.end);
+
+  return true;
+}
+
+void CParser::ParseBodies(void)
+{
+  if (_jobs->empty()) return;
+
+  // the workers resolve positions of error tokens through the shared context; extend its table
+  // of line starts to the entire input now so that they only read it
+  _scanner->GetLineNumber();
+
+  unsigned int nworkers = (unsigned int)min<size_t>(_nthreads, _jobs->size());
+  vector<CArena*> arenas(nworkers);
+  for (unsigned int i=0; i<nworkers; i++) {
+    arenas[i] = new CArena();
+    _arena->Adopt(arenas[i]);
+  }
+
+  // jobs are taken in source order; the main thread works through them as well
+  atomic<size_t> next(0);
+  auto work = [this, &next](CArena *arena) {
+    size_t i;
+    while ((i = next++) < _jobs->size()) ParseBody(_env, &(*_jobs)[i], arena);
+  };
+
+  vector<thread> workers;
+  for (unsigned int i=1; i<nworkers; i++) workers.push_back(thread(work, arenas[i]));
+  work(arenas[0]);
+  for (size_t i=0; i<workers.size(); i++) workers[i].join();
+}
+
+void CParser::ParseBody(const SBodyEnv *env, SBodyJob *job, CArena *arena,
+                        CToken *t, string *msg)
+{
+  // workers resolve tokens through the shared context; the node log of the calling thread
+  // follows the body
+  CActiveContext active(env->ctx);
+  vector<CAstNode*> *log = CAstNode::SetLog(&job->nodes);
+
+  CScanner scanner(env->ctx, env->tokens, env->ntokens, job->start);
+  CParser parser(&scanner, env->mode);
+  parser._module = env->module;
+  parser._arena = arena;
+  parser._env = const_cast<SBodyEnv*>(env);
+  parser._job = job;
+
+  // the pre-pass and the parser must agree on the extent of the body
+  try {
+    parser.subroutineBody(job->proc, job->ident);
+    job->ok = !parser.HasError() && (scanner.GetTokenIndex() == job->end);
+    if (!job->ok && !parser.HasError()) {
+      parser._error_token = scanner.Peek();
+      parser._message = "malformed subroutine body.";
+    }
+  } catch (...) {
+    job->ok = false;
+  }
+
+  if (!job->ok) {
+    if (t != NULL) *t = parser._error_token;
+    if (msg != NULL) *msg = parser._message;
+  }
+
+  CAstNode::SetLog(log);
+}
+
+//--------------------------------------------------------------------------------------------------
+// CLazyBody
+//
+CLazyBody::CLazyBody(const SBodyEnv *env, const SBodyJob &job)
+  : _env(env), _job(job)
+{
+}
+
+bool CLazyBody::Materialize(CAstScope *s, CToken *t, string *msg)
+{
+  assert(s == _job.proc);
+
+  // materialized nodes continue the numbering of the compilation
+  int id = CAstNode::GetNextID();
+  CAstNode::SetNextID(_env->ctx->GetNextNodeID());
+
+  CParser::ParseBody(_env, &_job, s->GetArena(), t, msg);
+  _job.nodes.clear();
+
+  _env->ctx->SetNextNodeID(CAstNode::GetNextID());
+  CAstNode::SetNextID(id);
+
+  return _job.ok;
+}
+
+const CSymbol* CParser::FindSymbol(CAstScope *s, const CToken &t)
+{
+  if (_job == NULL) return s->GetSymbolTable()->FindSymbol(t.GetId(), sGlobal);
+
+  // bodies parsed in parallel see the module-level symbols declared before the body
+  const CSymbol *sym = s->GetSymbolTable()->FindSymbol(t.GetId(), sLocal);
+
+  if (sym == NULL) {
+    auto it = _env->globals.find(t.GetId());
+    if ((it != _env->globals.end()) && (it->second.order < _job->visible)) {
+      sym = it->second.symbol;
+    }
+  }
+
+  return sym;
+}
+
+const CSymbol* CParser::GetVariable(CAstScope *s, const CToken &t)
+{
+  const CSymbol *sym = FindSymbol(s, t);
+
+  if ((sym == NULL) || (sym->GetSymbolType() == stProcedure)) {
+    ReportError(t, "undefined identifier '" + t.GetValue() + "'.");
+
+    // recovery mode: continue with a placeholder
+    if (sym == NULL) {
+      CSymbol *v = s->CreateVar(t.GetValue(), CTypeManager::Get()->GetNull());
+      _arena->AddFinalizer(&DeleteSymbol, v);
+      sym = v;
+    }
+  }
+
+  return sym;
+}
+
+const CSymProc* CParser::GetProcedure(CAstScope *s, const CToken &t)
+{
+  const CSymbol *sym = FindSymbol(s, t);
+
+  if ((sym == NULL) || (sym->GetSymbolType() != stProcedure)) {
+    ReportError(t, "undefined subroutine '" + t.GetValue() + "'.");
+
+    // recovery mode: continue with a placeholder
+    CSymProc *p = new CSymProc(t.GetValue(), CTypeManager::Get()->GetNull());
+    _arena->AddFinalizer(&DeleteSymbol, p);
+    return p;
+  }
+
+  return static_cast<const CSymProc*>(sym);
+}
+
+void CParser::AddSymbol(CAstScope *s, CSymbol *sym, const CToken &t)
+{
+  if (!s->GetSymbolTable()->AddSymbol(sym)) {
+    // in recovery mode, the caller continues to use the symbol
+    if (_recover) _arena->AddFinalizer(&DeleteSymbol, sym);
+    else delete sym;
+    ReportError(t, "duplicated identifier '" + t.GetValue() + "'.");
+  }
+
+  // module-level symbols are looked up by deferred bodies
+  if ((_env != NULL) && (s == _module)) {
+    SGlobalSymbol g = { sym, _env->globals.size() };
+    _env->globals[t.GetId()] = g;
+  }
+}
+
+const CSymGlobal* CParser::StringSymbol(const CToken &t)
+{
+  CStringPool *pool = _module->GetStringPool();
+
+  if (_job == NULL) return pool->Add(t.GetValue());
+
+  // deferred bodies share the pool; their strings have been added by the pre-pass
+  const CSymGlobal *sym = pool->Find(t.GetValue());
+  if (sym == NULL) SetError(t, "malformed subroutine body.");
+
+  return sym;
 }
 
 CAstModule* CParser::module(void)
 {
   //
-  // module ::= "module" ident ";" { constDeclaration | varDeclaration | subroutineDecl } [ "begin" statSequence ] "end" ident ".".
+  // module ::= "module" ident ";" { constDeclaration | varDeclaration | subroutineDecl }
+  //            [ "begin" statSequence ] "end" ident ".".
   //
-  CToken t0;
-  Consume(tModule, NULL);
-  Consume(tIdent, &t0);
+  CToken t0, t1;
+  Consume(tModule);
+  t0 = Consume(tIdent);
   CAstModule *m = new CAstModule(t0, t0.GetValue());
-  Consume(tSemicolon, NULL);
-  // TODO From here
+  _module = m;
+  _arena = m->GetArena();
+  if (_env != NULL) _env->module = m;
+  Consume(tSemicolon);
+
   CAstStatement *statseq = NULL;
 
   InitSymbolTable(m->GetSymbolTable());
 
-  statseq = statSequence(m);
+  bool decl = true;
+  while (decl) {
+    // recovery mode: resume at the next declaration
+    Synchronize({ tConst, tVar, tProcedure, tFunction, tBegin, tEnd, tDot });
+
+    EToken tt = _scanner->Peek().GetType();
+    switch (tt) {
+      case tConst:      constdeclaration(m); break;
+      case tVar:        vardeclaration(m); break;
+      case tProcedure:
+      case tFunction:   subroutinedecl(m); break;
+      default:
+        // recovery mode: skip anything else up to the statement sequence of the module
+        if (_recover && (tt != tBegin) && (tt != tEnd) && (tt != tDot) && (tt != tEOF)) {
+          SetError(_scanner->Peek(), "declaration expected.");
+        } else {
+          decl = false;
+        }
+        break;
+    }
+  }
+
+  // subroutine bodies deferred to worker threads
+  if (_jobs != NULL) ParseBodies();
+
+  if (_scanner->Peek().GetType() == tBegin) {
+    Consume(tBegin);
+    statseq = statSequence(m);
+  }
+
+  Consume(tEnd);
+  t1 = Consume(tIdent);
+  if (t1.GetId() != t0.GetId()) {
+    ReportError(t1, "module identifier mismatch ('" + t0.GetValue() + "' != '" +
+             t1.GetValue() + "').");
+  }
   Consume(tDot);
 
   m->SetStatementSequence(statseq);
@@ -167,13 +665,16 @@ CAstStatement* CParser::statSequence(CAstScope *s)
 {
   //
   // statSequence ::= [ statement { ";" statement } ].
-  // statement ::= assignment.
+  // statement ::= assignment | subroutineCall | ifStatement | whileStatement | returnStatement.
+  //
+  // FIRST(statSequence) = { tIdent, tIf, tWhile, tReturn }
+  // FOLLOW(statSequence) = { tEnd, tElse }
   //
-  // FIRST(statSequence) = { tLetter }
-  // FOLLOW(statSequence) = { tDot }
+  // FIRST(statement) = { tIdent, tIf, tWhile, tReturn }
+  // FOLLOW(statement) = { tSemicolon, tEnd, tElse }
   //
-  // FIRST(statement) = { tLetter }
-  // FOLLOW(statement) = { tSemicolon, tDot }
+  // assignments and subroutine calls both start with an identifier; they are
+  // distinguished by the token following it (two-token lookahead).
   //
 
   // The linking of statement sequences is a bit akward here because
@@ -185,16 +686,48 @@ CAstStatement* CParser::statSequence(CAstScope *s)
   // attach new statements to that tail.
   CAstStatement *head = NULL;
 
-  if (_scanner->Peek().GetType() != tDot) {
+  EToken tt = _scanner->Peek().GetType();
+  if (!_panic && (tt != tEnd) && (tt != tElse)) {
     CAstStatement *tail = NULL;
 
     do {
       CAstStatement *st = NULL;
 
       switch (_scanner->Peek().GetType()) {
-        // statement ::= assignment
-        case tLetter:
-          st = assignment(s);
+        case tIdent:
+          switch (_scanner->Peek(1).GetType()) {
+            // statement ::= assignment
+            case tAssign:
+            case tLBrakSQ:
+              st = assignment(s);
+              break;
+
+            // statement ::= subroutineCall
+            case tLBrak: {
+              CToken t = _scanner->Peek();
+              st = _arena->New<CAstStatCall>(t, subroutinecall(s));
+              break;
+            }
+
+            default:
+              SetError(_scanner->Peek(1), "':=', '[' or '(' expected.");
+              break;
+          }
+          break;
+
+        // statement ::= ifStatement
+        case tIf:
+          st = ifStatement(s);
+          break;
+
+        // statement ::= whileStatement
+        case tWhile:
+          st = whileStatement(s);
+          break;
+
+        // statement ::= returnStatement
+        case tReturn:
+          st = returnStatement(s);
           break;
 
         default:
@@ -202,15 +735,38 @@ CAstStatement* CParser::statSequence(CAstScope *s)
           break;
       }
 
+      // recovery mode: keep what has been parsed of the statement (or an error node) and skip
+      // the rest
+      if (_panic) {
+        if (st == NULL) st = _arena->New<CAstStatError>(_diagnostics.back().token);
+        Synchronize({ tSemicolon, tEnd, tElse, tDot });
+      }
+
       assert(st != NULL);
       if (head == NULL) head = st;
       else tail->SetNext(st);
       tail = st;
 
-      if (_scanner->Peek().GetType() == tDot) break;
+      tt = _scanner->Peek().GetType();
+      if (tt != tSemicolon) {
+        if (!_recover || (tt == tEnd) || (tt == tElse) || (tt == tDot) || (tt == tEOF)) break;
+
+        // recovery mode: assume a missing ";" in front of another statement. Otherwise, skip
+        // the garbage following the statement. The message is the one the caller would report.
+        string msg = "expected '" + CToken::Name(tEnd) + "', got '" +
+                     _scanner->Peek().GetName() + "'";
+        if ((tt == tIdent) || (tt == tIf) || (tt == tWhile) || (tt == tReturn)) {
+          ReportError(_scanner->Peek(), msg);
+          continue;
+        }
+
+        SetError(_scanner->Peek(), msg);
+        Synchronize({ tSemicolon, tEnd, tElse, tDot });
+        if (_scanner->Peek().GetType() != tSemicolon) break;
+      }
 
       Consume(tSemicolon);
-    } while (!_abort);
+    } while (true);
   }
 
   return head;
@@ -219,16 +775,76 @@ CAstStatement* CParser::statSequence(CAstScope *s)
 CAstStatAssign* CParser::assignment(CAstScope *s)
 {
   //
-  // assignment ::= letter ":=" expression.
-  // to 
+  // assignment ::= qualident ":=" expression.
+  //
   CToken t;
 
   CAstDesignator *lhs = qualident(s);
-  Consume(tAssign, &t);
+  t = Consume(tAssign);
 
   CAstExpression *rhs = expression(s);
 
-  return new CAstStatAssign(t, lhs, rhs);
+  return _arena->New<CAstStatAssign>(t, lhs, rhs);
+}
+
+CAstStatIf* CParser::ifStatement(CAstScope *s)
+{
+  //
+  // ifStatement ::= "if" "(" expression ")" "then" statSequence [ "else" statSequence ] "end".
+  //
+  CToken t;
+  CAstStatement *ifbody, *elsebody = NULL;
+
+  t = Consume(tIf);
+  Consume(tLBrak);
+  CAstExpression *cond = expression(s);
+  Consume(tRBrak);
+  Synchronize({ tThen, tSemicolon, tEnd, tElse, tDot });
+  Consume(tThen);
+  ifbody = statSequence(s);
+
+  if (!_panic && (_scanner->Peek().GetType() == tElse)) {
+    Consume(tElse);
+    elsebody = statSequence(s);
+  }
+  Consume(tEnd);
+
+  return _arena->New<CAstStatIf>(t, cond, ifbody, elsebody);
+}
+
+CAstStatWhile* CParser::whileStatement(CAstScope *s)
+{
+  //
+  // whileStatement ::= "while" "(" expression ")" "do" statSequence "end".
+  //
+  CToken t;
+
+  t = Consume(tWhile);
+  Consume(tLBrak);
+  CAstExpression *cond = expression(s);
+  Consume(tRBrak);
+  Synchronize({ tDo, tSemicolon, tEnd, tElse, tDot });
+  Consume(tDo);
+  CAstStatement *body = statSequence(s);
+  Consume(tEnd);
+
+  return _arena->New<CAstStatWhile>(t, cond, body);
+}
+
+CAstStatReturn* CParser::returnStatement(CAstScope *s)
+{
+  //
+  // returnStatement ::= "return" [ expression ].
+  //
+  CToken t;
+  CAstExpression *expr = NULL;
+
+  t = Consume(tReturn);
+
+  EToken tt = _scanner->Peek().GetType();
+  if ((tt != tSemicolon) && (tt != tEnd) && (tt != tElse)) expr = expression(s);
+
+  return _arena->New<CAstStatReturn>(t, s, expr);
 }
 
 CAstExpression* CParser::expression(CAstScope* s)
@@ -236,25 +852,18 @@ CAstExpression* CParser::expression(CAstScope* s)
   //
   // expression ::= simpleexpr [ relOp simpleexpr ].
   //
+  if (_mode == pmIterative) return opexpression(s, false);
+
   CToken t;
-  EOperation relop;
   CAstExpression *left = NULL, *right = NULL;
 
   left = simpleexpr(s);
 
-  if (_scanner->Peek().GetType() == tRelOp) {
-    Consume(tRelOp, &t);
+  if (!_panic && (_scanner->Peek().GetType() == tRelOp)) {
+    t = Consume(tRelOp);
     right = simpleexpr(s);
 
-    if (t.GetValue() == "=")       relop = opEqual;
-    else if (t.GetValue() == "#")  relop = opNotEqual;
-    else if (t.GetValue() == "<=") relop = opLessEqual;
-    else if (t.GetValue() == ">=") relop = opBiggerEqual;
-    else if (t.GetValue() == "<")  relop = opLessThan;
-    else if (t.GetValue() == ">")  relop = opBiggerThan;
-    else SetError(t, "invalid relation.");
-
-    return new CAstBinaryOp(t, relop, left, right);
+    return _arena->New<CAstBinaryOp>(t, GetOperation(t), left, right);
   } else {
     return left;
   }
@@ -265,30 +874,35 @@ CAstExpression* CParser::simpleexpr(CAstScope *s)
   //
   // simpleexpr ::= ["+"|"-"] term { termOp term }.
   // 
+  if (_mode == pmIterative) return opexpression(s, true);
+
   CToken t;
 
   CAstExpression *n = NULL;
   if(_scanner->Peek().GetType() == tPlusMinus){
-    Consume(tPlusMinus, &t);
-    n = new CAstUnaryOp(t, t.GetValue() == "+" ? opPos : opNeg, term(s));
+    t = Consume(tPlusMinus);
+    if (_scanner->Peek().GetType() == tNumber) {
+      // a sign directly preceding a number is folded into the constant, i.e., into the
+      // leftmost factor of the term
+      n = term(s);
+      CAstExpression *f = n;
+      while (CAstBinaryOp *b = dynamic_cast<CAstBinaryOp*>(f)) f = b->GetLeft();
+      if (t.GetSubkind() == skMinus) static_cast<CAstConstant*>(f)->FoldNeg();
+    }
+    else n = _arena->New<CAstUnaryOp>(t, t.GetSubkind() == skPlus ? opPos : opNeg, term(s));
   }
   else n = term(s);
 
-  while (_scanner->Peek().GetType() == tPlusMinus || _scanner->Peek().GetType() == tLogicOR) {
+  while (!_panic &&
+         (_scanner->Peek().GetType() == tPlusMinus || _scanner->Peek().GetType() == tLogicOR)) {
     
     CAstExpression *l = n, *r;
 
-    Consume(_scanner->Peek().GetType(), &t);
+    t = Consume(_scanner->Peek().GetType());
 
     r = term(s);
 
-    EOperation op;
-    if(t.GetValue() == "||") op = opOr;
-    else if(t.GetValue() == "+") op = opAdd;
-    else if(t.GetValue() == "-") op = opSub;
-    else SetError(t, "Encountered non-termOp (||, +, -) token while parsing simpleexpr");
-
-    n = new CAstBinaryOp(t, op, l, r);
+    n = _arena->New<CAstBinaryOp>(t, GetOperation(t), l, r);
   }
 
 
@@ -298,7 +912,7 @@ CAstExpression* CParser::simpleexpr(CAstScope *s)
 CAstExpression* CParser::term(CAstScope *s)
 {
   //
-  // term ::= factor { ("*"|"/") factor }.
+  // term ::= factor { factOp factor }.
   //
   CAstExpression *n = NULL;
 
@@ -306,15 +920,15 @@ CAstExpression* CParser::term(CAstScope *s)
 
   EToken tt = _scanner->Peek().GetType();
 
-  while (tt == tMulDiv) {
+  while (!_panic && ((tt == tMulDiv) || (tt == tLogicAND))) {
     CToken t;
     CAstExpression *l = n, *r;
 
-    Consume(tMulDiv, &t);
+    t = Consume(tt);
 
     r = factor(s);
 
-    n = new CAstBinaryOp(t, t.GetValue() == "*" ? opMul : opDiv, l, r);
+    n = _arena->New<CAstBinaryOp>(t, GetOperation(t), l, r);
 
     tt = _scanner->Peek().GetType();
   }
@@ -322,36 +936,31 @@ CAstExpression* CParser::term(CAstScope *s)
   return n;
 }
 
-CAstFunctionCall* CParser::subroutinecall(CAstScope *s, CToken prev){
+CAstFunctionCall* CParser::subroutinecall(CAstScope *s, const CToken *ident){
   //
   // subroutineCall  ::= ident "(" [ expression {"," expression} ] ")"
   //
-  CToken t;
   CAstExpression* ni;
-  string errormsg;
-
 
   // consume identifier if not provided
-  if(prev == CToken()) Consume(tIdent, &t);
-  else t = prev;
-  CSymtab* ST = s->GetSymbolTable();
+  const CToken t = (ident == NULL) ? Consume(tIdent) : *ident;
 
-  //const CSymProc* sym = ST->FindSymbol(t.GetValue()); // This is CSymbol*, but how to get CSymProc* from FindSymbol? Is there something else? (TODO later)
-  const CSymProc* sym = new CSymProc(t.GetValue(), CTypeManager::Get()->GetInteger()); // Type is temporary, this has to be redone at some point!
-  CAstFunctionCall* n = new CAstFunctionCall(t, sym);
+  CAstFunctionCall* n = _arena->New<CAstFunctionCall>(t, GetProcedure(s, t), _arena);
   
-  Consume(tLBrak, NULL);
-
-  while(true){
-    ni = expression(s);
-    n->AddArg(ni);
-    if(_scanner->Peek().GetType() == tComma) Consume(tComma, NULL);
-    else break;
+  Consume(tLBrak);
+
+  if (_scanner->Peek().GetType() != tRBrak) {
+    while(true){
+      ni = expression(s);
+      n->AddArg(ni);
+      if(!_panic && (_scanner->Peek().GetType() == tComma)) Consume(tComma);
+      else break;
+    }
   }
 
-  Consume(tRBrak, NULL);
-
+  Consume(tRBrak);
 
+  return n;
 }
 
 CAstExpression* CParser::factor(CAstScope *s)
@@ -359,7 +968,7 @@ CAstExpression* CParser::factor(CAstScope *s)
   //
   // factor ::= qualident | number | boolean | char | string | "(" expression ")" | subroutineCall | "!" factor.
   //
-  // as of -1: FIRST(factor) = { tDigit, tLBrak }
+  // FIRST(factor) = { tIdent, tNumber, tTrue, tFalse, tCharConst, tStringConst, tLBrak, tLogicNOT }
   //
 
   CToken t;
@@ -368,14 +977,14 @@ CAstExpression* CParser::factor(CAstScope *s)
   
 
   if(tokentype == tIdent){
-    Consume(tIdent, &t);
+    t = Consume(tIdent);
 
     if(_scanner->Peek().GetType() == tLBrak){
-      n = subroutinecall(s, t);
+      n = subroutinecall(s, &t);
     }
     // qualident
     else{
-      n = qualident(s, t);
+      n = qualident(s, &t);
     }
   }
   else if (tokentype == tNumber){
@@ -385,110 +994,274 @@ CAstExpression* CParser::factor(CAstScope *s)
     n = boolean();
   }
   else if (tokentype == tCharConst){
-    Consume(tCharConst, &t);
-    n = new CAstStringConstant(t, t.GetValue(), s);
+    t = Consume(tCharConst);
+    n = _arena->New<CAstConstant>(t, CTypeManager::Get()->GetChar(),
+                                  (unsigned char)t.GetUnescapedValue()[0]);
   }
   else if (tokentype == tStringConst){
-    Consume(tStringConst, &t);
-    n = new CAstStringConstant(t, t.GetValue(), s);
+    t = Consume(tStringConst);
+    n = _arena->New<CAstStringConstant>(t, StringSymbol(t));
   }
   else if (tokentype == tLBrak){
-    Consume(tLBrak, NULL);
+    Consume(tLBrak);
     n = expression(s);
     n->SetParenthesized(true);
-    Consume(tRBrak, NULL);
+    Consume(tRBrak);
   }
   else if (tokentype == tLogicNOT){
-    CAstExpression *n2;
-    Consume(tLogicNOT, NULL);
-    n2 = expression(s);
-    n = new CAstUnaryOp(t, opNot, n2);
-  }
-  // switch (_scanner->Peek().GetType()) {
-  //   // factor ::= qualident - starts with ident
-  //   case tIdent:
-  //     n = number();
-  //     break;
-
-  //   // factor ::= "(" expression ")"
-  //   case tLBrak:
-  //     Consume(tLBrak);
-  //     n = expression(s);
-  //     Consume(tRBrak);
-  //     break;
-
-  //   default:
-  //     SetError(_scanner->Peek(), "factor expected.");
-  //     break;
-  // }
-
-  return n;
-}
-
-CAstDesignator* CParser::identifier(CAstScope *s)
-{
-  //
-  // identifier
-  //
-
-  CToken t;
-  CSymtab *st = s->GetSymbolTable();
-
-  Consume(tIdent, &t);
-
-  // check if symbol exists in (local) symbol table
-  const CSymbol *sym = st->FindSymbol(t.GetValue(), sLocal);
-
-  if (sym == NULL) {
-    // if not, create one and add it to the symbol table
-    CSymbol *nsym = s->CreateVar(t.GetValue(), CTypeManager::Get()->GetInteger());
-    st->AddSymbol(nsym);
-
-    sym = nsym;
+    t = Consume(tLogicNOT);
+    n = _arena->New<CAstUnaryOp>(t, opNot, factor(s));
+  }
+  else {
+    SetError(_scanner->Peek(), "factor expected.");
+    n = _arena->New<CAstExprError>(_scanner->Peek());
   }
 
-  return new CAstDesignator(t, sym);
+  return n;
 }
 
-CAstDesignator* CParser::qualident(CAstScope *s, CToken prev){
+CAstDesignator* CParser::qualident(CAstScope *s, const CToken *ident){
   //
   // qualident ::= ident { "[" simpleexpr "]" }
-  // ident may have been consumed already - that ident part is in prev token.
+  // ident may have been consumed already - that ident part is in ident.
   //
-  CToken t;
-  CSymtab *st = s->GetSymbolTable();
 
   // consume if ident is in the token stream, if already consumed it is provided as an argument
-  if (prev == CToken()) Consume(tIdent, &t);
-  else t = prev;
+  const CToken t = (ident == NULL) ? Consume(tIdent) : *ident;
 
-  const CSymbol *sym = st->FindSymbol(t.GetValue(), sLocal);
-    if (sym == NULL) {
-    // if not, create one and add it to the symbol table
-    CSymbol *nsym = s->CreateVar(t.GetValue(), CTypeManager::Get()->GetInteger());
-    st->AddSymbol(nsym);
-
-    sym = nsym;
-    }
+  const CSymbol *sym = GetVariable(s, t);
 
   // if array. Otherwise, same as identifier
   if(_scanner->Peek().GetType() == tLBrakSQ){
 
-    CAstArrayDesignator *arrayn = new CAstArrayDesignator(t, sym);
+    CAstArrayDesignator *arrayn = _arena->New<CAstArrayDesignator>(t, sym, _arena);
     CAstExpression *idxexp = NULL; // expression for index
 
-    while(_scanner->Peek().GetType() == tLBrakSQ){
-      Consume(tLBrakSQ, NULL);
+    while(!_panic && (_scanner->Peek().GetType() == tLBrakSQ)){
+      Consume(tLBrakSQ);
       
       idxexp = simpleexpr(s);
       arrayn->AddIndex(idxexp);
 
-      if(!Consume(tRBrakSQ, &t)) SetError(t, "no closing square bracket");
+      Consume(tRBrakSQ);
     }
+    arrayn->IndicesComplete();
     return arrayn;
   }
 
-  return new CAstDesignator(t, sym);
+  return _arena->New<CAstDesignator>(t, sym);
+}
+
+//--------------------------------------------------------------------------------------------------
+// operator precedence parsing
+//
+// opexpression() parses the same language as expression()/simpleexpr() but keeps operators and
+// operands on explicit stacks (shunting-yard). Parentheses, argument lists of subroutine calls,
+// and array indices open a new frame on a third stack; each frame delimits the operators and
+// operands that belong to it and remembers the node that receives the frame's value(s).
+//
+// Binding powers (higher binds tighter):
+//   relOp  1  (at most one per expression; never in a simpleexpr)
+//   termOp 2
+//   sign   3  (unary +/-, only at the start of a simpleexpr; applies to the first term)
+//   factOp 4
+//   "!"    5  (applies to a factor)
+//
+
+CAstExpression* CParser::opexpression(CAstScope *s, bool simple)
+{
+  // the stacks are kept across calls to avoid reallocating them for every expression
+  vector<CAstExpression*> &operands = _operands;
+  vector<SExprOp> &ops = _ops;
+  vector<SExprFrame> &frames = _frames;
+
+  operands.clear();
+  ops.clear();
+  frames.clear();
+
+  // reduce operators of the current frame with a binding power >= prec
+  auto reduce = [&](int prec) {
+    while ((ops.size() > frames.back().ops) && (ops.back().prec >= prec)) {
+      SExprOp &o = ops.back();
+      CAstExpression *r = operands.back();
+      if (o.unary) {
+        operands.back() = _arena->New<CAstUnaryOp>(o.token, o.op, r);
+      } else {
+        operands.pop_back();
+        operands.back() = _arena->New<CAstBinaryOp>(o.token, o.op, operands.back(), r);
+      }
+      ops.pop_back();
+    }
+  };
+
+  frames.push_back({ efTop, NULL, 0, 0, simple, false });
+
+  bool operand = true;              // expecting an operand
+  bool start = true;                // at the start of a simpleexpr (a sign is allowed)
+
+  while (true) {
+    // recovery mode: the expression is replaced by an error node
+    if (_panic) return _arena->New<CAstExprError>(_diagnostics.back().token);
+
+    if (operand) {
+      CToken t;
+      EToken tt = _scanner->Peek().GetType();
+
+      switch (tt) {
+        case tIdent:
+          t = Consume(tIdent);
+
+          if (_scanner->Peek().GetType() == tLBrak) {
+            // subroutine call: open an argument frame unless the argument list is empty
+            CAstFunctionCall *call = _arena->New<CAstFunctionCall>(t, GetProcedure(s, t), _arena);
+            Consume(tLBrak);
+            if (_scanner->Peek().GetType() == tRBrak) {
+              Consume(tRBrak);
+              operands.push_back(call);
+              operand = false;
+            } else {
+              frames.push_back({ efCall, call, ops.size(), operands.size(), false, false });
+              start = true;
+            }
+          } else {
+            const CSymbol *sym = GetVariable(s, t);
+
+            if (_scanner->Peek().GetType() == tLBrakSQ) {
+              CAstArrayDesignator *arrayn = _arena->New<CAstArrayDesignator>(t, sym, _arena);
+              Consume(tLBrakSQ);
+              frames.push_back({ efIndex, arrayn, ops.size(), operands.size(), true, false });
+              start = true;
+            } else {
+              operands.push_back(_arena->New<CAstDesignator>(t, sym));
+              operand = false;
+            }
+          }
+          break;
+
+        case tNumber:
+          operands.push_back(number());
+          operand = false;
+          break;
+
+        case tTrue:
+        case tFalse:
+          operands.push_back(boolean());
+          operand = false;
+          break;
+
+        case tCharConst:
+          t = Consume(tCharConst);
+          operands.push_back(_arena->New<CAstConstant>(t, CTypeManager::Get()->GetChar(),
+                                                       (unsigned char)t.GetUnescapedValue()[0]));
+          operand = false;
+          break;
+
+        case tStringConst:
+          t = Consume(tStringConst);
+          operands.push_back(_arena->New<CAstStringConstant>(t, StringSymbol(t)));
+          operand = false;
+          break;
+
+        case tLBrak:
+          Consume(tLBrak);
+          frames.push_back({ efParen, NULL, ops.size(), operands.size(), false, false });
+          start = true;
+          break;
+
+        case tLogicNOT:
+          t = Consume(tLogicNOT);
+          ops.push_back({ t, opNot, 5, true });
+          start = false;
+          break;
+
+        case tPlusMinus:
+          if (start) {
+            t = Consume(tPlusMinus);
+            if (_scanner->Peek().GetType() == tNumber) {
+              // fold the sign into the constant
+              CAstConstant *c = number();
+              if (t.GetSubkind() == skMinus) c->FoldNeg();
+              operands.push_back(c);
+              operand = false;
+            } else {
+              ops.push_back({ t, t.GetSubkind() == skPlus ? opPos : opNeg, 3, true });
+            }
+            start = false;
+            break;
+          }
+          // fall through
+
+        default:
+          SetError(_scanner->Peek(), "factor expected.");
+          break;
+      }
+    } else {
+      SExprFrame &f = frames.back();
+      const CToken &p = _scanner->Peek();
+      EToken tt = p.GetType();
+      int prec = 0;
+
+      if ((tt == tMulDiv) || (tt == tLogicAND)) prec = 4;
+      else if ((tt == tPlusMinus) || (tt == tLogicOR)) prec = 2;
+      else if ((tt == tRelOp) && !f.simple && !f.relop) prec = 1;
+
+      if (prec > 0) {
+        // binary operator: reduce left operand, then expect the right one
+        CToken t;
+        t = Consume(tt);
+        reduce(prec);
+        ops.push_back({ t, GetOperation(t), prec, false });
+        if (prec == 1) f.relop = true;
+        operand = true;
+        start = prec == 1;
+        continue;
+      }
+
+      // end of the frame's expression
+      reduce(0);
+      assert(operands.size() == f.operands + 1);
+      CAstExpression *e = operands.back();
+      operands.pop_back();
+
+      switch (f.kind) {
+        case efTop:
+          return e;
+
+        case efParen:
+          Consume(tRBrak);
+          e->SetParenthesized(true);
+          frames.pop_back();
+          operands.push_back(e);
+          break;
+
+        case efCall:
+          static_cast<CAstFunctionCall*>(f.node)->AddArg(e);
+          if (_scanner->Peek().GetType() == tComma) {
+            Consume(tComma);
+            f.relop = false;
+            operand = start = true;
+          } else {
+            Consume(tRBrak);
+            operands.push_back(f.node);
+            frames.pop_back();
+          }
+          break;
+
+        case efIndex:
+          static_cast<CAstArrayDesignator*>(f.node)->AddIndex(e);
+          Consume(tRBrakSQ);
+          if (_scanner->Peek().GetType() == tLBrakSQ) {
+            Consume(tLBrakSQ);
+            operand = start = true;
+          } else {
+            static_cast<CAstArrayDesignator*>(f.node)->IndicesComplete();
+            operands.push_back(f.node);
+            frames.pop_back();
+          }
+          break;
+      }
+    }
+  }
 }
 
 CAstConstant* CParser::number(void)
@@ -499,13 +1272,13 @@ CAstConstant* CParser::number(void)
 
   CToken t;
 
-  Consume(tNumber, &t);
-  errno = 0;
-  long long v = strtoll(t.GetValue().c_str(), NULL, 10);
-  if (errno != 0) SetError(t, "invalid number");
+  t = Consume(tNumber);
+  // the value has been decoded by the scanner
+  if (t.GetSubkind() == skOutOfRange) ReportError(t, "invalid number");
+  long long v = t.GetNumber();
   
-  if(t.GetValue().back() == 'L') return new CAstConstant(t, CTypeManager::Get()->GetLongint(), v); // longint if last character is 'L'
-  else return new CAstConstant(t, CTypeManager::Get()->GetInteger(), v);
+  if(t.GetSubkind() == skLongint) return _arena->New<CAstConstant>(t, CTypeManager::Get()->GetLongint(), v); // longint if suffixed by 'L'
+  else return _arena->New<CAstConstant>(t, CTypeManager::Get()->GetInteger(), v);
 }
 CAstConstant* CParser::boolean(void)
 {
@@ -513,21 +1286,22 @@ CAstConstant* CParser::boolean(void)
   // boolean: true or false
   //
 
-  CToken t = _scanner->Peek(); // check the next token, type must be 'tTrue' or 'tFalse'
+  CToken t;
+  EToken tt = _scanner->Peek().GetType(); // check the next token, type must be 'tTrue' or 'tFalse'
 
-  long long v;
+  long long v = 0;
 
-  if(t.GetType() == tTrue) {
-    Consume(tTrue, &t);
+  if(tt == tTrue) {
+    t = Consume(tTrue);
     v = 1;
   }
-  else if (t.GetType() == tFalse) {
-    Consume(tFalse, &t);
+  else if (tt == tFalse) {
+    t = Consume(tFalse);
     v = 0;
   }
-  else SetError(t, "invalid boolean.");
+  else SetError(_scanner->Peek(), "invalid boolean.");
   
-  return new CAstConstant(t, CTypeManager::Get()->GetBool(),  v);
+  return _arena->New<CAstConstant>(t, CTypeManager::Get()->GetBool(),  v);
 }
 
 CAstProcedure* CParser::subroutinedecl(CAstScope* s){
@@ -543,135 +1317,218 @@ CAstProcedure* CParser::subroutinedecl(CAstScope* s){
   CToken t1 = _scanner->Peek(); // first token (function or procedure)
   CToken itoken; // identifier for function/procedure name (retained to check whether it matches identifier at the end)
   CSymProc* symprocedure;
-  CType* returntype;
   CAstProcedure* proc_scopenode;
   // procedureDecl
   if(t1.GetType() == tProcedure){
-    Consume(tProcedure, NULL);
+    Consume(tProcedure);
   }
   // functionDecl
   else{
-    Consume(tFunction, NULL);
+    Consume(tFunction);
   }
 
   // in both cases, consume identifier and create CSymProc symbol and CAstProcedure node
   // from this point onwards, the scope is proc_scopenode, not s.
-  Consume(tIdent, &itoken);
+  itoken = Consume(tIdent);
   symprocedure = new CSymProc(itoken.GetValue(), CTypeManager::Get()->GetNull());
-  proc_scopenode = new CAstProcedure(t, itoken.GetValue(), s, symprocedure);
+  AddSymbol(s, symprocedure, itoken);
+  proc_scopenode = _arena->New<CAstProcedure>(t, itoken.GetValue(), s, symprocedure);
   
   // if formalParam exists, get parameters from varDeclSequence
-  t = _scanner->Peek();
-  if(t.GetType() == tLBrak){
-    Consume(tLBrak, NULL);
-    if(t.GetType() == tRBrak) Consume(tRBrak, NULL); // no varDeclSequence, just brackets
-    else {
+  if(_scanner->Peek().GetType() == tLBrak){
+    Consume(tLBrak);
+    if(_scanner->Peek().GetType() != tRBrak) {
       // continue parsing variable declarations as long as there is a semicolon
       while(true){
-        vardecl(proc_scopenode, symprocedure);
-        
-        t = _scanner->Peek();
-        if(t.GetType() != tSemicolon) break;
-        else Consume(tSemicolon, NULL);
-      }
+        vector<CToken> idents;
+        const CType *ptype = vardecl(proc_scopenode, idents, mFormalPar);
 
-      Consume(tRBrak, NULL);
+        // arrays are passed by reference
+        if (ptype->IsArray()) ptype = CTypeManager::Get()->GetPointer(ptype);
+
+        for (const CToken &id : idents) {
+          CSymParam *symparam = new CSymParam(symprocedure->GetNParams(), id.GetValue(), ptype);
+          AddSymbol(proc_scopenode, symparam, id);
+          symprocedure->AddParam(symparam);
+        }
+
+        if(_panic || (_scanner->Peek().GetType() != tSemicolon)) break;
+        else Consume(tSemicolon);
+      }
     }
+    Consume(tRBrak);
   }
 
-  // if procedure, only need to consume semicolon
-  if(t1.GetType() == tProcedure){
-    Consume(tSemicolon, NULL);
-  }
-  // if function, ":" type ";"
-  else{
-    Consume(tColon, NULL);
+  // if function, ":" type
+  if(t1.GetType() == tFunction){
+    Consume(tColon);
     symprocedure->SetDataType(type(proc_scopenode)->GetType());
-    Consume(tSemicolon, NULL);
   }
 
+  // recovery mode: skip the rest of a malformed heading
+  Synchronize({ tSemicolon, tExtern, tConst, tVar, tBegin, tProcedure, tFunction });
+  Consume(tSemicolon);
 
 
   if(_scanner->Peek().GetType() == tExtern){
+    Consume(tExtern);
     symprocedure->SetExternal(true);
   }
-  else{
-    constdeclaration(proc_scopenode);
-    vardeclaration(proc_scopenode);
-    CAstStatement* statementseq = statSequence(proc_scopenode);
-    Consume(tBegin, NULL);
-    proc_scopenode->SetStatementSequence(statementseq);
-    Consume(tEnd, NULL);
-
-    Consume(tIdent, &t);
-    if(t.GetValue() != itoken.GetValue()) SetError(t, "Identifier mismatch in subroutine declaration");
+  // the body is parsed by a worker thread if possible
+  else if ((_env == NULL) || !DeferBody(proc_scopenode, itoken)) {
+    subroutineBody(proc_scopenode, itoken);
   }
 
-  Consume(tSemicolon, NULL);
+  Consume(tSemicolon);
 
   return proc_scopenode;
 }
 
-const CType* CParser::vardecl(CAstScope* s, CSymProc* p){
-  // add variables declared to the symbol table of scope s
+void CParser::subroutineBody(CAstProcedure *s, const CToken &ident){
+  // subroutineBody    = constDeclaration varDeclaration "begin" statSequence "end".
+  // followed by the identifier of the subroutine
+  if (_scanner->Peek().GetType() == tConst) constdeclaration(s);
+  if (_scanner->Peek().GetType() == tVar) vardeclaration(s);
+  Consume(tBegin);
+  CAstStatement* statementseq = statSequence(s);
+  s->SetStatementSequence(statementseq);
+  Consume(tEnd);
+
+  const CToken &t = Consume(tIdent);
+  if(t.GetId() != ident.GetId()) {
+    ReportError(t, "procedure/function identifier mismatch ('" + ident.GetValue() + "' != '" +
+             t.GetValue() + "').");
+  }
+}
+
+void CParser::constdeclaration(CAstScope* s){
+  // constDeclaration  = [ "const" constDeclSequence ].
+  // constDeclSequence = constDecl ";" { constDecl ";" }
+  // constDecl         = varDecl "=" expression.
+  CToken t;
+
+  Consume(tConst);
+
+  do {
+    vector<CToken> idents;
+    const CType *ctype = vardecl(s, idents, mConstant);
+
+    t = Consume(tRelOp);
+    if (t.GetSubkind() != skEqual) ReportError(t, "'=' expected.");
+
+    CAstExpression *e = expression(s);
+    CDataValue data = e->Evaluate();
+    if (!data.IsValid()) ReportError(e->GetToken(), "constant expression expected.");
+
+    for (const CToken &id : idents) {
+      // recovery mode: constants without a value are declared as variables
+      CSymbol *sym = data.IsValid() ? s->CreateConst(id.GetValue(), ctype, data)
+                                    : s->CreateVar(id.GetValue(), ctype);
+      AddSymbol(s, sym, id);
+    }
+
+    // recovery mode: skip the rest of a malformed declaration
+    Synchronize({ tSemicolon, tConst, tVar, tProcedure, tFunction, tBegin, tEnd, tDot });
+    Consume(tSemicolon);
+  } while (!_panic && (_scanner->Peek().GetType() == tIdent));
+}
+
+void CParser::vardeclaration(CAstScope* s){
+  // varDeclaration    = [ "var" varDeclSequence ";" ].
+  // varDeclSequence   = varDecl { ";" varDecl }.
+  //
+  // FOLLOW(varDeclaration) does not contain tIdent, so a semicolon followed by an identifier
+  // continues the sequence
+  Consume(tVar);
+
+  do {
+    vector<CToken> idents;
+    const CType *vtype = vardecl(s, idents, mVariable);
+
+    for (const CToken &id : idents) AddSymbol(s, s->CreateVar(id.GetValue(), vtype), id);
+
+    // recovery mode: skip the rest of a malformed declaration
+    Synchronize({ tSemicolon, tConst, tVar, tProcedure, tFunction, tBegin, tEnd, tDot });
+    Consume(tSemicolon);
+  } while (!_panic && (_scanner->Peek().GetType() == tIdent));
+}
+
+const CType* CParser::vardecl(CAstScope* s, vector<CToken> &idents, EType mode){
   // varDecl           = ident { "," ident } ":" type
-  
-  CToken t, idt; // t is peeking token, idt is identifier
-  const CType* ctype;
-  bool typeknown = false;
-
-  Consume(tIdent, &idt);
-  if(_scanner->Peek().GetType() == tComma){
-    // what is remaining after removing [ident ","] is still a vardecl as there is at least one more ident remaining
-    Consume(tComma, NULL);
-    ctype = vardecl(s);
-    typeknown = true;
-  }
-  // if there is no comma and type is not known, colon then type is followed. Return that type to calling instance, as the type will have to be used in all of iterations.
-  if(!typeknown){
-    t = _scanner->Peek();
-    if(t.GetType() == tColon) Consume(tColon, NULL);
-    // get type
-    else if (t.GetType() == tBoolean || t.GetType() == tChar || t.GetType() == tInteger || t.GetType() == tLongInt){
-      CAstType* tmp = type(s);
-      ctype = tmp->GetType();
-      typeknown = true;
-      delete tmp; // AST node of type is unnecessary (maybe? this may have to be modified later)
+  identlist(idents);
+  Consume(tColon);
+  return type(s, mode)->GetType();
+}
+
+void CParser::identlist(vector<CToken> &idents){
+  // ident { "," ident }
+  if (_mode == pmIterative) {
+    idents.push_back(Consume(tIdent));
+    while (!_panic && (_scanner->Peek().GetType() == tComma)) {
+      Consume(tComma);
+      idents.push_back(Consume(tIdent));
+    }
+  } else {
+    idents.push_back(Consume(tIdent));
+    if(!_panic && (_scanner->Peek().GetType() == tComma)){
+      // what is remaining after removing [ident ","] is still an identifier list
+      Consume(tComma);
+      identlist(idents);
     }
   }
-  
-  if(!typeknown) SetError(idt, "type is not known after variable declaration");
-  // after the type is known, create symbol with corresponding type
-      CSymbol *nsym = s->CreateVar(idt.GetValue(), ctype);
-      s->GetSymbolTable()->AddSymbol(nsym);
-      if(p){
-        CSymParam *symparam = new CSymParam(p->GetNParams(), idt.GetValue(), ctype);
-        p->AddParam(symparam);
-      }
-      return ctype;
-  
 }
 
-CAstType* CParser::type(CAstScope* s){
-  // for the time being, does not consider array types (only consumes tokens)
+CAstType* CParser::type(CAstScope* s, EType mode){
   // type              = basetype | type "[" [ simpleexpr ] "]".
-  CToken t, base;
-  const CType* tp;
+  //
+  // open arrays ("[]") are only allowed for formal parameters and constants (whose size is that
+  // of the value)
+  CToken base;
+  const CType* tp = NULL;
+  vector<unsigned int> dims;
+
   base = _scanner->Peek();
   if(base.GetType() == tBoolean) tp = CTypeManager::Get()->GetBool();
   else if(base.GetType() == tChar) tp = CTypeManager::Get()->GetChar();
   else if(base.GetType() == tInteger) tp = CTypeManager::Get()->GetInteger();
   else if (base.GetType() == tLongInt) tp = CTypeManager::Get()->GetLongint();
+  else SetError(base, "type expected.");
+  Consume(base.GetType());
 
+  // recovery mode: continue with the NULL type
+  if (tp == NULL) tp = CTypeManager::Get()->GetNull();
 
-  Consume(base.GetType(), &t);
   // array
-  while(_scanner->Peek().GetType() == tLBrakSQ){
-    Consume(tLBrakSQ, NULL);
-    simpleexpr(s);
-    Consume(tLBrakSQ, NULL);
+  while(!_panic && (_scanner->Peek().GetType() == tLBrakSQ)){
+    Consume(tLBrakSQ);
+    if (((mode == mFormalPar) || (mode == mConstant)) &&
+        (_scanner->Peek().GetType() == tRBrakSQ)) {
+      dims.push_back((unsigned int)CArrayType::OPEN);
+    } else {
+      CAstExpression *e = simpleexpr(s);
+      CDataValue data = e->Evaluate();
+      long long n = -1;
+
+      if (data.IsInt()) n = data.GetNumber();
+      else {
+        ReportError(e->GetToken(), "constant expression expected.");
+        n = 1;
+      }
+
+      // recovery mode: continue with a valid dimension
+      if ((n <= 0) || (n > CArrayType::MAX_SIZE)) {
+        ReportError(e->GetToken(), "invalid array dimension.");
+        n = 1;
+      }
+      dims.push_back((unsigned int)n);
+    }
+    Consume(tRBrakSQ);
   }
 
-  CAstType* n = new CAstType(base, tp);
-}
+  // the first dimension is the outermost one
+  for (auto it = dims.rbegin(); it != dims.rend(); it++) {
+    tp = CTypeManager::Get()->GetArray(*it, tp);
+  }
 
+  return _arena->New<CAstType>(base, tp);
+}
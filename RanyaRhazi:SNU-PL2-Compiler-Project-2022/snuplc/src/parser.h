@@ -36,6 +36,9 @@
 #ifndef __SnuPL_PARSER_H__
 #define __SnuPL_PARSER_H__
 
+#include <initializer_list>
+#include <unordered_map>
+
 #include "scanner.h"
 #include "symtab.h"
 #include "ast.h"
@@ -50,22 +53,166 @@ enum EType {
   mFormalPar,                       ///< formal parameter definition
 };
 
+//--------------------------------------------------------------------------------------------------
+/// @brief parsing strategies for expressions and identifier lists
+///
+/// Both strategies build identical ASTs. The recursive-descent parser uses one stack frame per
+/// precedence level, parenthesis, and identifier in a list; the iterative parser keeps its state
+/// on an explicit stack and is thus not limited by the size of the call stack.
+///
+enum EParseMode {
+  pmIterative=0,                    ///< operator precedence parsing with an explicit stack
+  pmRecursive,                      ///< recursive descent
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief operator on the operator stack of CParser::opexpression()
+///
+struct SExprOp {
+  CToken      token;                ///< operator token
+  EOperation  op;                   ///< operation
+  int         prec;                 ///< binding power
+  bool        unary;                ///< unary (prefix) operator
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief frame kinds of CParser::opexpression()
+///
+enum EExprFrame {
+  efTop=0,                          ///< expression/simpleexpr being parsed
+  efParen,                          ///< "(" expression ")"
+  efCall,                           ///< subroutine call arguments
+  efIndex,                          ///< array index
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief nesting frame on the frame stack of CParser::opexpression()
+///
+struct SExprFrame {
+  EExprFrame  kind;                 ///< frame kind
+  CAstExpression *node;             ///< call or array designator receiving the values
+  size_t      ops;                  ///< operator stack height at frame start
+  size_t      operands;             ///< operand stack height at frame start
+  bool        simple;               ///< frame contains a simpleexpr (no relOp)
+  bool        relop;                ///< frame already contains a relOp
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief syntax error recorded by the error-recovering parser
+///
+struct SDiagnostic {
+  CToken      token;                ///< token at which the error was detected
+  string      message;              ///< human-readable error message
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief module-level symbol as seen by deferred subroutine bodies
+///
+struct SGlobalSymbol {
+  const CSymbol *symbol;            ///< symbol
+  size_t      order;                ///< number of module-level symbols declared before it
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief deferred subroutine body
+///
+/// parsed on a worker thread (parallel parsing) or on demand (lazy parsing)
+///
+struct SBodyJob {
+  CAstProcedure *proc;              ///< procedure/function scope
+  CToken      ident;                ///< procedure/function identifier
+  size_t      start;                ///< index of the first token of the body
+  size_t      end;                  ///< index of the token following "end" ident
+  size_t      visible;              ///< number of module-level symbols visible in the body
+  size_t      mark;                 ///< number of nodes created by the main thread before the body
+  vector<CAstNode*> nodes;          ///< nodes of the body in order of creation
+  bool        ok;                   ///< body has been parsed successfully
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief environment shared by the deferred subroutine bodies of a module
+///
+struct SBodyEnv {
+  CContext   *ctx;                  ///< context of the token array
+  const CToken *tokens;             ///< token array of the entire input
+  size_t      ntokens;              ///< number of tokens
+  EParseMode  mode;                 ///< parsing strategy
+  bool        lazy;                 ///< bodies are parsed on demand
+  CAstModule *module;               ///< module
+  unordered_map<unsigned int, SGlobalSymbol> globals; ///< module-level symbols by identifier id
+};
+
+//--------------------------------------------------------------------------------------------------
+/// @brief subroutine body parsed on demand
+///
+/// The body refers to the token array and the context of the scanner that read the module; both
+/// must outlive the materialization of the body.
+///
+class CLazyBody : public CAstDeferredBody {
+  public:
+    /// @brief constructor
+    ///
+    /// @param env environment shared by the bodies of the module
+    /// @param job extent of the body
+    CLazyBody(const SBodyEnv *env, const SBodyJob &job);
+
+    /// @brief parse the body into scope @a s
+    virtual bool Materialize(CAstScope *s, CToken *t, string *msg);
+
+  private:
+    const SBodyEnv *_env;           ///< environment
+    SBodyJob    _job;               ///< extent of the body
+};
+
 //--------------------------------------------------------------------------------------------------
 /// @brief parser
 ///
 /// parses a module
 ///
 class CParser {
+  friend class CLazyBody;
   public:
     /// @brief constructor
     ///
     /// @param scanner  CScanner from which the input stream is read
-    CParser(CScanner *scanner);
+    /// @param mode     parsing strategy for expressions and identifier lists
+    /// @param nthreads number of threads parsing subroutine bodies
+    /// @param lazy     parse subroutine bodies on demand
+    /// @param recover  recover from errors instead of aborting at the first one
+    CParser(CScanner *scanner, EParseMode mode=pmIterative, unsigned int nthreads=1,
+            bool lazy=false, bool recover=false);
 
     /// @brief parse a module
+    ///
+    /// With more than one thread, the input is tokenized and the bodies of subroutines are parsed
+    /// on worker threads while the main thread parses the declarations and subroutine headers
+    /// (see ParseDeferred()). The result is identical to that of a sequential parse.
+    ///
+    /// In lazy mode, the bodies of subroutines are skipped and only parsed when their symbol
+    /// table or statement sequence is first requested (see CAstScope::Materialize()); errors in
+    /// a body are reported by materialization and type checking. The scanner must outlive the
+    /// module.
+    ///
+    /// In recovery mode, the module is always parsed sequentially and Parse() never throws or
+    /// discards the module: errors are recorded (see GetDiagnostics()), the input is skipped up
+    /// to the next ";", "end", or "." (or the next declaration), and constructs that could not
+    /// be parsed are represented by CAstStatError and CAstExprError nodes.
+    ///
     /// @retval CAstNode program node
     CAstNode* Parse(void);
 
+    /// @brief return the parsing strategy for expressions and identifier lists
+    EParseMode GetMode(void) const { return _mode; };
+
+    /// @brief return the number of threads parsing subroutine bodies
+    unsigned int GetThreads(void) const { return _nthreads; };
+
+    /// @brief check whether subroutine bodies are parsed on demand
+    bool IsLazy(void) const { return _lazy; };
+
+    /// @brief check whether the parser recovers from errors
+    bool IsRecovering(void) const { return _recover; };
+
     /// @name error handling
     ///@{
 
@@ -81,26 +228,69 @@ class CParser {
     /// @brief returns a human-readable error message
     /// @retval error message
     string GetErrorMessage(void) const;
+
+    /// @brief returns all errors in the order they were detected (recovery mode)
+    /// @retval list of errors; GetErrorToken()/GetErrorMessage() refer to the first one
+    const vector<SDiagnostic>& GetDiagnostics(void) const { return _diagnostics; };
     ///@}
 
   private:
     /// @brief sets the token causing a parse error along with a message
+    ///
+    /// In recovery mode, the error is recorded and the parser skips input until the next call
+    /// to Synchronize(); otherwise, parsing is aborted.
+    ///
+    /// @param t token causing the error
+    /// @param message human-readable error message
+    void SetError(const CToken &t, const string &message);
+
+    /// @brief report an error after which the parser is still in sync with the input
+    ///
+    /// Same as SetError() except that in recovery mode, parsing continues normally.
+    ///
     /// @param t token causing the error
     /// @param message human-readable error message
-    void SetError(CToken t, const string message);
+    void ReportError(const CToken &t, const string &message);
+
+    /// @brief resume parsing after an error (recovery mode)
+    ///
+    /// Skips tokens up to one in @a follow (or the end of the input). Nested "begin", "if",
+    /// and "while" statements are skipped including their "end". Does nothing unless the parser
+    /// is skipping input after an error.
+    ///
+    /// @param follow tokens at which parsing resumes
+    void Synchronize(initializer_list<EToken> follow);
 
-    /// @brief consume a token given type and optionally store the token
+    /// @brief consume a token of a given type
     /// @param type expected token type
-    /// @param token If not null, the consumed token is stored in 'token'
-    /// @retval true if a token has been consumed
-    /// @retval false otherwise
-    bool Consume(EToken type, CToken *token=NULL);
+    /// @retval the consumed token (valid until the next call to Consume)
+    const CToken& Consume(EToken type);
 
 
     /// @brief initialize symbol table @a s with predefined procedures and
     ///        global variables
     void InitSymbolTable(CSymtab *s);
 
+    /// @brief return the operation denoted by an operator token
+    /// @param t operator token (relOp, termOp, or factOp)
+    EOperation GetOperation(const CToken &t);
+
+    /// @brief look up the symbol named by identifier @a t in scope @a s and its parents
+    const CSymbol* FindSymbol(CAstScope *s, const CToken &t);
+
+    /// @brief look up the variable or constant named by identifier @a t in scope @a s
+    const CSymbol* GetVariable(CAstScope *s, const CToken &t);
+
+    /// @brief return the procedure symbol for a call of identifier @a t in scope @a s
+    const CSymProc* GetProcedure(CAstScope *s, const CToken &t);
+
+    /// @brief add symbol @a sym to the symbol table of scope @a s
+    /// @param t identifier token (for error reporting)
+    void AddSymbol(CAstScope *s, CSymbol *sym, const CToken &t);
+
+    /// @brief return the pooled symbol holding the value of string constant @a t
+    const CSymGlobal* StringSymbol(const CToken &t);
+
     /// @name methods for recursive-descent parsing
     /// @{
 
@@ -109,41 +299,103 @@ class CParser {
     CAstStatement*    statSequence(CAstScope *s);
 
     CAstStatAssign*   assignment(CAstScope *s);
+    CAstStatIf*       ifStatement(CAstScope *s);
+    CAstStatWhile*    whileStatement(CAstScope *s);
+    CAstStatReturn*   returnStatement(CAstScope *s);
 
     CAstExpression*   expression(CAstScope *s);
     CAstExpression*   simpleexpr(CAstScope *s);
     CAstExpression*   term(CAstScope *s);
-    CAstFunctionCall* subroutinecall(CAstScope *s, CToken prev = CToken());
+    CAstFunctionCall* subroutinecall(CAstScope *s, const CToken *ident = NULL);
     CAstExpression*   factor(CAstScope *s);
 
-    CAstDesignator*   qualident(CAstScope *s, CToken prev = CToken());
-    CAstDesignator*   identifier(CAstScope *s);
+    CAstDesignator*   qualident(CAstScope *s, const CToken *ident = NULL);
     CAstConstant*     number(void);
     CAstConstant*     boolean(void);
 
     CAstProcedure*    subroutinedecl(CAstScope *s);
-    CAstType*         type(CAstScope* s);
+    CAstType*         type(CAstScope* s, EType mode=mVariable);
+
+    /// parse a varDecl; returns the declared type and stores the identifiers in @a idents
+    const CType*      vardecl(CAstScope *s, vector<CToken> &idents, EType mode);
+    void              identlist(vector<CToken> &idents);
 
-    /// add declared variables to the symbol table of scope s.
-    // p is given when parameters are declared (AddParam necessary)
-    const CType*      vardecl(CAstScope *s, CSymProc* p = NULL);
+    void              vardeclaration(CAstScope* s);
+    void              constdeclaration(CAstScope* s);
 
-    // to be made later
-    void vardeclaration(CAstScope* s);
-    void constdeclaration(CAstScope* s);
+    /// parse a subroutineBody followed by the identifier of the subroutine @a ident
+    void              subroutineBody(CAstProcedure *s, const CToken &ident);
 
-    
     /// @}
 
+    /// @name deferred parsing of subroutine bodies
+    ///
+    /// The main thread parses the module with the token array of the tokenized input. Instead of
+    /// parsing subroutine bodies, it locates their extent with a pre-pass that matches "begin",
+    /// "if", and "while" with their "end" tokens and records a job. Before the statement sequence
+    /// of the module, the jobs are handed to a pool of worker threads. Each body is parsed by its
+    /// own CParser into the arena of the worker; module-level symbols are looked up in a read-only table
+    /// that also tracks which symbols a sequential parse would have seen at that point. Afterwards,
+    /// nodes are renumbered in the order of a sequential parse. If anything goes wrong, the
+    /// module is parsed again sequentially so that errors are reported exactly as before.
+    ///
+    /// Lazy parsing skips the bodies in the same way but attaches them to their scope as a
+    /// CLazyBody; the shared environment then lives as long as the module.
+    /// @{
+
+    /// @brief parse the module with deferred subroutine bodies
+    /// @retval true on success
+    /// @retval false if the module has to be parsed sequentially
+    bool ParseDeferred(void);
+
+    /// @brief defer the parsing of the body of subroutine @a s
+    /// @param ident identifier of the subroutine
+    /// @retval true if the body has been recorded and skipped
+    /// @retval false if the extent of the body could not be determined
+    bool DeferBody(CAstProcedure *s, const CToken &ident);
+
+    /// @brief parse all subroutine bodies deferred to worker threads
+    void ParseBodies(void);
+
+    /// @brief parse a deferred subroutine body
+    /// @param env environment shared by the bodies of the module
+    /// @param job job
+    /// @param arena arena receiving the nodes of the body
+    /// @param t (out, optional) error token
+    /// @param msg (out, optional) error message
+    static void ParseBody(const SBodyEnv *env, SBodyJob *job, CArena *arena,
+                          CToken *t=NULL, string *msg=NULL);
+
+    /// @}
+
+    /// @brief parse an expression (or a simpleexpr if @a simple is set) by operator precedence
+    ///
+    /// Parentheses, subroutine arguments, and array indices are tracked on an explicit stack;
+    /// the method does not recurse.
+    CAstExpression*   opexpression(CAstScope *s, bool simple);
+
 
     CScanner     *_scanner;       ///< CScanner instance
+    EParseMode    _mode;          ///< parsing strategy
+    unsigned int  _nthreads;      ///< number of threads parsing subroutine bodies
+    bool          _lazy;          ///< parse subroutine bodies on demand
+    bool          _recover;       ///< recover from errors
+    vector<SBodyJob> *_jobs;      ///< subroutine bodies deferred to worker threads
+    SBodyEnv     *_env;           ///< environment of deferred bodies (deferred parsing)
+    const SBodyJob *_job;         ///< deferred subroutine body being parsed
+    vector<CAstExpression*> _operands; ///< operand stack (opexpression)
+    vector<SExprOp> _ops;         ///< operator stack (opexpression)
+    vector<SExprFrame> _frames;   ///< frame stack (opexpression)
     CAstModule   *_module;        ///< root node of the program
-    CToken        _token;         ///< current token
+    CArena       *_arena;         ///< arena of the module being parsed
+    CToken        _token;         ///< last consumed token
 
     /// @name error handling
     CToken        _error_token;   ///< error token
     string        _message;       ///< error message
     bool          _abort;         ///< error flag
+    bool          _panic;         ///< skipping input after an error (recovery mode)
+    vector<SDiagnostic> _diagnostics; ///< errors (recovery mode)
 
 };
 
@@ -42,14 +42,24 @@
 #include <cstring>
 #include <cassert>
 #include <cstdio>
+#include <climits>
+#include <thread>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "scanner.h"
+#include "tokfile.h"
 using namespace std;
 
 //--------------------------------------------------------------------------------------------------
 // token names
 //
 #define TOKEN_STRLEN 21
+#define MAX_STRLEN 128
 
 char ETokenName[][TOKEN_STRLEN] = {
   "tPlusMinus",                       ///< '+' or '-'
@@ -158,34 +168,246 @@ char ETokenStr[][TOKEN_STRLEN] = {
   "tStringConst (%s)",                     ///< string constant
 };
 
+/// @brief values of tokens that are fully determined by their type
+const char *ETokenText[] = {
+  "",  "",  "&&", "||", "",  ":=", ";", ":", ".", ",", "!", "(", ")", "[", "]",
+  "char", "boolean", "integer", "longint", "true", "false", "", "", "extern", "procedure",
+  "function", "if", "then", "while", "do", "else", "module", "begin", "end", "return",
+  "const", "var", "", "", "", "", "", "", "",
+};
+
+static_assert(sizeof(ETokenText)/sizeof(ETokenText[0]) == tStringConst+1,
+              "ETokenText does not match EToken");
+
+/// @brief values of operator tokens, indexed by ESubkind
+const char *ESubkindText[] = {
+  "", "+", "-", "*", "/", "=", "#", "<", "<=", ">", ">=", "", "", "",
+};
+
 
 //--------------------------------------------------------------------------------------------------
 // reserved keywords
 //
-pair<const char*, EToken> Keywords[] =
-{
-    make_pair("char", tChar),
-    make_pair("boolean", tBoolean),
-    make_pair("integer", tInteger),
-    make_pair("longint", tLongInt),
-    make_pair("true", tTrue),
-    make_pair("false",tFalse),
-    make_pair("extern",tExtern),
-    make_pair("procedure", tProcedure),
-    make_pair("function", tFunction),
-    make_pair("if", tIf),
-    make_pair("then", tThen),
-    make_pair("while", tWhile),
-    make_pair("do", tDo),
-    make_pair("else", tElse),
-    make_pair("module", tModule),
-    make_pair("begin", tBegin),
-    make_pair("end", tEnd),
-    make_pair("return", tReturn),
-    make_pair("const", tConst),
-    make_pair("var", tVar)
+// Keywords are identified by a perfect hash over (length, first character, last character) that
+// is computed at compile time; a final comparison of the candidate's text confirms the match.
+//
+struct SKeyword {
+  const char   *name;               ///< keyword
+  unsigned int  len;                ///< length of keyword
+  EToken        token;              ///< corresponding token
+};
+
+#define KW(name, token) { name, sizeof(name)-1, token }
+
+static constexpr SKeyword Keywords[] =
+{
+    KW("char", tChar),
+    KW("boolean", tBoolean),
+    KW("integer", tInteger),
+    KW("longint", tLongInt),
+    KW("true", tTrue),
+    KW("false",tFalse),
+    KW("extern",tExtern),
+    KW("procedure", tProcedure),
+    KW("function", tFunction),
+    KW("if", tIf),
+    KW("then", tThen),
+    KW("while", tWhile),
+    KW("do", tDo),
+    KW("else", tElse),
+    KW("module", tModule),
+    KW("begin", tBegin),
+    KW("end", tEnd),
+    KW("return", tReturn),
+    KW("const", tConst),
+    KW("var", tVar)
 };
 
+#undef KW
+
+static constexpr unsigned int NUM_KEYWORDS = sizeof(Keywords) / sizeof(Keywords[0]);
+static constexpr unsigned int KEYWORD_SLOTS = 64;   ///< size of hash table (power of two)
+
+static constexpr unsigned int KeywordHash(unsigned int len, unsigned char first, unsigned char last)
+{
+  return (len + 2*first + 3*last) & (KEYWORD_SLOTS-1);
+}
+
+static constexpr unsigned int KeywordHash(unsigned int i)
+{
+  return KeywordHash(Keywords[i].len, Keywords[i].name[0], Keywords[i].name[Keywords[i].len-1]);
+}
+
+/// index of the keyword that hashes to slot @a h (or -1)
+static constexpr int KeywordSlot(unsigned int h, unsigned int i=0)
+{
+  return i == NUM_KEYWORDS ? -1 : KeywordHash(i) == h ? (int)i : KeywordSlot(h, i+1);
+}
+
+/// check that no two keywords hash to the same slot
+static constexpr bool KeywordHashIsPerfect(unsigned int i=0, unsigned int j=1)
+{
+  return i == NUM_KEYWORDS ? true :
+         j == NUM_KEYWORDS ? KeywordHashIsPerfect(i+1, i+2) :
+         KeywordHash(i) != KeywordHash(j) && KeywordHashIsPerfect(i, j+1);
+}
+
+static_assert(KeywordHashIsPerfect(), "keyword hash function is not perfect");
+
+#define KS4(h)  KeywordSlot(h), KeywordSlot(h+1), KeywordSlot(h+2), KeywordSlot(h+3)
+#define KS16(h) KS4(h), KS4(h+4), KS4(h+8), KS4(h+12)
+
+/// hash table mapping slots to indices into Keywords[]
+static const signed char KeywordTable[KEYWORD_SLOTS] = { KS16(0), KS16(16), KS16(32), KS16(48) };
+
+#undef KS16
+#undef KS4
+
+/// @brief look up a reserved keyword
+///
+/// @param id identifier
+/// @param len length of identifier
+/// @retval token of the keyword or tIdent if @a id is not a keyword
+static EToken FindKeyword(const char *id, size_t len)
+{
+  int k = KeywordTable[KeywordHash(len, id[0], id[len-1])];
+
+  if ((k >= 0) && (Keywords[k].len == len) && (memcmp(Keywords[k].name, id, len) == 0)) {
+    return Keywords[k].token;
+  }
+  return tIdent;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// character classes
+//
+enum {
+  ccWhite = 0x01,                   ///< white space (' ', '\t', '\n')
+  ccAlpha = 0x02,                   ///< alphabetic (a-z, A-Z, _)
+  ccNum   = 0x04,                   ///< numeric (0-9)
+  ccHex   = 0x08,                   ///< hexadecimal digit (0-9, a-f, A-F)
+  ccID    = ccAlpha | ccNum,        ///< valid in an identifier
+};
+
+static constexpr unsigned char CharClassOf(unsigned int c)
+{
+  return ((c == ' ') || (c == '\t') || (c == '\n') ? ccWhite : 0) |
+         ((('a' <= c) && (c <= 'z')) || (('A' <= c) && (c <= 'Z')) || (c == '_') ? ccAlpha : 0) |
+         (('0' <= c) && (c <= '9') ? ccNum | ccHex : 0) |
+         ((('a' <= c) && (c <= 'f')) || (('A' <= c) && (c <= 'F')) ? ccHex : 0);
+}
+
+#define CC4(c)  CharClassOf(c), CharClassOf(c+1), CharClassOf(c+2), CharClassOf(c+3)
+#define CC16(c) CC4(c), CC4(c+4), CC4(c+8), CC4(c+12)
+#define CC64(c) CC16(c), CC16(c+16), CC16(c+32), CC16(c+48)
+
+/// character class table, indexed by (unsigned) character
+static const unsigned char CharClass[256] = { CC64(0), CC64(64), CC64(128), CC64(192) };
+
+#undef CC64
+#undef CC16
+#undef CC4
+
+
+//--------------------------------------------------------------------------------------------------
+// block scanning
+//
+// The routines below return a pointer to the first character in [p, end) that terminates the
+// respective run, or end if there is none. The vector loops process full blocks only; the
+// remaining bytes are handled by the scalar loop.
+//
+#if defined(__AVX2__)
+typedef __m256i VBlock;
+#define V_SIZE          32
+#define V_LOAD(p)       _mm256_loadu_si256((const __m256i*)(p))
+#define V_SET1(c)       _mm256_set1_epi8((char)(c))
+#define V_EQ(a, b)      _mm256_cmpeq_epi8(a, b)
+#define V_OR(a, b)      _mm256_or_si256(a, b)
+#define V_MIN(a, b)     _mm256_min_epu8(a, b)
+#define V_MASK(a)       ((unsigned int)_mm256_movemask_epi8(a))
+#define V_ALL           0xffffffffU
+#elif defined(__SSE2__)
+typedef __m128i VBlock;
+#define V_SIZE          16
+#define V_LOAD(p)       _mm_loadu_si128((const __m128i*)(p))
+#define V_SET1(c)       _mm_set1_epi8((char)(c))
+#define V_EQ(a, b)      _mm_cmpeq_epi8(a, b)
+#define V_OR(a, b)      _mm_or_si128(a, b)
+#define V_MIN(a, b)     _mm_min_epu8(a, b)
+#define V_MASK(a)       ((unsigned int)_mm_movemask_epi8(a))
+#define V_ALL           0xffffU
+#endif
+
+/// @brief skip white space
+static const char* SkipWhiteBlock(const char *p, const char *end)
+{
+#ifdef V_SIZE
+  const VBlock sp = V_SET1(' '), tab = V_SET1('\t'), nl = V_SET1('\n');
+
+  while (end - p >= V_SIZE) {
+    VBlock v = V_LOAD(p);
+    unsigned int m = V_MASK(V_OR(V_OR(V_EQ(v, sp), V_EQ(v, tab)), V_EQ(v, nl))) ^ V_ALL;
+    if (m != 0) return p + __builtin_ctz(m);
+    p += V_SIZE;
+  }
+#endif
+  while ((p < end) && (CharClass[(unsigned char)*p] & ccWhite)) p++;
+  return p;
+}
+
+/// @brief skip to the end of the line (i.e., the next '\n')
+static const char* SkipLineBlock(const char *p, const char *end)
+{
+#ifdef V_SIZE
+  const VBlock nl = V_SET1('\n');
+
+  while (end - p >= V_SIZE) {
+    unsigned int m = V_MASK(V_EQ(V_LOAD(p), nl));
+    if (m != 0) return p + __builtin_ctz(m);
+    p += V_SIZE;
+  }
+#endif
+  const char *q = (const char*)memchr(p, '\n', end - p);
+  return q != NULL ? q : end;
+}
+
+/// @brief skip characters that appear unescaped in a string constant
+///
+/// Stops at '"', '\\', at non-printable characters (including '\n'), and at non-ASCII characters.
+static const char* SkipStringBlock(const char *p, const char *end)
+{
+#ifdef V_SIZE
+  const VBlock quote = V_SET1('"'), bslash = V_SET1('\\'), del = V_SET1(0x7f),
+               ctrl = V_SET1(0x1f);
+
+  while (end - p >= V_SIZE) {
+    VBlock v = V_LOAD(p);
+    VBlock stop = V_OR(V_OR(V_EQ(v, quote), V_EQ(v, bslash)),
+                       V_OR(V_EQ(v, del), V_EQ(V_MIN(v, ctrl), v)));
+    unsigned int m = V_MASK(stop) | V_MASK(v);
+    if (m != 0) return p + __builtin_ctz(m);
+    p += V_SIZE;
+  }
+#endif
+  while (p < end) {
+    unsigned char c = *p;
+    if ((c < ' ') || (c >= 0x7f) || (c == '"') || (c == '\\')) break;
+    p++;
+  }
+  return p;
+}
+
+#ifdef V_SIZE
+#undef V_SIZE
+#undef V_LOAD
+#undef V_SET1
+#undef V_EQ
+#undef V_OR
+#undef V_MIN
+#undef V_MASK
+#undef V_ALL
+#endif
 
 
 //--------------------------------------------------------------------------------------------------
@@ -194,33 +416,23 @@ pair<const char*, EToken> Keywords[] =
 CToken::CToken()
 {
   _type = tUndefined;
-  _value = "";
-  _line = _char = 0;
+  _subkind = skNone;
+  _offset = NO_OFFSET;
+  _payload.number = 0;
 }
 
-CToken::CToken(int line, int charpos, EToken type, const string value)
+CToken::CToken(EToken type, unsigned int offset, ESubkind subkind, unsigned int id)
 {
   _type = type;
-  if ((type==tStringConst) || (type==tCharConst)) _value = escape(type, value);
-  else _value = value;
-  _line = line;
-  _char = charpos;
-}
-
-CToken::CToken(const CToken &token)
-{
-  _type = token.GetType();
-  _value = token.GetValue();
-  _line = token.GetLineNumber();
-  _char = token.GetCharPosition();
+  _subkind = subkind;
+  _offset = offset;
+  _payload.number = 0;
+  _payload.id = id;
 }
 
 CToken::CToken(const CToken *token)
 {
-  _type = token->GetType();
-  _value = token->GetValue();
-  _line = token->GetLineNumber();
-  _char = token->GetCharPosition();
+  *this = *token;
 }
 
 const string CToken::Name(EToken type)
@@ -233,14 +445,125 @@ const string CToken::GetName(void) const
   return CToken::Name(GetType());
 }
 
+/// @brief check whether the value of tokens of type @a type is interned
+static bool HasInternedValue(EToken type)
+{
+  switch (type) {
+    case tIdent:
+    case tComment:
+    case tInvStringConst:
+    case tUndefined:
+      return true;
+    default:
+      return false;
+  }
+}
+
+string CToken::GetValue(void) const
+{
+  string buf;
+  size_t len;
+  const char *value = GetValue(&len, &buf);
+
+  if (value == buf.data()) return buf;
+  return string(value, len);
+}
+
+const char* CToken::GetValue(size_t *len, string *buf) const
+{
+  EToken type = GetType();
+
+  if (HasInternedValue(type)) {
+    CContext *ctx = CContext::Get();
+    assert(ctx != NULL);
+    const string &value = ctx->GetInterner()->GetString(_payload.id);
+    *len = value.size();
+    return value.data();
+  }
+
+  const char *value;
+
+  switch (type) {
+    case tPlusMinus:
+    case tMulDiv:
+    case tRelOp:
+      value = ESubkindText[_subkind];
+      break;
+
+    case tCharConst:
+    case tStringConst: {
+      const char *raw = GetRawValue(len);
+      if (_subkind != skEscaped) return raw;
+      *buf = escape(type, unescape(string(raw, *len)));
+      *len = buf->size();
+      return buf->data();
+    }
+
+    case tNumber: {
+      // numbers are recovered from the input: digits, optionally followed by 'L'
+      CContext *ctx = CContext::Get();
+      assert(ctx != NULL);
+      const char *start = ctx->GetSource()->GetData() + _offset;
+      const char *end = ctx->GetSource()->GetData() + ctx->GetSource()->GetSize();
+      const char *p = start;
+      while ((p < end) && ('0' <= *p) && (*p <= '9')) p++;
+      if ((p < end) && (*p == 'L')) p++;
+      *len = p - start;
+      return start;
+    }
+
+    default:
+      value = ETokenText[type];
+      break;
+  }
+
+  *len = strlen(value);
+  return value;
+}
+
+string CToken::GetUnescapedValue(void) const
+{
+  size_t len;
+  const char *raw = GetRawValue(&len);
+
+  if (_subkind != skEscaped) return string(raw, len);
+  return unescape(string(raw, len));
+}
+
+const char* CToken::GetRawValue(size_t *len) const
+{
+  assert((GetType() == tCharConst) || (GetType() == tStringConst));
+
+  CContext *ctx = CContext::Get();
+  assert(ctx != NULL);
+
+  // skip the opening quote
+  *len = _payload.length;
+  return ctx->GetSource()->GetData() + _offset + 1;
+}
+
+int CToken::GetLineNumber(void) const
+{
+  int line = 0, col = 0;
+  if (_offset != NO_OFFSET) CContext::Get()->GetPosition(_offset, &line, &col);
+  return line;
+}
+
+int CToken::GetCharPosition(void) const
+{
+  int line = 0, col = 0;
+  if (_offset != NO_OFFSET) CContext::Get()->GetPosition(_offset, &line, &col);
+  return col;
+}
+
 ostream& CToken::print(ostream &out) const
 {
-  #define MAX_STRLEN 128
-  int str_len = _value.length();
+  string value = GetValue();
+  int str_len = value.length();
   str_len = TOKEN_STRLEN + (str_len < MAX_STRLEN ? str_len : MAX_STRLEN);
   char *str = (char*)malloc(str_len);
-  snprintf(str, str_len, ETokenStr[GetType()], _value.c_str());
-  out << dec << _line << ":" << _char << ": " << str;
+  snprintf(str, str_len, ETokenStr[GetType()], value.c_str());
+  out << dec << GetLineNumber() << ":" << GetCharPosition() << ": " << str;
   free(str);
   return out;
 }
@@ -252,6 +575,12 @@ string CToken::escape(EToken type, const string text)
   const char *t = text.c_str();
   string s;
 
+  // fast path: nothing to escape
+  if (type == tStringConst) {
+    const char *p = SkipStringBlock(text.data(), text.data() + text.size());
+    if (p == text.data() + text.size()) return text;
+  }
+
   while ((type == tCharConst) || (*t != '\0')) {
     char c = *t;
 
@@ -290,6 +619,9 @@ string CToken::unescape(const string text)
   char c;
   string s;
 
+  // fast path: no escape sequences present
+  if (memchr(text.data(), '\\', text.size()) == NULL) return text;
+
   while (*t != '\0') {
     if (*t == '\\') {
       switch (*++t) {
@@ -330,289 +662,717 @@ ostream& operator<<(ostream &out, const CToken *t)
   return t->print(out);
 }
 
+bool operator == (const CToken& t1, const CToken& t2)
+{
+  if (t1.GetType() != t2.GetType()) return false;
+
+  // interned values are equal iff their ids are equal
+  if (HasInternedValue(t1.GetType())) return t1.GetId() == t2.GetId();
+
+  return t1.GetValue() == t2.GetValue();
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CTokenWriter
+//
+CTokenWriter::CTokenWriter(ostream *out, size_t size)
+{
+  assert((out != NULL) && (size > 0));
+  _out = out;
+  _size = size;
+  _buf = new char[_size];
+  _len = 0;
+  _ctx = NULL;
+  _pos = 0;
+  _line = 1;
+  _line_start = 0;
+}
+
+CTokenWriter::~CTokenWriter(void)
+{
+  Flush();
+  delete [] _buf;
+}
+
+void CTokenWriter::Write(const CToken &t, unsigned int indent)
+{
+  // same output as CToken::print(): the value is inserted into the format string of the token
+  // type and, like snprintf, stops at the first NUL character. The formatted token is limited to
+  // TOKEN_STRLEN-1 plus the length of the value (at most MAX_STRLEN) characters
+  string buf;
+  size_t len;
+  const char *value = t.GetValue(&len, &buf);
+  const char *fmt = ETokenStr[t.GetType()];
+  size_t limit = TOKEN_STRLEN - 1 + (len < MAX_STRLEN ? len : MAX_STRLEN);
+
+  const char *arg = strstr(fmt, "%s");
+  size_t prefix = (arg != NULL) ? arg - fmt : strlen(fmt);
+  const char *nul = (const char*)memchr(value, '\0', len);
+  if (nul != NULL) len = nul - value;
+
+  int line = 0, col = 0;
+  if (t.GetOffset() != CToken::NO_OFFSET) GetPosition(t.GetOffset(), &line, &col);
+
+  Reserve(indent + 24 + TOKEN_STRLEN + len);
+  memset(_buf + _len, ' ', indent);
+  _len += indent;
+  PutNumber(line);
+  _buf[_len++] = ':';
+  PutNumber(col);
+  _buf[_len++] = ':';
+  _buf[_len++] = ' ';
+
+  size_t n = min(prefix, limit);
+  Put(fmt, n);
+  limit -= n;
+  if (arg != NULL) {
+    n = min(len, limit);
+    Put(value, n);
+    limit -= n;
+    Put(arg + 2, min(strlen(arg + 2), limit));
+  }
+
+  _buf[_len++] = '\n';
+}
+
+void CTokenWriter::Flush(void)
+{
+  if (_len > 0) _out->write(_buf, _len);
+  _len = 0;
+  _out->flush();
+}
+
+void CTokenWriter::Reserve(size_t n)
+{
+  if (_len + n <= _size) return;
+
+  if (_len > 0) _out->write(_buf, _len);
+  _len = 0;
+
+  if (n > _size) {
+    delete [] _buf;
+    _size = n;
+    _buf = new char[_size];
+  }
+}
+
+void CTokenWriter::Put(const char *str, size_t n)
+{
+  memcpy(_buf + _len, str, n);
+  _len += n;
+}
+
+void CTokenWriter::PutNumber(unsigned int v)
+{
+  char digits[16];
+  int n = 0;
+
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v > 0);
+
+  while (n > 0) _buf[_len++] = digits[--n];
+}
+
+void CTokenWriter::GetPosition(unsigned int offset, int *line, int *col)
+{
+  CContext *ctx = CContext::Get();
+  assert(ctx != NULL);
+  const char *data = ctx->GetSource()->GetData();
+  unsigned int size = (unsigned int)ctx->GetSource()->GetSize();
+
+  if ((ctx != _ctx) || (offset < _pos)) {
+    // offsets went backwards: start over from the table of line starts of the context
+    ctx->GetPosition(offset, line, col);
+    _ctx = ctx;
+    _pos = min(offset, size);
+    _line = *line;
+    _line_start = offset - *col + 1;
+    return;
+  }
+
+  // count the line breaks between the previous and the current offset
+  unsigned int end = min(offset, size);
+  const char *p = data + _pos;
+  while ((p = (const char*)memchr(p, '\n', end - (p - data))) != NULL) {
+    p++;
+    _line++;
+    _line_start = (unsigned int)(p - data);
+  }
+  _pos = end;
+
+  *line = _line;
+  *col = (int)(offset - _line_start) + 1;
+}
+
 
 //--------------------------------------------------------------------------------------------------
 // CScanner
 //
-map<string, EToken> CScanner::keywords;
+CScanner::CScanner(CSource *src, bool delete_src)
+{
+  assert(src != NULL);
+  _ctx = new CContext(src, delete_src);
+  _ctx->Attach();
+  _src = src;
+  _cur = _src->GetData();
+  _end = _cur + _src->GetSize();
+  _eof = false;
+  _over = 0;
+  _head = _count = 0;
+  _tokenized = false;
+  _toks = NULL;
+  _ntoks = _next = 0;
+  _delete_ctx = true;
+  _tfile = NULL;
+  _delete_tfile = false;
+  _good = _src->Good();
+  NextToken();
+}
 
 CScanner::CScanner(istream *in)
+  : CScanner(new CStreamSource(in))
 {
-  InitKeywords();
-  _in = in;
-  _delete_in = false;
-  _line = _char = 1;
-  _token = NULL;
-  _good = in->good();
-  NextToken();
 }
 
 CScanner::CScanner(string in)
+  : CScanner(new CMemorySource(in))
+{
+}
+
+CScanner::CScanner(CTokenFile *tfile, bool delete_tfile)
 {
-  InitKeywords();
-  _in = new istringstream(in);
-  _delete_in = true;
-  _line = _char = 1;
-  _token = NULL;
+  assert(tfile != NULL);
+  _ctx = tfile->GetContext();
+  _ctx->Attach();
+  _src = _ctx->GetSource();
+  _cur = _end = _src->GetData() + _src->GetSize();
+  _eof = true;
+  _over = 0;
+  _head = _count = 0;
+  _tokenized = true;
+  _toks = tfile->GetTokens();
+  _ntoks = tfile->GetNumTokens();
+  _next = 0;
+  // the context of a token file belongs to the token file
+  _delete_ctx = false;
+  _tfile = tfile;
+  _delete_tfile = delete_tfile;
+  _good = true;
+}
+
+CScanner::CScanner(CContext *ctx, const CToken *tokens, size_t ntokens, size_t start)
+{
+  assert((ctx != NULL) && (tokens != NULL) && (start < ntokens));
+  _ctx = ctx;
+  _ctx->Attach();
+  _src = _ctx->GetSource();
+  _cur = _end = _src->GetData() + _src->GetSize();
+  _eof = true;
+  _over = 0;
+  _head = _count = 0;
+  _tokenized = true;
+  _toks = tokens;
+  _ntoks = ntokens;
+  _next = start;
+  _delete_ctx = false;
+  _tfile = NULL;
+  _delete_tfile = false;
   _good = true;
-  NextToken();
 }
 
 CScanner::~CScanner()
 {
-  if (_token != NULL) delete _token;
-  if (_delete_in) delete _in;
+  _ctx->Detach();
+
+  if (_delete_ctx) delete _ctx;
+  if (_delete_tfile) delete _tfile;
 }
 
-void CScanner::InitKeywords(void)
+int CScanner::GetLineNumber(void) const
 {
-  if (keywords.size() == 0) {
-    int size = sizeof(Keywords) / sizeof(Keywords[0]);
-    for (int i=0; i<size; i++) {
-      keywords[Keywords[i].first] = Keywords[i].second;
-    }
-  }
+  int line, col;
+  _ctx->GetPosition(GetOffset(), &line, &col);
+  return line;
+}
+
+int CScanner::GetCharPosition(void) const
+{
+  int line, col;
+  _ctx->GetPosition(GetOffset(), &line, &col);
+  return col;
 }
 
 CToken CScanner::Get()
 {
-  CToken result(_token);
+  if (_tokenized) {
+    CToken result = _toks[_next];
+    // the terminating tEOF is returned repeatedly, as in sequential mode
+    if (_next + 1 < _ntoks) _next++;
+    return result;
+  }
+
+  CToken result = _tokens[_head];
 
-  EToken type = _token->GetType();
+  _head = (_head + 1) % LOOKAHEAD;
+  _count--;
+
+  EToken type = result.GetType();
   _good = !(type == tIOError);
 
-  NextToken();
+  // keep at least one token buffered; further tokens are scanned on demand by Peek()
+  if (_count == 0) NextToken();
   return result;
 }
 
-CToken CScanner::Peek() const
+const CToken& CScanner::Peek(unsigned int k)
 {
-  return CToken(_token);
+  assert(k < LOOKAHEAD);
+
+  if (_tokenized) return _toks[min(_next + k, _ntoks - 1)];
+
+  while (_count <= k) NextToken();
+
+  return _tokens[(_head + k) % LOOKAHEAD];
+}
+
+void CScanner::SetTokenIndex(size_t index)
+{
+  assert(_tokenized && (index < _ntoks));
+  _next = index;
 }
 
 void CScanner::NextToken()
 {
-  if (_token != NULL) delete _token;
+  assert(_count < LOOKAHEAD);
 
-  _token = Scan();
+  _tokens[(_head + _count) % LOOKAHEAD] = Scan();
+  _count++;
+}
+
+bool CScanner::Tokenize(unsigned int nthreads)
+{
+  if (_tokenized) return true;
+
+  // make the entire input available
+  size_t pos = _cur - _src->GetData();
+  _src->Load();
+  if (!_src->Good() || !_src->IsComplete() || (_src->GetSize() >= CToken::NO_OFFSET)) {
+    _cur = _src->GetData() + pos;
+    _end = _src->GetData() + _src->GetSize();
+    return false;
+  }
+
+  // tokens that have already been scanned come first
+  _array.clear();
+  while (_count > 0) {
+    _array.push_back(_tokens[_head]);
+    _head = (_head + 1) % LOOKAHEAD;
+    _count--;
+  }
+  _tokenized = true;
+  _next = 0;
+
+  if (_eof) {
+    // nothing left to scan; sequential mode would return tEOF from now on. The lookahead may
+    // already hold it (empty input, or input consisting of white space and comments only)
+    if (_array.empty() || (_array.back().GetType() != tEOF)) {
+      RecordStreamPosition();
+      _array.push_back(NewToken(tEOF));
+    }
+    _toks = _array.data();
+    _ntoks = _array.size();
+    return true;
+  }
+
+  // split the remaining input into line-aligned chunks. The first chunk continues where the
+  // sequential scanner stopped, i.e., at a token boundary
+  const char *data = _src->GetData();
+  size_t size = _src->GetSize();
+  if (nthreads < 1) nthreads = 1;
+
+  vector<size_t> bounds(1, pos);
+  for (unsigned int i=1; i<nthreads; i++) {
+    size_t target = pos + (size - pos) / nthreads * i;
+    if (target < bounds.back()) continue;
+    const char *nl = (const char*)memchr(data + target, '\n', size - target);
+    if (nl == NULL) break;
+    bounds.push_back(nl + 1 - data);
+  }
+  bounds.push_back(size);
+
+  size_t nchunks = bounds.size() - 1;
+  vector<vector<CToken>> tokens(nchunks);
+  vector<vector<string>> strings(nchunks);
+  vector<thread> workers;
+
+  // the first chunk is appended to the tokens scanned so far
+  size_t nscanned = _array.size();
+  tokens[0].swap(_array);
+
+  for (size_t i=1; i<nchunks; i++) {
+    workers.push_back(thread(ScanChunk, data + bounds[i], bounds[i+1] - bounds[i],
+                             (unsigned int)bounds[i], i == nchunks-1, &tokens[i], &strings[i]));
+  }
+  ScanChunk(data + bounds[0], bounds[1] - bounds[0], (unsigned int)bounds[0], nchunks == 1,
+            &tokens[0], &strings[0]);
+  for (size_t i=0; i<workers.size(); i++) workers[i].join();
+
+  // concatenate the chunks. Re-interning the strings of each chunk in order yields the same ids
+  // as the sequential scanner since ids are assigned in order of first occurrence
+  CInterner *interner = _ctx->GetInterner();
+  size_t ntokens = 0;
+  for (size_t i=0; i<nchunks; i++) ntokens += tokens[i].size();
+
+  for (size_t i=0; i<nchunks; i++) {
+    vector<unsigned int> ids(strings[i].size());
+    for (size_t j=0; j<strings[i].size(); j++) ids[j] = interner->Intern(strings[i][j]);
+
+    for (size_t j=(i == 0 ? nscanned : 0); j<tokens[i].size(); j++) {
+      CToken &t = tokens[i][j];
+      if (HasInternedValue(t.GetType())) t._payload.id = ids[t._payload.id];
+    }
+
+    if (i == 0) {
+      _array.swap(tokens[0]);
+      _array.reserve(ntokens);
+    } else {
+      _array.insert(_array.end(), tokens[i].begin(), tokens[i].end());
+      vector<CToken>().swap(tokens[i]);
+    }
+  }
+
+  // the sequential scanner is now positioned at the end of the input
+  _cur = _end = _src->GetData() + _src->GetSize();
+  _eof = true;
+  _toks = _array.data();
+  _ntoks = _array.size();
+
+  return true;
+}
+
+bool CScanner::Relex(size_t offset, size_t len, const string &text)
+{
+  if (!_tokenized) return false;
+
+  // other scanners would continue to read the replaced source
+  assert(_ctx->GetNumScanners() == 1);
+  assert((_ntoks > 0) && (_toks[_ntoks-1].GetType() == tEOF));
+
+  _ctx->Detach();
+  _ctx->Replace(offset, len, text);
+  _ctx->Attach();
+
+  const char *data = _ctx->GetSource()->GetData();
+  size_t size = _ctx->GetSource()->GetSize();
+  long delta = (long)text.size() - (long)len;
+
+  // re-scan from the start of the first affected line to the first line start after the
+  // replacement text. Tokens never extend beyond the end of their line, hence the tokens before
+  // and after that range are not affected by the edit
+  size_t start = offset;
+  while ((start > 0) && (data[start-1] != '\n')) start--;
+
+  size_t end = offset + text.size();
+  const char *nl = (const char*)memchr(data + end, '\n', size - end);
+  end = (nl != NULL) ? nl + 1 - data : size;
+  bool last = end == size;
+
+  vector<CToken> chunk;
+  vector<string> strings;
+  ScanChunk(data + start, end - start, (unsigned int)start, last, &chunk, &strings);
+
+  vector<unsigned int> ids(strings.size());
+  for (size_t j=0; j<strings.size(); j++) ids[j] = _ctx->GetInterner()->Intern(strings[j]);
+
+  // splice: unaffected prefix, re-scanned range, shifted suffix
+  vector<CToken> result;
+  size_t i = 0;
+  while ((i < _ntoks) && (_toks[i].GetOffset() < start)) i++;
+  result.reserve(_ntoks + chunk.size());
+  result.insert(result.end(), _toks, _toks + i);
+
+  for (size_t j=0; j<chunk.size(); j++) {
+    CToken &t = chunk[j];
+    if (HasInternedValue(t.GetType())) t._payload.id = ids[t._payload.id];
+    result.push_back(t);
+  }
+
+  if (!last) {
+    while ((i < _ntoks) && (_toks[i].GetOffset() < end - delta)) i++;
+    for (; i<_ntoks; i++) {
+      CToken t = _toks[i];
+      t._offset += delta;
+      result.push_back(t);
+    }
+  }
+
+  // continue on the edited input from its first token
+  _array.swap(result);
+  _src = _ctx->GetSource();
+  _cur = _end = _src->GetData() + _src->GetSize();
+  _toks = _array.data();
+  _ntoks = _array.size();
+  _next = 0;
+
+  return true;
+}
+
+void CScanner::ScanChunk(const char *data, size_t size, unsigned int base, bool last,
+                         vector<CToken> *tokens, vector<string> *strings)
+{
+  CScanner s(new CBufferSource(data, size));
+
+  // rough estimate of the number of tokens to avoid repeated reallocation
+  tokens->reserve(tokens->size() + size / 8);
+
+  for (;;) {
+    CToken t = s.Get();
+    if ((t.GetType() == tEOF) && !last) break;
+
+    t._offset += base;
+    tokens->push_back(t);
+
+    if (t.GetType() == tEOF) break;
+  }
+
+  CInterner *interner = s.GetContext()->GetInterner();
+  for (unsigned int id=0; id<interner->GetSize(); id++) {
+    strings->push_back(interner->GetString(id));
+  }
 }
 
 void CScanner::RecordStreamPosition(void)
 {
-  _saved_line = _line;
-  _saved_char = _char;
+  _saved_pos = GetOffset();
 }
 
 void CScanner::GetRecordedStreamPosition(int *lineno, int *charpos)
 {
-  *lineno = _saved_line;
-  *charpos = _saved_char;
+  _ctx->GetPosition(_saved_pos, lineno, charpos);
+}
+
+CToken CScanner::NewToken(EToken type, ESubkind subkind)
+{
+  return CToken(type, _saved_pos, subkind);
 }
 
-CToken* CScanner::NewToken(EToken type, const string token)
+CToken CScanner::NewToken(EToken type, const string &token)
 {
-  return new CToken(_saved_line, _saved_char, type, token);
+  return CToken(type, _saved_pos, skNone, _ctx->GetInterner()->Intern(token));
 }
 
-CToken* CScanner::Scan()
+CToken CScanner::Scan()
 {
-  EToken token;
-  ECharacter cres;
   string tokval;
-  bool commenting;
   unsigned char c;
-  
-  do {
-      commenting = false; // by default, not commenting
-      while (_in->good() && IsWhite(PeekChar())) GetChar();
+
+  // comments are skipped like white space; we return here after a comment
+  for (;;) {
+      SkipWhite();
 
       RecordStreamPosition();
 
-      if (_in->eof()) return NewToken(tEOF);
-      if (!_in->good()) return NewToken(tIOError);
+      if (_eof) return NewToken(tEOF);
+      if (!InputGood()) return NewToken(tIOError);
 
       c = GetChar();
-      tokval = c;
-      token = tUndefined;
 
       switch (c) {
       case ':':
           if (PeekChar() == '=') {
-              tokval += GetChar();
-              token = tAssign;
+              GetChar();
+              return NewToken(tAssign);
           }
-          else token = tColon;
-          break;
+          return NewToken(tColon);
 
       case '+':
+          return NewToken(tPlusMinus, skPlus);
+
       case '-':
-          token = tPlusMinus;
-          break;
+          return NewToken(tPlusMinus, skMinus);
 
       case '*':
-          token = tMulDiv;
-          break;
+          return NewToken(tMulDiv, skMul);
 
       case '/':
-          // comment
+          // comment: skip the remainder of the line
           if (PeekChar() == '/') {
-              while (_in->good() && !_in->eof() && PeekChar() != '\n') {
-                  tokval += GetChar();
-
-              }
-              commenting = true;
-              token = tComment;
+              SkipLine();
+              continue;
           }
-          else token = tMulDiv;
-          break;
+          return NewToken(tMulDiv, skDiv);
+
+      case '\'': {
+          // the token refers to the raw character in the input
+          unsigned int start = GetOffset();
+          bool escaped = (PeekChar() == '\\') || (PeekChar() >= 0x80);
 
-      case '\'':
           // Get the character and store it on c
           if (GetCharacter(c, tCharConst) == cOkay) {
               // Consume closing quote, if there is one (as there should be)
               if (PeekChar() == '\'') {
+                  CToken t = NewToken(tCharConst, escaped ? skEscaped : skNone);
+                  t._payload.length = GetOffset() - start;
                   GetChar();
-                  token = tCharConst;
-                  tokval = c;
+                  return t;
               }
               // single quotes not closed properly
               else {
-                  return NewToken(tUndefined, "tCharConst without proper closing quote (" + tokval + ")");
+                  return NewToken(tUndefined, "tCharConst without proper closing quote (')");
               }
           }
           else return NewToken(tUndefined, "Invalid character followed by single quote");
+      }
 
-          break;
-
-
-      case '"':
+      case '"': {
+          if (_eof) return NewToken(tEOF);
+          if (!InputGood()) return NewToken(tIOError);
 
-          // Token value is empty string at first
-          tokval = "";
-          if (_in->eof()) return NewToken(tEOF);
-          if (!_in->good()) return NewToken(tIOError);
+          // the token refers to the raw string in the input; we only validate it here
+          unsigned int start = GetOffset();
+          bool escaped = false;
 
           // repeat until endline or closing quote appears. (It should end with a closing quote)
           while (PeekChar() != '\n' && PeekChar() != '"') {
-              if (_in->eof()) return NewToken(tEOF);
-              if (!_in->good()) return NewToken(tIOError);
-              if (GetCharacter(c, tStringConst) == cOkay) {
-                  tokval += c;
+              if (_eof) return NewToken(tEOF);
+              if (!InputGood()) return NewToken(tIOError);
+
+              // skip characters that need no escape processing in bulk
+              const char *p = SkipStringBlock(_cur, _end);
+              if (p != _cur) {
+                  _cur = p;
+                  continue;
+              }
+
+              escaped = true;
+              if (GetCharacter(c, tStringConst) != cOkay) {
+                  return NewToken(tInvStringConst, "Invalid character in tStringConst");
               }
-              else return NewToken(tInvStringConst, "Invalid character in tStringConst");
           }
           if (PeekChar() == '\n') {
-              return NewToken(tInvStringConst, "tStringConst without proper closing quote (" + tokval + ")");
-          }
-          //consume closing quote
-          if (PeekChar() == '"') {
-              GetChar();
-              token = tStringConst;
+              tokval.assign(_src->GetData() + start, GetOffset() - start);
+              return NewToken(tInvStringConst, "tStringConst without proper closing quote (" +
+                                               CToken::unescape(tokval) + ")");
           }
 
-          break;
+          CToken t = NewToken(tStringConst, escaped ? skEscaped : skNone);
+          t._payload.length = GetOffset() - start;
+          //consume closing quote
+          GetChar();
+          return t;
+      }
 
           // & and | must be followed by another & and |, otherwise it is not a valid token
       case '&':
           if (PeekChar() == '&') {
-              tokval += GetChar();
-              token = tLogicAND;
+              GetChar();
+              return NewToken(tLogicAND);
           }
-          else return NewToken(tUndefined, "& not followed by another &");
-          break;
+          return NewToken(tUndefined, "& not followed by another &");
 
       case '|':
           if (PeekChar() == '|') {
-              tokval += GetChar();
-              token = tLogicOR;
+              GetChar();
+              return NewToken(tLogicOR);
           }
-          else return NewToken(tUndefined, "| not followed by another |");
-          break;
+          return NewToken(tUndefined, "| not followed by another |");
 
       // simple operators
       case '=':
+          return NewToken(tRelOp, skEqual);
+
       case '#':
-          token = tRelOp;
-          break;
+          return NewToken(tRelOp, skNotEqual);
 
       case '<':
+          if (PeekChar() == '=') {
+              GetChar();
+              return NewToken(tRelOp, skLessEqual);
+          }
+          return NewToken(tRelOp, skLessThan);
+
       case '>':
-          if (PeekChar() == '=') tokval += GetChar();
-          token = tRelOp;
-          break;
+          if (PeekChar() == '=') {
+              GetChar();
+              return NewToken(tRelOp, skBiggerEqual);
+          }
+          return NewToken(tRelOp, skBiggerThan);
 
       case ';':
-          token = tSemicolon;
-          break;
+          return NewToken(tSemicolon);
 
       case '.':
-          token = tDot;
-          break;
+          return NewToken(tDot);
 
       case ',':
-          token = tComma;
-          break;
+          return NewToken(tComma);
 
       case '!':
-          token = tLogicNOT;
-          break;
+          return NewToken(tLogicNOT);
 
       case '(':
-          token = tLBrak;
-          break;
+          return NewToken(tLBrak);
 
       case ')':
-          token = tRBrak;
-          break;
+          return NewToken(tRBrak);
 
       case '[':
-          token = tLBrakSQ;
-          break;
+          return NewToken(tLBrakSQ);
 
       case ']':
-          token = tRBrakSQ;
-          break;
+          return NewToken(tRBrakSQ);
 
 
-      // number, identifier or reserved keyword (identifier is distinguished from reserved keyword later)
+      // number, identifier or reserved keyword
       default:
           if (IsNum(c)) {
-              token = tNumber;
-              while (IsNum(PeekChar())) {
-                  c = GetChar();
-                  tokval += c;
+              // decode the value while the digits are in the input buffer
+              size_t start = _cur - 1 - _src->GetData();
+              SkipClass(ccNum);
+
+              const char *d = _src->GetData() + start, *e = _cur;
+              long long v = 0;
+              bool range = true;
+              while (d < e) {
+                  int digit = *d++ - '0';
+                  if (v > (LLONG_MAX - digit) / 10) { range = false; break; }
+                  v = v*10 + digit;
               }
+
               // longint has number followed by L 
+              ESubkind kind = skInteger;
               if (PeekChar() == 'L') {
-                  c = GetChar();
-                  tokval += c;
+                  GetChar();
+                  kind = skLongint;
               }
+              if (!range) { kind = skOutOfRange; v = LLONG_MAX; }
+
+              CToken t = NewToken(tNumber, kind);
+              t._payload.number = v;
+              return t;
           }
           else if (IsAlpha(c)) {
-              token = tIdent;
-              while (IsNum(PeekChar()) || IsAlpha(PeekChar())) {
-                  c = GetChar();
-                  tokval += c;
-              }
+              // resolve keywords directly in the input buffer
+              size_t start = _cur - 1 - _src->GetData();
+              SkipClass(ccID);
+              const char *id = _src->GetData() + start;
+              EToken token = FindKeyword(id, _cur - id);
+
+              if (token != tIdent) return NewToken(token);
+              return CToken(tIdent, _saved_pos, skNone, _ctx->GetInterner()->Intern(id, _cur - id));
           }
           // Characters that are neither a valid operator nor an alphanumeric, such as ^, should not appear
           else {
               tokval = "invalid character (";
               tokval += c;
               tokval += ")";
+              return NewToken(tUndefined, tokval);
           }
-          break;
-      }
-  } while (commenting); // Comments should not be printed out as a token. After taking out everything after "//" in that line, return to the part ignoring whitespaces.
-  
-  //look for reserved keywords
-  if (token == tIdent) {
-      map<string, EToken>::iterator it = keywords.find(tokval);
-      if (it != keywords.end()) {
-          token = it->second;
       }
   }
-  return NewToken(token, tokval);
 }
 
 CScanner::ECharacter CScanner::GetCharacter(unsigned char &c, EToken mode)
@@ -637,7 +1397,7 @@ CScanner::ECharacter CScanner::GetCharacter(unsigned char &c, EToken mode)
 
   if (c == '\\') {
     // escaped character
-    if (_in->eof() || !_in->good()) return cUnexpEnd;
+    if (_eof || !InputGood()) return cUnexpEnd;
     c = GetChar();
 
     switch (PeekChar()) {
@@ -652,7 +1412,7 @@ CScanner::ECharacter CScanner::GetCharacter(unsigned char &c, EToken mode)
 
       case 'x':  // \xHH encoding: read exactly two hexadecimal digits
                  for (i=v=0; i<2; i++) {
-                   if (_in->eof() || !_in->good()) return cUnexpEnd;
+                   if (_eof || !InputGood()) return cUnexpEnd;
                    GetChar();
                    if ((t = CToken::digitValue(PeekChar())) == -1) break;
                    v = (v << 4) + t;
@@ -674,22 +1434,48 @@ CScanner::ECharacter CScanner::GetCharacter(unsigned char &c, EToken mode)
   if (res != cOkay) RecordStreamPosition();
 
   // consume character (we only peeked at it so far)
-  if (_in->eof() || !_in->good()) return cUnexpEnd;
+  if (_eof || !InputGood()) return cUnexpEnd;
   GetChar();
 
   return res;
 }
 
+bool CScanner::Fill(void)
+{
+  // the source may move its buffer when refilled; rebase the read pointer
+  size_t pos = _cur - _src->GetData();
+
+  bool more = _src->Refill();
+
+  _cur = _src->GetData() + pos;
+  _end = _src->GetData() + _src->GetSize();
+  return more && (_cur < _end);
+}
+
 unsigned char CScanner::PeekChar()
 {
-  return (unsigned char)_in->peek();
+  if ((_cur == _end) && !Fill()) {
+    // mimic istream::peek(): EOF is only signalled for sources in a good state
+    if (_src->Good()) _eof = true;
+    return 0xff;
+  }
+
+  return *_cur;
 }
 
 unsigned char CScanner::GetChar()
 {
-  unsigned char c = _in->get();
-  if (c == '\n') { _line++; _char = 1; } else _char++;
-  //cout << "[" << _line << ":" << _char << " - " << c << "]";
+  unsigned char c;
+
+  if ((_cur == _end) && !Fill()) {
+    // consuming past the end of the input still advances the stream position
+    if (_src->Good()) _eof = true;
+    c = 0xff;
+    _over++;
+  } else {
+    c = *_cur++;
+  }
+
   return c;
 }
 
@@ -700,30 +1486,58 @@ string CScanner::GetChar(int n)
   return str;
 }
 
+void CScanner::SkipWhite(void)
+{
+  while (InputGood()) {
+    _cur = SkipWhiteBlock(_cur, _end);
+
+    if (_cur < _end) break;
+    if (!Fill()) { PeekChar(); break; }
+  }
+}
+
+void CScanner::SkipLine(void)
+{
+  while (InputGood()) {
+    _cur = SkipLineBlock(_cur, _end);
+
+    if (_cur < _end) break;
+    // at the end of the input, the (non-existent) next character is consumed as well
+    if (!Fill()) { GetChar(); break; }
+  }
+}
+
+void CScanner::SkipClass(unsigned int cls)
+{
+  for (;;) {
+    while ((_cur < _end) && (CharClass[(unsigned char)*_cur] & cls)) _cur++;
+
+    if (_cur < _end) break;
+    if (!Fill()) { PeekChar(); break; }
+  }
+}
+
 bool CScanner::IsWhite(unsigned char c)
 {
-  return ((c == ' ') || (c == '\t') || (c == '\n'));
+  return (CharClass[c] & ccWhite) != 0;
 }
 
 bool CScanner::IsAlpha(unsigned char c)
 {
-  return ((('a' <= c) && (c <= 'z')) || (('A' <= c) && (c <= 'Z')) || (c == '_'));
+  return (CharClass[c] & ccAlpha) != 0;
 }
 
 bool CScanner::IsNum(unsigned char c)
 {
-  return (('0' <= c) && (c <= '9'));
+  return (CharClass[c] & ccNum) != 0;
 }
 
 bool CScanner::IsHexDigit(unsigned char c)
 {
-  return (('0' <= c) && (c <= '9')) ||
-         (('a' <= c) && (c <= 'f')) ||
-         (('A' <= c) && (c <= 'F'));
+  return (CharClass[c] & ccHex) != 0;
 }
 
 bool CScanner::IsIDChar(unsigned char c)
 {
-  return (IsAlpha(c) || IsNum(c));
+  return (CharClass[c] & ccID) != 0;
 }
-
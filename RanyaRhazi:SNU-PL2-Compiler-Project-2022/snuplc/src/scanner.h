@@ -42,9 +42,13 @@
 #include <ostream>
 #include <iomanip>
 #include <map>
+#include <vector>
 
+#include "context.h"
 using namespace std;
 
+class CTokenFile;
+
 //--------------------------------------------------------------------------------------------------
 /// @brief SnuPL token type
 ///
@@ -106,17 +110,53 @@ enum EToken {
 };
 
 
+//--------------------------------------------------------------------------------------------------
+/// @brief token subkind
+///
+/// Distinguishes the operators represented by the same token type and the kinds of numbers.
+///
+enum ESubkind {
+  skNone=0,                         ///< no subkind
+
+  skPlus,                           ///< tPlusMinus: '+'
+  skMinus,                          ///< tPlusMinus: '-'
+  skMul,                            ///< tMulDiv: '*'
+  skDiv,                            ///< tMulDiv: '/'
+  skEqual,                          ///< tRelOp: '='
+  skNotEqual,                       ///< tRelOp: '#'
+  skLessThan,                       ///< tRelOp: '<'
+  skLessEqual,                      ///< tRelOp: '<='
+  skBiggerThan,                     ///< tRelOp: '>'
+  skBiggerEqual,                    ///< tRelOp: '>='
+
+  skInteger,                        ///< tNumber: integer constant
+  skLongint,                        ///< tNumber: longint constant (suffix 'L')
+  skOutOfRange,                     ///< tNumber: value does not fit into 64 bits
+
+  skEscaped,                        ///< tCharConst/tStringConst: contains escape sequences or
+                                    ///< characters that are escaped in the token value
+};
+
+
 //--------------------------------------------------------------------------------------------------
 /// @brief token class
 ///
 /// Represents a token. Each token has a type (EToken) and a value (the lexeme).
-/// Additional fields specify the exact position of the lexeme in the input
-/// stream (line/column); this is used for error reporting.
 ///
-/// Note that the token value is stored in escaped form for strings/characters.
+/// Tokens are compact (16 bytes) and trivially copyable: besides the type and an operator subkind
+/// they store the offset of the lexeme in the input and a payload. The payload of identifiers and
+/// error tokens is the id of the token value in the string interner; numbers carry their decoded
+/// value. String/character constants refer to their raw text (without quotes) in the input. The
+/// value and the line/column position are resolved through the active CContext, i.e., tokens are
+/// only meaningful while the context of the compilation that produced them is active (see
+/// CActiveContext).
+///
+/// Note that the token value is returned in escaped form for strings/characters. Escaping and
+/// unescaping happens on demand, and only if the raw text contains escape sequences (skEscaped).
 ///
 class CToken {
   friend class CScanner;
+  friend class CTokenFile;
   public:
     /// @name constructors
     /// @{
@@ -126,16 +166,11 @@ class CToken {
 
     /// @brief constructor taking initialization values
     ///
-    /// @param line line number in the input stream
-    /// @param charpos character position in the input stream
     /// @param type token type
-    /// @param value token value
-    CToken(int line, int charpos, EToken type, const string value="");
-
-    /// @brief copy contructor
-    ///
-    /// @param token token to copy
-    CToken(const CToken &token);
+    /// @param offset offset of the lexeme in the input
+    /// @param subkind token subkind
+    /// @param id id of the token value in the string interner
+    CToken(EToken type, unsigned int offset, ESubkind subkind=skNone, unsigned int id=0);
 
     /// @brief copy contructor
     ///
@@ -159,27 +194,72 @@ class CToken {
     /// @brief return the token type of this instance
     ///
     /// @retval token type
-    EToken GetType(void) const { return _type; };
+    EToken GetType(void) const { return (EToken)_type; };
+
+    /// @brief return the token subkind of this instance
+    ///
+    /// @retval token subkind
+    ESubkind GetSubkind(void) const { return (ESubkind)_subkind; };
 
     /// @brief return the token value of this instance
     ///
     /// @retval token value
-    string GetValue(void) const { return _value; };
+    string GetValue(void) const;
+
+    /// @brief return the token value of this instance without copying it, if possible
+    ///
+    /// The value is not zero-terminated. It refers to the input, the string interner or static
+    /// storage; only escaped string/character constants are computed into @a buf.
+    ///
+    /// @param len length of the value
+    /// @param buf storage for computed values
+    /// @retval pointer to the token value
+    const char* GetValue(size_t *len, string *buf) const;
+
+    /// @brief return the unescaped value of a string/character constant
+    ///
+    /// @retval unescaped value
+    string GetUnescapedValue(void) const;
+
+    /// @brief return the raw text of a string/character constant (without quotes)
+    ///
+    /// @param len length of the raw text
+    /// @retval pointer to the raw text in the input
+    const char* GetRawValue(size_t *len) const;
+
+    /// @brief return the id of the token value in the string interner
+    ///
+    /// Only valid for identifiers and error tokens.
+    ///
+    /// @retval id
+    unsigned int GetId(void) const { return _payload.id; };
+
+    /// @brief return the decoded value of a number token
+    ///
+    /// @retval value
+    long long GetNumber(void) const { return _payload.number; };
 
     /// @}
 
     /// @name stream attributes
     /// @{
 
+    /// @brief return the offset of the lexeme in the input
+    ///
+    /// @retval offset (NO_OFFSET for tokens that do not stem from the input)
+    unsigned int GetOffset(void) const { return _offset; };
+
     /// @brief return the line number
     ///
     /// @retval line number of the token in the input stream
-    int GetLineNumber(void) const { return _line; };
+    int GetLineNumber(void) const;
 
     /// @brief return the character position
     ///
     /// @retval character position of the token in the input stream
-    int GetCharPosition(void) const { return _char; };
+    int GetCharPosition(void) const;
+
+    const static unsigned int NO_OFFSET = 0xffffffff; ///< offset of tokens not in the input
 
     /// @}
 
@@ -214,12 +294,18 @@ class CToken {
     ostream&  print(ostream &out) const;
 
   private:
-    EToken _type;                   ///< token type
-    string _value;                  ///< token value
-    int    _line;                   ///< input stream position (line)
-    int    _char;                   ///< input stream position (character pos)
+    unsigned char _type;            ///< token type (EToken)
+    unsigned char _subkind;         ///< token subkind (ESubkind)
+    unsigned int  _offset;          ///< offset of the lexeme in the input
+    union {
+      unsigned int id;              ///< interned token value
+      unsigned int length;          ///< length of raw string/character constant
+      long long    number;          ///< value of a number
+    }             _payload;         ///< token payload
 };
 
+static_assert(sizeof(CToken) == 16, "unexpected size of CToken");
+
 /// @name CToken output operators
 /// @{
 
@@ -239,21 +325,85 @@ ostream& operator<<(ostream &out, const CToken *t);
 
 /// @}
 
-/// @brief CToken equality check
-bool operator == (const CToken& t1, const CToken& t2){
-  return (t1.GetType() == t2.GetType()) && (t1.GetValue() == t2.GetValue());
-}
+/// @brief CToken equality check (type and value)
+bool operator == (const CToken& t1, const CToken& t2);
+
+//--------------------------------------------------------------------------------------------------
+/// @brief buffered token dump writer
+///
+/// Writes tokens in the text format of CToken::print(), one token per line. The output is
+/// formatted directly into a large buffer that is written to the output stream in blocks, and
+/// line/column positions are tracked incrementally while the offsets of the tokens increase.
+///
+class CTokenWriter {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param out output stream
+    /// @param size size of the output buffer
+    CTokenWriter(ostream *out, size_t size=BUFFER_SIZE);
+
+    /// @brief destructor (flushes the output buffer)
+    ~CTokenWriter(void);
+
+    /// @}
+
+    /// @brief write a token followed by a newline
+    ///
+    /// @param t token
+    /// @param indent number of spaces to write before the token
+    void Write(const CToken &t, unsigned int indent=0);
+
+    /// @brief write the buffered output to the output stream
+    void Flush(void);
+
+    const static size_t BUFFER_SIZE = 1 << 16; ///< default size of the output buffer
+
+  private:
+    /// @brief make room for @a n more characters in the output buffer
+    void Reserve(size_t n);
+
+    /// @brief append characters to the output buffer
+    void Put(const char *str, size_t n);
+
+    /// @brief append a non-negative number to the output buffer
+    void PutNumber(unsigned int v);
+
+    /// @brief map a source offset to a line/column position
+    void GetPosition(unsigned int offset, int *line, int *col);
+
+    ostream *_out;                  ///< output stream
+    char   *_buf;                   ///< output buffer
+    size_t  _size;                  ///< size of the output buffer
+    size_t  _len;                   ///< number of buffered characters
+    CContext *_ctx;                 ///< context of the cached position
+    unsigned int _pos;              ///< source offset of the cached position
+    int     _line;                  ///< line containing _pos
+    unsigned int _line_start;       ///< offset of the start of _line
+};
 
 //--------------------------------------------------------------------------------------------------
 /// @brief scanner class
 ///
 /// Instantiated by CParser and called repeatedly to tokenize SnuPL code.
 ///
+/// The scanner does not activate its context (GetContext()). Values and positions of its tokens
+/// can only be resolved while the context is active, e.g., within the scope of a CActiveContext.
+///
 class CScanner {
   public:
     /// @name construction/destruction
     /// @{
 
+    /// @brief constructor
+    ///
+    /// @param src input source containing the source code
+    /// @param delete_src delete @a src upon destruction
+    CScanner(CSource *src, bool delete_src=true);
+
     /// @brief constructor
     ///
     /// @param in input stream containing the source code
@@ -264,6 +414,27 @@ class CScanner {
     /// @param in input stream containing the source code
     CScanner(string in);
 
+    /// @brief constructor
+    ///
+    /// Returns the tokens of a binary token file (tokenized mode); the context of the token file
+    /// becomes the context of the compilation.
+    ///
+    /// @param tfile token file
+    /// @param delete_tfile delete @a tfile upon destruction
+    CScanner(CTokenFile *tfile, bool delete_tfile=true);
+
+    /// @brief constructor
+    ///
+    /// Returns the tokens of a token array owned by someone else (tokenized mode), starting at
+    /// index @a start. Used to scan parts of an already tokenized input on worker threads; the
+    /// context and the token array must outlive the scanner.
+    ///
+    /// @param ctx context of the input
+    /// @param tokens token array (terminated by tEOF)
+    /// @param ntokens number of tokens in the array
+    /// @param start index of the first token returned
+    CScanner(CContext *ctx, const CToken *tokens, size_t ntokens, size_t start=0);
+
     /// @brief destructor
     ~CScanner();
 
@@ -274,10 +445,69 @@ class CScanner {
     /// @retval token token
     CToken Get(void);
 
-    /// @brief peek at the next token in the input stream (without removing it)
+    /// @brief peek at an upcoming token in the input stream (without removing it)
+    ///
+    /// The returned reference remains valid until the token is removed with Get().
     ///
+    /// @param k number of tokens to skip (0 = next token), must be less than LOOKAHEAD
     /// @retval token token
-    CToken Peek(void) const;
+    const CToken& Peek(unsigned int k=0);
+
+    const static unsigned int LOOKAHEAD = 4; ///< maximal number of buffered tokens
+
+    /// @name tokenized mode
+    /// @{
+
+    /// @brief tokenize the remaining input on worker threads
+    ///
+    /// Loads the entire input and splits it into up to @a nthreads chunks that start at line
+    /// boundaries. Strings, characters and comments cannot span lines, hence every line start is
+    /// a safe point to restart scanning. The chunks are scanned concurrently and the scanner then
+    /// returns tokens from the concatenated token array. Token values, ids and positions are
+    /// identical to those of the sequential scanner.
+    ///
+    /// @param nthreads number of worker threads
+    /// @retval true if the input has been tokenized
+    /// @retval false if the input could not be loaded (the scanner remains in sequential mode)
+    bool Tokenize(unsigned int nthreads);
+
+    /// @brief check whether the scanner is in tokenized mode
+    bool IsTokenized(void) const { return _tokenized; };
+
+    /// @brief re-lex an edited input (tokenized mode only)
+    ///
+    /// Applies an edit to the input (see CContext::Replace()) and derives the token array of the
+    /// edited input from the current one. Only the lines from the start of the first affected
+    /// line up to the first line start after the replacement text are scanned again; at that
+    /// point the token stream re-synchronizes and the remaining tokens are taken over with
+    /// shifted offsets. The scanner continues with the first token of the edited input.
+    ///
+    /// The scanner must be the only scanner reading the input of its context.
+    ///
+    /// @param offset start of the replaced byte range
+    /// @param len length of the replaced byte range
+    /// @param text replacement text
+    /// @retval true if the input has been edited
+    /// @retval false if the scanner is not in tokenized mode
+    bool Relex(size_t offset, size_t len, const string &text);
+
+    /// @brief return the token array (tokenized mode only)
+    ///
+    /// The array is terminated by a tEOF token.
+    ///
+    /// @param ntokens number of tokens in the array
+    /// @retval token array
+    const CToken* GetTokens(size_t *ntokens) const { *ntokens = _ntoks; return _toks; };
+
+    /// @brief return the index of the next token in the token array (tokenized mode only)
+    size_t GetTokenIndex(void) const { return _next; };
+
+    /// @brief continue with the token at a given index of the token array (tokenized mode only)
+    ///
+    /// @param index index of the next token returned by Get()
+    void SetTokenIndex(size_t index);
+
+    /// @}
 
     /// @brief check the status of the scanner
     ///
@@ -288,12 +518,17 @@ class CScanner {
     /// @brief get the line number of the next token in the input stream
     ///
     /// @retval line number
-    int GetLineNumber(void) const { return _line; };
+    int GetLineNumber(void) const;
 
     /// @brief get the character position of the next token in the input stream
     ///
     /// @retval character position
-    int GetCharPosition() const { return _char; };
+    int GetCharPosition() const;
+
+    /// @brief return the context of the compilation
+    ///
+    /// @retval context
+    CContext* GetContext(void) const { return _ctx; };
 
   private:
     /// @brief result type for the GetCharacter() method
@@ -304,12 +539,22 @@ class CScanner {
       cUnexpEnd,                    ///< unexpected end of string/character
     };
 
-    /// @brief initialize list of reserved keywords
-    void InitKeywords(void);
-
-    /// @brief scan the next token
+    /// @brief scan the next token and append it to the token buffer
     void NextToken(void);
 
+    /// @brief scan a line-aligned chunk of the input (tokenized mode, worker thread)
+    ///
+    /// Tokens are scanned with a private context; interned ids refer to the chunk's interner.
+    ///
+    /// @param data start of the chunk
+    /// @param size size of the chunk in bytes
+    /// @param base offset of the chunk in the input
+    /// @param last true if the chunk extends to the end of the input
+    /// @param tokens scanned tokens (output)
+    /// @param strings interned strings in order of their ids (output)
+    static void ScanChunk(const char *data, size_t size, unsigned int base, bool last,
+                          vector<CToken> *tokens, vector<string> *strings);
+
     /// @brief store the current position of the input stream internally
     void RecordStreamPosition(void);
 
@@ -322,9 +567,16 @@ class CScanner {
     /// @brief create and return a new token
     ///
     /// @param type token type
+    /// @param subkind token subkind
+    /// @retval CToken instance
+    CToken NewToken(EToken type, ESubkind subkind=skNone);
+
+    /// @brief create and return a new token with an interned value
+    ///
+    /// @param type token type
     /// @param token  token value
     /// @retval CToken instance
-    CToken* NewToken(EToken type, const string token="");
+    CToken NewToken(EToken type, const string &token);
 
 
     /// @name low-level scanner routines
@@ -333,7 +585,7 @@ class CScanner {
     /// @brief scan the input stream and return the next token
     ///
     /// @retval CToken instance
-    CToken* Scan(void);
+    CToken Scan(void);
 
     /// @brief parse an (possibly escaped) character
     ///
@@ -342,6 +594,23 @@ class CScanner {
     /// @retval ECharacter status of character parse
     ECharacter GetCharacter(unsigned char &c, EToken mode);
 
+    /// @brief make more input available
+    ///
+    /// @retval true if more input is available
+    /// @retval false at the end of the input or on error
+    bool Fill(void);
+
+    /// @brief check the status of the input
+    ///
+    /// @retval true if the end of the input has not been reached and no error occurred
+    /// @retval false otherwise
+    bool InputGood(void) const { return !_eof && _src->Good(); };
+
+    /// @brief return the current offset in the input
+    ///
+    /// @retval offset of the next character
+    unsigned int GetOffset(void) const { return (unsigned int)(_cur - _src->GetData()) + _over; };
+
     /// @brief peek at the next character in the input stream (w/o removing it)
     ///
     /// @retval next character in the input stream
@@ -358,6 +627,19 @@ class CScanner {
     /// @retval string containing the characters read
     string GetChar(int n);
 
+    /// @brief skip white space
+    void SkipWhite(void);
+
+    /// @brief skip the remainder of the current line (up to, but not including '\n')
+    void SkipLine(void);
+
+    /// @brief skip a run of characters of the given class(es)
+    ///
+    /// The skipped characters remain available in the input buffer.
+    ///
+    /// @param cls character class mask (see scanner.cpp)
+    void SkipClass(unsigned int cls);
+
     /// @brief check if a character is a white character
     ///
     /// @param c character
@@ -397,15 +679,25 @@ class CScanner {
 
 
   private:
-    static map<string, EToken> keywords;///< reserved keywords with corr. tokens
-    istream *_in;                   ///< input stream
-    bool    _delete_in;             ///< delete input stream upon destruction
+    CContext *_ctx;                 ///< compilation context
+    CSource *_src;                  ///< input source
+    const char *_cur;               ///< next character in the input buffer
+    const char *_end;               ///< end of the available input
+    bool    _eof;                   ///< end of input has been reached
     bool    _good;                  ///< scanner status flag
-    int     _line;                  ///< current stream position (line)
-    int     _char;                  ///< current stream position (character pos)
-    int     _saved_line;            ///< saved stream position (line)
-    int     _saved_char;            ///< saved stream position (character pos)
-    CToken *_token;                 ///< next token in input stream
+    unsigned int _over;             ///< characters consumed past the end of the input
+    unsigned int _saved_pos;        ///< saved stream position (offset)
+    CToken  _tokens[LOOKAHEAD];     ///< ring buffer of upcoming tokens
+    unsigned int _head;             ///< index of next token in _tokens
+    unsigned int _count;            ///< number of tokens in _tokens
+    bool    _tokenized;             ///< tokenized mode
+    vector<CToken> _array;          ///< storage of the token array (Tokenize(), Relex())
+    const CToken *_toks;            ///< token array (tokenized mode)
+    size_t  _ntoks;                 ///< number of tokens in _toks
+    size_t  _next;                  ///< index of next token in _toks
+    bool    _delete_ctx;            ///< delete context upon destruction
+    CTokenFile *_tfile;             ///< token file providing the token array (or NULL)
+    bool    _delete_tfile;          ///< delete token file upon destruction
 };
 
 
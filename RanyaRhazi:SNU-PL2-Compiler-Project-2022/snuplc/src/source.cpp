@@ -0,0 +1,188 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL scanner input sources
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "source.h"
+using namespace std;
+
+
+//--------------------------------------------------------------------------------------------------
+// CSource
+//
+CSource::CSource(void)
+  : _data(NULL), _size(0), _complete(false), _good(true)
+{
+}
+
+CSource::~CSource(void)
+{
+}
+
+CSource* CSource::Open(const string filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+
+  if (fd != -1) {
+    struct stat st;
+
+    if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode)) {
+      CMappedSource *s = new CMappedSource(fd, st.st_size);
+      close(fd);
+
+      if (s->Good()) return s;
+      delete s;
+    } else {
+      close(fd);
+    }
+  }
+
+  // not a regular file (or mmap failed): read through a stream. This also
+  // covers files that cannot be opened; the stream source reports the error.
+  return new CStreamSource(new ifstream(filename.c_str()), true);
+}
+
+bool CSource::Refill(void)
+{
+  return false;
+}
+
+void CSource::Load(void)
+{
+  while (!_complete && Refill());
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CMemorySource
+//
+CMemorySource::CMemorySource(string text)
+  : CSource(), _text(move(text))
+{
+  _data = _text.data();
+  _size = _text.size();
+  _complete = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CBufferSource
+//
+CBufferSource::CBufferSource(const char *data, size_t size)
+  : CSource()
+{
+  _data = data;
+  _size = size;
+  _complete = true;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CMappedSource
+//
+CMappedSource::CMappedSource(int fd, size_t size)
+  : CSource(), _map(NULL)
+{
+  // mmap() does not accept empty mappings; an empty file is simply an empty buffer
+  if (size > 0) {
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map == MAP_FAILED) {
+      _good = false;
+      return;
+    }
+
+    // the scanner reads sequentially
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    _map = map;
+    _data = (const char*)map;
+    _size = size;
+  }
+
+  _complete = true;
+}
+
+CMappedSource::~CMappedSource(void)
+{
+  if (_map != NULL) munmap(_map, _size);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CStreamSource
+//
+CStreamSource::CStreamSource(istream *in, bool delete_in)
+  : CSource(), _in(in), _delete_in(delete_in), _buf(NULL), _capacity(0)
+{
+  assert(in != NULL);
+  _good = in->good();
+}
+
+CStreamSource::~CStreamSource(void)
+{
+  free(_buf);
+  if (_delete_in) delete _in;
+}
+
+bool CStreamSource::Refill(void)
+{
+  if (_complete || !_good) return false;
+
+  // grow the buffer; data already read is kept since token positions refer to it
+  if (_capacity - _size < CHUNK_SIZE) {
+    size_t capacity = _capacity == 0 ? CHUNK_SIZE : 2*_capacity;
+    if (capacity - _size < CHUNK_SIZE) capacity = _size + CHUNK_SIZE;
+
+    char *buf = (char*)realloc(_buf, capacity);
+    if (buf == NULL) {
+      _good = false;
+      return false;
+    }
+
+    _buf = buf;
+    _data = _buf;
+    _capacity = capacity;
+  }
+
+  _in->read(_buf + _size, _capacity - _size);
+  size_t n = _in->gcount();
+  _size += n;
+
+  if (_in->eof()) _complete = true;
+  else if (!_in->good()) _good = false;
+
+  return n > 0;
+}
@@ -0,0 +1,182 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL scanner input sources
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __SnuPL_SOURCE_H__
+#define __SnuPL_SOURCE_H__
+
+#include <istream>
+#include <string>
+
+using namespace std;
+
+//--------------------------------------------------------------------------------------------------
+/// @brief scanner input source
+///
+/// Provides the scanner with a contiguous, raw character buffer. Data that has been made available
+/// once stays available (and keeps its offset) for the lifetime of the source; only the address
+/// of the buffer may change when a source is refilled.
+///
+class CSource {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief destructor
+    virtual ~CSource(void);
+
+    /// @brief open a file
+    ///
+    /// Regular files are memory-mapped, everything else (pipes, devices) is read through a
+    /// refillable buffer. Never returns NULL; check Good() for errors.
+    ///
+    /// @param filename name of the file
+    /// @retval CSource instance
+    static CSource* Open(const string filename);
+
+    /// @}
+
+    /// @name buffer access
+    /// @{
+
+    /// @brief return a pointer to the start of the available data
+    const char* GetData(void) const { return _data; };
+
+    /// @brief return the number of bytes available
+    size_t GetSize(void) const { return _size; };
+
+    /// @brief check whether the entire input is available
+    bool IsComplete(void) const { return _complete; };
+
+    /// @brief check whether the source is in an operating (i.e., normal) state
+    bool Good(void) const { return _good; };
+
+    /// @brief make more data available
+    ///
+    /// May move the buffer (i.e., invalidate the value of GetData()).
+    ///
+    /// @retval true if more data is available
+    /// @retval false at the end of the input or on error
+    virtual bool Refill(void);
+
+    /// @brief make the entire input available
+    void Load(void);
+
+    /// @}
+
+  protected:
+    /// @brief constructor
+    CSource(void);
+
+    const char *_data;              ///< buffer
+    size_t      _size;              ///< number of valid bytes in buffer
+    bool        _complete;          ///< entire input is available
+    bool        _good;              ///< source status flag
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief in-memory input source
+///
+/// holds a private copy of a string
+///
+class CMemorySource : public CSource {
+  public:
+    /// @brief constructor
+    ///
+    /// @param text source code
+    CMemorySource(string text);
+
+  private:
+    string      _text;              ///< source code
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief external buffer input source
+///
+/// refers to a buffer owned by someone else (e.g., a part of another source); the buffer must
+/// outlive the source
+///
+class CBufferSource : public CSource {
+  public:
+    /// @brief constructor
+    ///
+    /// @param data buffer
+    /// @param size size of the buffer in bytes
+    CBufferSource(const char *data, size_t size);
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief memory-mapped file input source
+///
+class CMappedSource : public CSource {
+  public:
+    /// @brief constructor
+    ///
+    /// @param fd file descriptor of a regular file
+    /// @param size size of the file in bytes
+    CMappedSource(int fd, size_t size);
+
+    /// @brief destructor
+    virtual ~CMappedSource(void);
+
+  private:
+    void       *_map;               ///< mapped region (NULL for empty files)
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief stream input source
+///
+/// reads an input stream in large chunks into a growing buffer
+///
+class CStreamSource : public CSource {
+  public:
+    /// @brief constructor
+    ///
+    /// @param in input stream
+    /// @param delete_in delete input stream upon destruction
+    CStreamSource(istream *in, bool delete_in=false);
+
+    /// @brief destructor
+    virtual ~CStreamSource(void);
+
+    /// @brief read the next chunk from the input stream
+    virtual bool Refill(void);
+
+    const static size_t CHUNK_SIZE = 1 << 20; ///< minimal read size
+
+  private:
+    istream    *_in;                ///< input stream
+    bool        _delete_in;         ///< delete input stream upon destruction
+    char       *_buf;               ///< buffer
+    size_t      _capacity;          ///< size of buffer
+};
+
+
+#endif // __SnuPL_SOURCE_H__
@@ -32,11 +32,15 @@
 /// DAMAGE.
 //--------------------------------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
 #include "symtab.h"
+#include "context.h"
+#include "scanner.h"
 using namespace std;
 
 
@@ -101,7 +105,7 @@ ostream& operator<<(ostream &out, const CStorage *s)
 // CSymbol
 //
 CSymbol::CSymbol(const string name, ESymbolType stype, const CType *dtype)
-  : _symtab(NULL), _name(name), _symboltype(stype), _datatype(dtype), _location(NULL), _data(NULL)
+  : _symtab(NULL), _slot(-1), _name(name), _symboltype(stype), _datatype(dtype), _location(NULL)
 {
   assert(_name != "");
   assert(_datatype != NULL);
@@ -132,9 +136,10 @@ const CType* CSymbol::GetDataType(void) const
   return _datatype;
 }
 
-void CSymbol::SetSymbolTable(CSymtab *symtab)
+void CSymbol::SetSymbolTable(CSymtab *symtab, int slot)
 {
   _symtab = symtab;
+  _slot = slot;
 }
 
 CSymtab* CSymbol::GetSymbolTable(void) const
@@ -142,12 +147,18 @@ CSymtab* CSymbol::GetSymbolTable(void) const
   return _symtab;
 }
 
-void CSymbol::SetData(CDataInitializer *data)
+SSymbolRef CSymbol::GetRef(void) const
+{
+  if (_symtab == NULL) return SSymbolRef{ -1, -1 };
+  else return SSymbolRef{ _symtab->GetDepth(), _slot };
+}
+
+void CSymbol::SetData(const CDataValue &data)
 {
   _data = data;
 }
 
-const CDataInitializer* CSymbol::GetData(void) const
+const CDataValue& CSymbol::GetData(void) const
 {
   return _data;
 }
@@ -309,11 +320,10 @@ ostream& CSymProc::print(ostream &out, int indent) const
 //------------------------------------------------------------------------------
 // CSymConstant
 //
-CSymConstant::CSymConstant(const string name, const CType *type,
-                           const CDataInitializer *data)
+CSymConstant::CSymConstant(const string name, const CType *type, const CDataValue &data)
   : CSymbol(name, stConstant, type)
 {
-  assert(data != NULL);
+  assert(data.IsValid());
   _data = data;
 }
 
@@ -332,21 +342,25 @@ ostream& CSymConstant::print(ostream &out, int indent) const
 // CSymtab
 //
 CSymtab::CSymtab(void)
-  : _parent(NULL)
+  : _used(0), _parent(NULL), _depth(0)
 {
+  CContext *ctx = CContext::Get();
+  assert(ctx != NULL);
+  _names = ctx->GetInterner();
 }
 
 CSymtab::CSymtab(CSymtab *parent)
-  : _parent(parent)
+  : _used(0), _parent(parent)
 {
   assert(parent != NULL);
+  _names = parent->_names;
+  _depth = parent->_depth + 1;
 }
 
 CSymtab::~CSymtab(void)
 {
-  map<string, CSymbol*>::const_iterator it = _symtab.begin();
-  while (it != _symtab.end()) delete (*it++).second;
-  _symtab.clear();
+  for (size_t i=0; i<_symbols.size(); i++) delete _symbols[i];
+  _symbols.clear();
 }
 
 CSymtab* CSymtab::GetParent(void) const
@@ -354,6 +368,36 @@ CSymtab* CSymtab::GetParent(void) const
   return _parent;
 }
 
+CSymtab::SEntry* CSymtab::Probe(unsigned int id) const
+{
+  assert(!_table.empty());
+
+  size_t mask = _table.size() - 1;
+  size_t slot = (id * 2654435761U) & mask;
+
+  while ((_table[slot].symbol != NULL) && (_table[slot].id != id)) slot = (slot + 1) & mask;
+
+  return &_table[slot];
+}
+
+void CSymtab::Enter(unsigned int id, const CSymbol *s) const
+{
+  // keep the load factor below 1/2
+  if (2*(_used + 1) > _table.size()) {
+    vector<SEntry> table(max<size_t>(16, 2*_table.size()), SEntry{ 0, NULL });
+    table.swap(_table);
+
+    for (size_t i=0; i<table.size(); i++) {
+      if (table[i].symbol != NULL) *Probe(table[i].id) = table[i];
+    }
+  }
+
+  SEntry *e = Probe(id);
+  if (e->symbol == NULL) _used++;
+  e->id = id;
+  e->symbol = s;
+}
+
 bool CSymtab::AddSymbol(CSymbol *s)
 {
   assert(s != NULL);
@@ -363,55 +407,80 @@ bool CSymtab::AddSymbol(CSymbol *s)
     return _parent->AddSymbol(s);
   }
 
-  if (!FindSymbol(s->GetName(), sLocal)) {
-    _symtab[s->GetName()] = s;
-    s->SetSymbolTable(this);
-    return true;
-  } else {
-    return false;
+  unsigned int id = _names->Intern(s->GetName());
+
+  // symbols of enclosing scopes entered by FindSymbol() are shadowed by the new symbol
+  if (!_table.empty()) {
+    const CSymbol *e = Probe(id)->symbol;
+    if ((e != NULL) && (e->GetSymbolTable() == this)) return false;
   }
+
+  Enter(id, s);
+  s->SetSymbolTable(this, (int)_symbols.size());
+  _symbols.push_back(s);
+
+  return true;
 }
 
 const CSymbol* CSymtab::FindSymbol(const string name, EScope scope) const
 {
-  map<string, CSymbol*>::const_iterator it = _symtab.find(name);
+  // names that have never been interned cannot belong to a symbol
+  unsigned int id = _names->Find(name);
 
-  if (it != _symtab.end()) return (*it).second;
-  else {
-    if ((scope == sLocal) || (_parent == NULL)) return NULL;
-    else return _parent->FindSymbol(name, scope);
-  }
+  if (id == CInterner::NONE) return NULL;
+  else return FindSymbol(id, scope);
 }
 
-vector<CSymbol*> CSymtab::GetSymbols(void) const
+const CSymbol* CSymtab::FindSymbol(unsigned int id, EScope scope) const
 {
-  vector<CSymbol*> _res;
+  if (!_table.empty()) {
+    const CSymbol *s = Probe(id)->symbol;
 
-  map<string, CSymbol*>::const_iterator it = _symtab.begin();
-  while (it != _symtab.end()) {
-    _res.push_back(it->second);
-    it++;
+    if (s != NULL) {
+      if ((scope == sGlobal) || (s->GetSymbolTable() == this)) return s;
+      else return NULL;
+    }
   }
 
-  return _res;
+  if ((scope == sLocal) || (_parent == NULL)) return NULL;
+
+  // remember symbols of the parent scope for subsequent lookups. Symbols of scopes further up
+  // are not remembered since the parent may declare a symbol of the same name later.
+  const CSymbol *s = _parent->FindSymbol(id, scope);
+  if ((s != NULL) && (s->GetSymbolTable() == _parent)) Enter(id, s);
+
+  return s;
+}
+
+const CSymbol* CSymtab::GetSymbol(const SSymbolRef &ref) const
+{
+  assert((ref.depth >= 0) && (ref.depth <= _depth));
+
+  const CSymtab *st = this;
+  while (st->_depth > ref.depth) st = st->_parent;
+
+  assert((ref.slot >= 0) && (ref.slot < (int)st->_symbols.size()));
+  return st->_symbols[ref.slot];
 }
 
 ostream& CSymtab::print(ostream &out, int indent) const
 {
   string ind(indent, ' ');
 
+  // symbols are listed in alphabetical order
+  vector<const CSymbol*> symbols(_symbols.begin(), _symbols.end());
+  sort(symbols.begin(), symbols.end(),
+       [](const CSymbol *a, const CSymbol *b) { return a->GetName() < b->GetName(); });
+
   out << ind << "[[";
-  map<string, CSymbol*>::const_iterator it = _symtab.begin();
-  while (it != _symtab.end()) {
+  for (const CSymbol *s : symbols) {
     out << endl;
 
-    const CSymbol *s = (*it++).second;
     s->print(out, indent+2);
 
-    const CDataInitializer *di = s->GetData();
-    if (di != NULL) {
+    if (s->GetData().IsValid()) {
       out << endl;
-      di->print(out, indent+4);
+      s->GetData().print(out, indent+4);
     }
   }
   out << endl << ind << "]]" << endl;
@@ -429,3 +498,105 @@ ostream& operator<<(ostream &out, const CSymtab *t)
   return t->print(out);
 }
 
+
+
+//--------------------------------------------------------------------------------------------------
+// CStringPool
+//
+CStringPool::CStringPool(CSymtab *symtab)
+  : _symtab(symtab), _idx(0)
+{
+  assert(symtab != NULL);
+}
+
+const CSymGlobal* CStringPool::Add(const string &value)
+{
+  unsigned int id = CContext::Get()->GetInterner()->Intern(value);
+
+  auto it = _index.find(id);
+  if (it != _index.end()) return _symbols[it->second];
+
+  CTypeManager *tm = CTypeManager::Get();
+  const CType *type = tm->GetArray(strlen(CToken::unescape(value).c_str())+1, tm->GetChar());
+
+  // in case of name clashes we simply iterate until we find a
+  // name that has not yet been used
+  string name;
+  do {
+    ostringstream o;
+    o << "_str_" << ++_idx;
+    name = o.str();
+  } while (_symtab->FindSymbol(name, sLocal) != NULL);
+
+  CSymGlobal *sym = new CSymGlobal(name, type);
+  sym->SetData(CDataValue::String(id));
+  _symtab->AddSymbol(sym);
+
+  _index[id] = _symbols.size();
+  _symbols.push_back(sym);
+
+  return sym;
+}
+
+const CSymGlobal* CStringPool::Find(const string &value) const
+{
+  unsigned int id = CContext::Get()->GetInterner()->Find(value);
+  if (id == CInterner::NONE) return NULL;
+
+  auto it = _index.find(id);
+  return it != _index.end() ? _symbols[it->second] : NULL;
+}
+
+ostream& CStringPool::Emit(ostream &out, int indent) const
+{
+  string ind(indent, ' ');
+
+  // sort the reversed strings; a string that is a suffix of another one then immediately precedes
+  // a string it is a suffix of
+  size_t n = _symbols.size();
+  vector<string> rev(n);
+  vector<size_t> order(n);
+  for (size_t i=0; i<n; i++) {
+    string data = CToken::unescape(_symbols[i]->GetData().GetString());
+    rev[i].assign(data.rbegin(), data.rend());
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(),
+       [&rev](size_t a, size_t b) { return rev[a] < rev[b]; });
+
+  // owner[k]: the string whose storage holds the k-th string in sorted order
+  vector<size_t> owner(n);
+  for (size_t k=n; k-- > 0; ) {
+    const string &r = rev[order[k]];
+    if ((k+1 < n) && (rev[order[k+1]].compare(0, r.size(), r) == 0)) owner[k] = owner[k+1];
+    else owner[k] = k;
+  }
+
+  out << ind << "# string literals" << endl
+      << ind << ".section .rodata" << endl;
+
+  for (size_t k=0; k<n; k++) {
+    if (owner[k] != k) continue;
+
+    const string &r = rev[order[k]];
+    out << _symbols[order[k]]->GetName() << ":" << endl
+        << ind << ".asciz \"";
+    for (auto c=r.rbegin(); c!=r.rend(); c++) {
+      unsigned char ch = *c;
+      if ((ch >= ' ') && (ch < 0x7f) && (ch != '"') && (ch != '\\')) out << ch;
+      else out << "\\" << oct << setw(3) << setfill('0') << (int)ch << dec << setfill(' ');
+    }
+    out << "\"" << endl;
+  }
+
+  for (size_t k=0; k<n; k++) {
+    if (owner[k] == k) continue;
+
+    size_t offset = rev[order[owner[k]]].size() - rev[order[k]].size();
+    out << ind << ".set " << _symbols[order[k]]->GetName() << ", "
+        << _symbols[order[owner[k]]]->GetName() << " + " << offset << endl;
+  }
+  out << endl;
+
+  return out;
+}
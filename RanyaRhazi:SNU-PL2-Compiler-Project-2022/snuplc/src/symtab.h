@@ -35,7 +35,7 @@
 #define __SnuPL_SYMTAB_H__
 
 #include <iostream>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "data.h"
@@ -136,6 +136,18 @@ enum ESymbolType {
 };
 
 class CSymtab;
+class CInterner;
+
+//--------------------------------------------------------------------------------------------------
+/// @brief resolved symbol reference
+///
+/// addresses a symbol by the nesting depth of its scope (0 = module) and its slot (the index of
+/// the symbol in the symbol table of that scope in order of insertion)
+///
+struct SSymbolRef {
+  int depth;                        ///< depth of the scope (-1: symbol not in a symbol table)
+  int slot;                         ///< index in the symbol table
+};
 
 //--------------------------------------------------------------------------------------------------
 /// @brief SnuPL symbol
@@ -184,18 +196,22 @@ class CSymbol {
     /// @retval CSymtab symbol table
     CSymtab* GetSymbolTable(void) const;
 
+    /// @brief return the scope depth and slot of this symbol
+    /// @retval SSymbolRef reference to the symbol ({ -1, -1 } if not in a symbol table)
+    SSymbolRef GetRef(void) const;
+
     /// @}
 
     /// @name data handling
     /// @{
 
     /// @brief set the symbol's value (for initialized symbols)
-    /// @param data data initializer
-    virtual void SetData(CDataInitializer *data);
+    /// @param data data value
+    virtual void SetData(const CDataValue &data);
 
-    /// @brief return the symbol's data initializer
-    /// @retval CDataInitializer data initializer
-    virtual const CDataInitializer* GetData(void) const;
+    /// @brief return the symbol's value
+    /// @retval CDataValue data value (dkNone for uninitialized symbols)
+    virtual const CDataValue& GetData(void) const;
 
     /// @}
 
@@ -222,18 +238,20 @@ class CSymbol {
 
     /// @brief set the symbol table owning this symbol
     /// @param symtab symbol table
-    void SetSymbolTable(CSymtab *symtab);
+    /// @param slot index of the symbol in @a symtab
+    void SetSymbolTable(CSymtab *symtab, int slot);
 
     /// @}
 
     CSymtab       *_symtab;       ///< symbol table owning this symbol
+    int            _slot;         ///< index of the symbol in _symtab
     string         _name;         ///< name
     ESymbolType    _symboltype;   ///< symbol type
     const CType   *_datatype;     ///< data type
     CStorage      *_location;     ///< storage location
 
   protected:
-    const CDataInitializer *_data;///< data initializer
+    CDataValue     _data;         ///< data value
 };
 
 /// @name CSymbol output operators
@@ -436,8 +454,7 @@ class CSymConstant : public CSymbol {
     /// @param name symbol name (identifier)
     /// @param type symbol type
     /// @param data constant value
-    CSymConstant(const string name, const CType *type, 
-                 const CDataInitializer *data);
+    CSymConstant(const string name, const CType *type, const CDataValue &data);
 
     /// @}
 
@@ -461,7 +478,10 @@ enum EScope {
 //--------------------------------------------------------------------------------------------------
 /// @brief SnuPL symbol table
 ///
-/// hierarchical symbol table
+/// hierarchical symbol table. Symbols are kept in an open-addressing hash table keyed by the id
+/// of their name in the string interner of the compilation context. Symbols of enclosing scopes
+/// that are found through a subordinate table are entered into that table as well (they are
+/// shadowed by local symbols added later), hence repeated lookups take a single probe.
 ///
 class CSymtab {
   public:
@@ -489,6 +509,9 @@ class CSymtab {
     /// @retval NULL if this instance is the global symbol table
     CSymtab* GetParent(void) const;
 
+    /// @brief return the nesting depth of the scope (0 for the global symbol table)
+    int GetDepth(void) const { return _depth; };
+
     /// @}
 
 
@@ -506,8 +529,19 @@ class CSymtab {
     /// @retval CSymbol matching symbol or NULL if not found
     const CSymbol* FindSymbol(const string name, EScope scope=sGlobal) const;
 
-    /// @brief return a list of all symbols
-    vector<CSymbol*> GetSymbols(void) const;
+    /// @brief return a symbol with a given interned name
+    /// @param id id of the symbol name in the string interner
+    /// @param scope search scope (default: sGlobal)
+    /// @retval CSymbol matching symbol or NULL if not found
+    const CSymbol* FindSymbol(unsigned int id, EScope scope=sGlobal) const;
+
+    /// @brief return the symbols of this table in order of insertion
+    const vector<CSymbol*>& GetSymbols(void) const { return _symbols; };
+
+    /// @brief return a resolved symbol visible in this scope
+    /// @param ref scope depth and slot of the symbol
+    /// @retval CSymbol referenced symbol
+    const CSymbol* GetSymbol(const SSymbolRef &ref) const;
 
     /// @}
 
@@ -519,8 +553,24 @@ class CSymtab {
     ostream&  print(ostream &out, int indent=0) const;
 
   private:
-    map<string, CSymbol*> _symtab;///< local symbol table
+    /// @brief hash table entry
+    struct SEntry {
+      unsigned int id;              ///< id of the symbol name
+      const CSymbol *symbol;        ///< symbol (NULL = empty slot)
+    };
+
+    /// @brief return the entry of @a id (or the empty entry it would occupy)
+    SEntry* Probe(unsigned int id) const;
+
+    /// @brief enter symbol @a s with name @a id into the hash table
+    void Enter(unsigned int id, const CSymbol *s) const;
+
+    CInterner     *_names;        ///< string interner of the symbol names
+    vector<CSymbol*> _symbols;    ///< local symbols in order of insertion
+    mutable vector<SEntry> _table;///< hash table (local symbols and symbols found in parents)
+    mutable size_t _used;         ///< number of used entries in _table
     CSymtab       *_parent;       ///< parent
+    int            _depth;        ///< nesting depth
 };
 
 /// @name CSymtab output operators
@@ -543,4 +593,67 @@ ostream& operator<<(ostream &out, const CSymtab *t);
 /// @}
 
 
+//--------------------------------------------------------------------------------------------------
+/// @brief string literal pool
+///
+/// Holds the global symbols of the string constants of a module. Identical strings share one
+/// symbol named "_str_<n>" where n numbers the pooled strings, skipping names that are taken by
+/// other global symbols. The pool is filled in source order by the thread parsing the module;
+/// subroutine bodies parsed in parallel only look strings up.
+///
+/// In the data section, the pooled strings are read-only, and strings that are suffixes of other
+/// pooled strings share the storage of the longer string.
+///
+class CStringPool {
+  public:
+    /// @name constructor/destructor
+    /// @{
+
+    /// @brief constructor
+    ///
+    /// @param symtab global symbol table receiving the string symbols
+    CStringPool(CSymtab *symtab);
+
+    /// @}
+
+    /// @name pool access
+    /// @{
+
+    /// @brief return the symbol of a string, adding the string upon first use
+    ///
+    /// @param value string (escaped)
+    /// @retval CSymGlobal symbol holding the string
+    const CSymGlobal* Add(const string &value);
+
+    /// @brief look up the symbol of a string without adding it
+    ///
+    /// Only reads the pool; may thus run concurrently with other lookups.
+    ///
+    /// @param value string (escaped)
+    /// @retval CSymGlobal symbol holding the string
+    /// @retval NULL if the string has not been pooled
+    const CSymGlobal* Find(const string &value) const;
+
+    /// @brief return the number of pooled strings
+    size_t GetSize(void) const { return _symbols.size(); };
+
+    /// @brief return the symbol of the @a i-th pooled string (in order of addition)
+    const CSymGlobal* GetSymbol(size_t i) const { return _symbols[i]; };
+
+    /// @}
+
+    /// @brief emit the pooled strings into the read-only data section (GNU assembler syntax)
+    ///
+    /// @param out output stream
+    /// @param indent indentation of the directives
+    ostream&  Emit(ostream &out, int indent=4) const;
+
+  private:
+    CSymtab       *_symtab;       ///< global symbol table
+    int            _idx;          ///< number of the last string symbol
+    unordered_map<unsigned int, size_t> _index; ///< index of the strings by interner id
+    vector<CSymGlobal*> _symbols; ///< string symbols in order of addition
+};
+
+
 #endif // __SnuPL_SYMTAB_H__
@@ -30,83 +30,202 @@
 /// DAMAGE.
 //--------------------------------------------------------------------------------------------------
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include <cassert>
 #include <string.h>
 
 #include "scanner.h"
 #include "parser.h"
+#include "astflat.h"
 using namespace std;
 
-int main(int argc, char *argv[])
+/// @brief parser options
+struct SOptions {
+  bool arena_stats;                 ///< print arena usage and flat AST size
+  EParseMode mode;                  ///< parsing strategy
+  unsigned int nthreads;            ///< number of threads parsing subroutine bodies
+  bool lazy;                        ///< parse subroutine bodies on demand
+  bool recover;                     ///< recover from syntax errors
+};
+
+/// @brief parse one input and print the result
+///
+/// Each input is compiled in its own context; inputs can thus be parsed concurrently.
+///
+/// @param fn name of the input (used for the .dot output file)
+/// @param s scanner for the input
+/// @param o options
+/// @param out output stream
+static void ParseFile(const char *fn, CScanner *s, const SOptions &o, ostream &out)
 {
-  int i = 1;
-  bool use_stdin = argc == 1;
-  char *fn;
-
-  while ((i < argc) || (use_stdin)) {
-    istream *in;
-
-    if (use_stdin) {
-      fn = strdup("stdin");
-      in = &cin;
-      cout << "parsing from standard input..." << endl;
-    } else {
-      fn = argv[i];
-      in = new ifstream(fn);
-      cout << "parsing '" << fn << "'..." << endl;
+  CActiveContext active(s->GetContext());
+  CParser *p = new CParser(s, o.mode, o.nthreads, o.lazy, o.recover);
+
+  CAstNode *n = p->Parse();
+
+  // materialize the subroutine bodies that have been skipped in lazy mode
+  bool body_error = false;
+  CToken body_token;
+  string body_msg;
+  if (!p->HasError()) {
+    CAstModule *m = dynamic_cast<CAstModule*>(n);
+    for (size_t c=0; !body_error && (c<m->GetNumChildren()); c++) {
+      body_error = !m->GetChild(c)->Materialize(&body_token, &body_msg);
+    }
+  }
+
+  if (p->HasError() && o.recover) {
+    for (const SDiagnostic &d : p->GetDiagnostics()) {
+      out << "syntax error at " << d.token.GetLineNumber() << ":"
+          << d.token.GetCharPosition() << " : " << d.message << endl;
     }
 
-    CScanner *s = new CScanner(in);
-    CParser *p = new CParser(s);
-
-    CAstNode *n = p->Parse();
-
-    if (p->HasError()) {
-      const CToken *error = p->GetErrorToken();
-      cout << "syntax error at " << error->GetLineNumber() << ":"
-           << error->GetCharPosition() << " : " << p->GetErrorMessage() << endl;
-
-      delete n;
-    } else {
-      CAstModule *m = dynamic_cast<CAstModule*>(n);
-      assert(m != NULL);
-
-      cout << "successfully parsed." << endl
-           << "  AST:" << endl;
-      m->print(cout, 4);
-      cout << endl << endl;
-
-      string outf = string(fn) + ".ast.dot";
-      ofstream out(outf.c_str());
-      out << "digraph AST {" << endl
-          << "  graph [fontname=\"Times New Roman\",fontsize=10];" << endl
-          << "  node  [fontname=\"Courier New\",fontsize=10];" << endl
-          << "  edge  [fontname=\"Times New Roman\",fontsize=10];" << endl
-          << endl;
-      m->toDot(out, 2);
-      out << "}" << endl;
-      out.flush();
-
-      ostringstream cmd;
-      cmd << "dot -Tpdf -o" << fn << ".ast.pdf " << fn << ".ast.dot";
-      cout << "run the following command to convert the .dot file into a PDF:" << endl
-           << "  " << cmd.str() <<
-           endl;
-
-      delete m;
+    out << "  partial AST:" << endl;
+    if (n != NULL) n->print(out, 4);
+    out << endl << endl;
+
+    delete n;
+  } else if (p->HasError()) {
+    const CToken *error = p->GetErrorToken();
+    out << "syntax error at " << error->GetLineNumber() << ":"
+        << error->GetCharPosition() << " : " << p->GetErrorMessage() << endl;
+
+    delete n;
+  } else if (body_error) {
+    out << "syntax error at " << body_token.GetLineNumber() << ":"
+        << body_token.GetCharPosition() << " : " << body_msg << endl;
+
+    delete n;
+  } else {
+    CAstModule *m = dynamic_cast<CAstModule*>(n);
+    assert(m != NULL);
+
+    out << "successfully parsed." << endl
+        << "  AST:" << endl;
+    m->print(out, 4);
+    out << endl << endl;
+
+    if (o.arena_stats) {
+      out << "  arena:" << endl;
+      m->GetArena()->print(out, 4);
+      out << endl;
+
+      size_t ntokens;
+      const CToken *tokens = s->GetTokens(&ntokens);
+      CAstFlat flat(m, tokens, ntokens);
+      out << "  flat AST: " << flat.GetNStatements() << " statements, "
+          << flat.GetNExpressions() << " expressions, " << flat.GetSize() << " bytes" << endl
+          << endl << endl;
     }
 
-    cout << endl << endl;
+    string outf = string(fn) + ".ast.dot";
+    ofstream dot(outf.c_str());
+    dot << "digraph AST {" << endl
+        << "  graph [fontname=\"Times New Roman\",fontsize=10];" << endl
+        << "  node  [fontname=\"Courier New\",fontsize=10];" << endl
+        << "  edge  [fontname=\"Times New Roman\",fontsize=10];" << endl
+        << endl;
+    m->toDot(dot, 2);
+    dot << "}" << endl;
+    dot.flush();
+
+    ostringstream cmd;
+    cmd << "dot -Tpdf -o" << fn << ".ast.pdf " << fn << ".ast.dot";
+    out << "run the following command to convert the .dot file into a PDF:" << endl
+        << "  " << cmd.str() <<
+        endl;
+
+    delete m;
+  }
+
+  out << endl << endl;
 
+  delete p;
+}
+
+int main(int argc, char *argv[])
+{
+  int i = 1;
+  SOptions o = { false, pmIterative, 1, false, false };
+  unsigned int njobs = 1;
+
+  while ((i < argc) && (argv[i][0] == '-') && (argv[i][1] != '\0')) {
+    // -a: print the arena usage of the AST per node kind and the size of its flat encoding
+    if (strcmp(argv[i], "-a") == 0) o.arena_stats = true;
+    // -r: parse expressions and identifier lists by recursive descent
+    else if (strcmp(argv[i], "-r") == 0) o.mode = pmRecursive;
+    // -p <n>: parse subroutine bodies on n threads
+    else if ((strcmp(argv[i], "-p") == 0) && (i+1 < argc)) o.nthreads = atoi(argv[++i]);
+    // -l: parse subroutine bodies on demand
+    else if (strcmp(argv[i], "-l") == 0) o.lazy = true;
+    // -e: recover from syntax errors, report all of them, and print the partial AST
+    else if (strcmp(argv[i], "-e") == 0) o.recover = true;
+    // -j <n>: parse n files concurrently; the output is printed in the order of the files
+    else if ((strcmp(argv[i], "-j") == 0) && (i+1 < argc)) njobs = atoi(argv[++i]);
+    else break;
     i++;
+  }
 
-    delete p;
+  if (i == argc) {
+    cout << "parsing from standard input..." << endl;
+    CScanner *s = new CScanner(&cin);
+    ParseFile("stdin", s, o, cout);
     delete s;
-    if (!use_stdin) delete in;
-    use_stdin = false;
+  } else if (njobs <= 1) {
+    for (; i<argc; i++) {
+      cout << "parsing '" << argv[i] << "'..." << endl;
+      CScanner *s = new CScanner(CSource::Open(argv[i]));
+      ParseFile(argv[i], s, o, cout);
+      delete s;
+    }
+  } else {
+    // workers take the next file and buffer its output; the main thread prints the outputs as
+    // soon as all preceding files are done
+    size_t nfiles = argc - i;
+    vector<string> output(nfiles);
+    vector<bool> done(nfiles, false);
+    atomic<size_t> next(0);
+    mutex lock;
+    condition_variable cv;
+
+    auto work = [&]() {
+      size_t f;
+      while ((f = next++) < nfiles) {
+        const char *fn = argv[i + f];
+        ostringstream out;
+        out << "parsing '" << fn << "'..." << endl;
+        CScanner *s = new CScanner(CSource::Open(fn));
+        ParseFile(fn, s, o, out);
+        delete s;
+
+        lock_guard<mutex> guard(lock);
+        output[f] = out.str();
+        done[f] = true;
+        cv.notify_one();
+      }
+    };
+
+    vector<thread> workers;
+    for (unsigned int w=0; (w<njobs) && (w<nfiles); w++) workers.push_back(thread(work));
+
+    for (size_t f=0; f<nfiles; f++) {
+      unique_lock<mutex> guard(lock);
+      cv.wait(guard, [&]() { return done[f]; });
+      string text;
+      text.swap(output[f]);
+      guard.unlock();
+      cout << text;
+    }
+
+    for (size_t w=0; w<workers.size(); w++) workers[w].join();
   }
 
   cout << "Done." << endl;
@@ -30,44 +30,85 @@
 //--------------------------------------------------------------------------------------------------
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
 #include "scanner.h"
+#include "tokfile.h"
 using namespace std;
 
+/// @brief check whether a file name ends in '.snutok'
+static bool IsTokenFile(const string &fn)
+{
+  const string ext = ".snutok";
+  return (fn.size() > ext.size()) && (fn.compare(fn.size() - ext.size(), ext.size(), ext) == 0);
+}
+
 int main(int argc, char *argv[])
 {
   int i = 1;
-  bool use_stdin = argc == 1;
+  bool write_tokens = false;
+
+  // -t: write the token stream of each input to <input>.snutok
+  if ((i < argc) && (strcmp(argv[i], "-t") == 0)) {
+    write_tokens = true;
+    i++;
+  }
+
+  bool use_stdin = i == argc;
 
   while ((i < argc) || (use_stdin)) {
-    istream *in;
+    CScanner *s;
+    string fn = use_stdin ? "stdin" : argv[i];
 
     if (use_stdin) {
-      in = &cin;
       cout << "scanning from standard input..." << endl;
+      s = new CScanner(&cin);
     } else {
-      in = new ifstream(argv[i]);
-      cout << "scanning '" << argv[i] << "'..." << endl;
+      cout << "scanning '" << fn << "'..." << endl;
+
+      if (IsTokenFile(fn)) {
+        CTokenFile *tf = CTokenFile::Open(fn);
+
+        if (tf == NULL) {
+          cout << "  invalid token file." << endl << endl << endl;
+          i++;
+          continue;
+        }
+
+        s = new CScanner(tf);
+      } else {
+        s = new CScanner(CSource::Open(fn));
+      }
     }
 
-    CScanner *s = new CScanner(in);
+    CActiveContext active(s->GetContext());
 
     if (!s->Good()) cout << "  cannot open input stream: " << s->Peek() << endl;
 
+    vector<CToken> tokens;
+    CTokenWriter out(&cout);
+
     while (s->Good()) {
       CToken t = s->Get();
-      cout << "  " << t << endl;
+      out.Write(t, 2);
+      if (write_tokens) tokens.push_back(t);
       if (t.GetType() == tEOF) break;
     }
 
+    out.Flush();
     cout << endl << endl;
 
+    if (write_tokens && !tokens.empty() && (tokens.back().GetType() == tEOF)) {
+      if (!CTokenFile::Write(fn + ".snutok", s->GetContext(), tokens.data(), tokens.size())) {
+        cerr << "cannot write '" << fn << ".snutok'" << endl;
+      }
+    }
+
     i++;
 
     delete s;
-    if (!use_stdin) delete in;
     use_stdin = false;
   }
 
@@ -29,8 +29,14 @@
 //--------------------------------------------------------------------------------------------------
 
 #include <cstdlib>
+#include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 #include <cassert>
 #include <string.h>
 
@@ -38,82 +44,142 @@
 #include "parser.h"
 using namespace std;
 
-int main(int argc, char *argv[])
+/// @brief parse and type-check one input and print the result
+///
+/// Each input is compiled in its own context; inputs can thus be checked concurrently.
+///
+/// @param fn name of the input (used for the .dot output file)
+/// @param s scanner for the input
+/// @param out output stream
+/// @param strings print the string literals of the module as emitted into the data section
+static void CheckFile(const char *fn, CScanner *s, ostream &out, bool strings)
 {
-  int i = 1;
-  bool use_stdin = argc == 1;
-  char *fn;
+  CActiveContext active(s->GetContext());
+  CParser *p = new CParser(s);
 
-  while ((i < argc) || (use_stdin)) {
-    istream *in;
+  CAstNode *n = p->Parse();
 
-    if (use_stdin) {
-      fn = strdup("stdin");
-      in = &cin;
-      cout << "parsing from standard input..." << endl;
-    } else {
-      fn = argv[i];
-      in = new ifstream(fn);
-      cout << "parsing '" << fn << "'..." << endl;
-    }
+  if (p->HasError()) {
+    const CToken *error = p->GetErrorToken();
+    out << "syntax error at " << error->GetLineNumber() << ":"
+        << error->GetCharPosition() << " : " << p->GetErrorMessage() << endl;
 
-    CScanner *s = new CScanner(in);
-    CParser *p = new CParser(s);
+    delete n;
+  } else {
+    CAstModule *m = dynamic_cast<CAstModule*>(n);
+    assert(m != NULL);
 
-    CAstNode *n = p->Parse();
+    out << "successfully parsed." << endl
+        << "running semantic analysis..." << endl;
 
-    if (p->HasError()) {
-      const CToken *error = p->GetErrorToken();
-      cout << "syntax error at " << error->GetLineNumber() << ":"
-           << error->GetCharPosition() << " : " << p->GetErrorMessage() << endl;
-
-      delete n;
+    CToken t;
+    string msg;
+    if (!m->TypeCheck(&t, &msg)) {
+      out << "semantic error at " << t.GetLineNumber() << ":"
+        << t.GetCharPosition() << " : " << msg << endl;
     } else {
-      CAstModule *m = dynamic_cast<CAstModule*>(n);
-      assert(m != NULL);
-
-      cout << "successfully parsed." << endl
-           << "running semantic analysis..." << endl;
-
-      CToken t;
-      string msg;
-      if (!m->TypeCheck(&t, &msg)) {
-        cout << "semantic error at " << t.GetLineNumber() << ":"
-          << t.GetCharPosition() << " : " << msg << endl;
-      } else {
-        cout << "semantic analysis completed." << endl
-          << "  AST:" << endl;
-        m->print(cout, 4);
-        cout << endl << endl;
-
-        string outf = string(fn) + ".ast.dot";
-        ofstream out(outf.c_str());
-        out << "digraph AST {" << endl
-            << "  graph [fontname=\"Times New Roman\",fontsize=10];" << endl
-            << "  node  [fontname=\"Courier New\",fontsize=10];" << endl
-            << "  edge  [fontname=\"Times New Roman\",fontsize=10];" << endl
-            << endl;
-        m->toDot(out, 2);
-        out << "}" << endl;
-        out.flush();
-
-        ostringstream cmd;
-        cmd << "dot -Tpdf -o" << fn << ".ast.pdf " << fn << ".ast.dot";
-        cout << "run the following command to convert the .dot file into a PDF:" << endl
-             << "  " << cmd.str() << endl;
-      }
-
-      delete m;
+      out << "semantic analysis completed." << endl
+        << "  AST:" << endl;
+      m->print(out, 4);
+      out << endl << endl;
+
+      if (strings) m->GetStringPool()->Emit(out);
+
+      string outf = string(fn) + ".ast.dot";
+      ofstream dot(outf.c_str());
+      dot << "digraph AST {" << endl
+          << "  graph [fontname=\"Times New Roman\",fontsize=10];" << endl
+          << "  node  [fontname=\"Courier New\",fontsize=10];" << endl
+          << "  edge  [fontname=\"Times New Roman\",fontsize=10];" << endl
+          << endl;
+      m->toDot(dot, 2);
+      dot << "}" << endl;
+      dot.flush();
+
+      ostringstream cmd;
+      cmd << "dot -Tpdf -o" << fn << ".ast.pdf " << fn << ".ast.dot";
+      out << "run the following command to convert the .dot file into a PDF:" << endl
+          << "  " << cmd.str() << endl;
     }
 
-    cout << endl << endl;
+    delete m;
+  }
 
-    i++;
+  out << endl << endl;
 
-    delete p;
+  delete p;
+}
+
+int main(int argc, char *argv[])
+{
+  int i = 1;
+  unsigned int njobs = 1;
+  bool strings = false;
+
+  // -j <n>: check n files concurrently; the output is printed in the order of the files
+  // -s:     print the string literals of each module
+  while (i < argc) {
+    if ((i+1 < argc) && (strcmp(argv[i], "-j") == 0)) {
+      njobs = atoi(argv[i+1]);
+      i += 2;
+    } else if (strcmp(argv[i], "-s") == 0) {
+      strings = true;
+      i++;
+    } else break;
+  }
+
+  if (i == argc) {
+    cout << "parsing from standard input..." << endl;
+    CScanner *s = new CScanner(&cin);
+    CheckFile("stdin", s, cout, strings);
     delete s;
-    if (!use_stdin) delete in;
-    use_stdin = false;
+  } else if (njobs <= 1) {
+    for (; i<argc; i++) {
+      cout << "parsing '" << argv[i] << "'..." << endl;
+      CScanner *s = new CScanner(CSource::Open(argv[i]));
+      CheckFile(argv[i], s, cout, strings);
+      delete s;
+    }
+  } else {
+    // workers take the next file and buffer its output; the main thread prints the outputs as
+    // soon as all preceding files are done
+    size_t nfiles = argc - i;
+    vector<string> output(nfiles);
+    vector<bool> done(nfiles, false);
+    atomic<size_t> next(0);
+    mutex lock;
+    condition_variable cv;
+
+    auto work = [&]() {
+      size_t f;
+      while ((f = next++) < nfiles) {
+        const char *fn = argv[i + f];
+        ostringstream out;
+        out << "parsing '" << fn << "'..." << endl;
+        CScanner *s = new CScanner(CSource::Open(fn));
+        CheckFile(fn, s, out, strings);
+        delete s;
+
+        lock_guard<mutex> guard(lock);
+        output[f] = out.str();
+        done[f] = true;
+        cv.notify_one();
+      }
+    };
+
+    vector<thread> workers;
+    for (unsigned int w=0; (w<njobs) && (w<nfiles); w++) workers.push_back(thread(work));
+
+    for (size_t f=0; f<nfiles; f++) {
+      unique_lock<mutex> guard(lock);
+      cv.wait(guard, [&]() { return done[f]; });
+      string text;
+      text.swap(output[f]);
+      guard.unlock();
+      cout << text;
+    }
+
+    for (size_t w=0; w<workers.size(); w++) workers[w].join();
   }
 
   cout << "Done." << endl;
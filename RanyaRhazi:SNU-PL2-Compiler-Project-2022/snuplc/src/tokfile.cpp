@@ -0,0 +1,221 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL binary token files
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#include <fstream>
+#include <cstring>
+#include <cassert>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tokfile.h"
+using namespace std;
+
+/// @brief header of a token file
+struct STokenFileHeader {
+  char               magic[8];      ///< TOKFILE_MAGIC
+  unsigned int       version;       ///< CTokenFile::VERSION
+  unsigned int       byte_order;    ///< TOKFILE_BYTE_ORDER in the byte order of the writer
+  unsigned int       token_size;    ///< sizeof(CToken)
+  unsigned int       reserved;      ///< 0
+  unsigned long long ntokens;       ///< number of tokens
+  unsigned long long nstrings;      ///< number of interned strings
+  unsigned long long strings_size;  ///< size of the string data
+  unsigned long long source_size;   ///< size of the source text
+  unsigned long long padding;       ///< 0
+};
+
+static_assert(sizeof(STokenFileHeader) == 64, "unexpected size of STokenFileHeader");
+
+static const char TOKFILE_MAGIC[8] = { 'S', 'N', 'U', 'T', 'O', 'K', '\0', '\0' };
+static const unsigned int TOKFILE_BYTE_ORDER = 0x01020304;
+
+/// @brief round a section size up to the section alignment
+static unsigned long long Align(unsigned long long size)
+{
+  return (size + 15) & ~15ULL;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// CTokenFile
+//
+CTokenFile::CTokenFile(void *map, size_t size)
+  : _map(map), _size(size), _ctx(NULL), _tokens(NULL), _ntokens(0)
+{
+}
+
+CTokenFile::~CTokenFile(void)
+{
+  delete _ctx;
+  munmap(_map, _size);
+}
+
+CTokenFile* CTokenFile::Open(const string filename)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) return NULL;
+
+  struct stat st;
+  void *map = MAP_FAILED;
+
+  if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) &&
+      ((size_t)st.st_size >= sizeof(STokenFileHeader))) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+
+  if (map == MAP_FAILED) return NULL;
+
+  CTokenFile *f = new CTokenFile(map, st.st_size);
+  if (f->Load()) return f;
+
+  delete f;
+  return NULL;
+}
+
+bool CTokenFile::Load(void)
+{
+  const char *data = (const char*)_map;
+  const STokenFileHeader *h = (const STokenFileHeader*)data;
+
+  if ((memcmp(h->magic, TOKFILE_MAGIC, sizeof(h->magic)) != 0) ||
+      (h->version != VERSION) || (h->byte_order != TOKFILE_BYTE_ORDER) ||
+      (h->token_size != sizeof(CToken))) return false;
+
+  // check the section sizes one by one to avoid overflows
+  unsigned long long avail = _size - sizeof(STokenFileHeader);
+  if ((h->ntokens == 0) || (h->ntokens > avail / sizeof(CToken))) return false;
+  avail -= h->ntokens * sizeof(CToken);
+  if ((h->nstrings == 0) || (h->nstrings >= avail / sizeof(unsigned int)) ||
+      (Align((h->nstrings + 1) * sizeof(unsigned int)) > avail)) return false;
+  avail -= Align((h->nstrings + 1) * sizeof(unsigned int));
+  if ((h->strings_size > avail) || (Align(h->strings_size) > avail)) return false;
+  avail -= Align(h->strings_size);
+  if ((h->source_size > avail) || (h->source_size >= CToken::NO_OFFSET)) return false;
+
+  const char *p = data + sizeof(STokenFileHeader);
+  const CToken *tokens = (const CToken*)p;
+  p += Align(h->ntokens * sizeof(CToken));
+  const unsigned int *offsets = (const unsigned int*)p;
+  p += Align((h->nstrings + 1) * sizeof(unsigned int));
+  const char *strings = p;
+  p += Align(h->strings_size);
+  const char *source = p;
+
+  // rebuild the interner; ids are assigned in order, hence the strings must be distinct
+  _ctx = new CContext(new CBufferSource(source, h->source_size));
+  CInterner *interner = _ctx->GetInterner();
+
+  if ((offsets[0] != 0) || (offsets[h->nstrings] != h->strings_size)) return false;
+  for (unsigned long long i=0; i<h->nstrings; i++) {
+    if ((offsets[i] > offsets[i+1]) || (offsets[i+1] > h->strings_size)) return false;
+    if (interner->Intern(strings + offsets[i], offsets[i+1] - offsets[i]) != i) return false;
+  }
+
+  // the tokens must only refer to existing strings and to the source text
+  for (unsigned long long i=0; i<h->ntokens; i++) {
+    const CToken &t = tokens[i];
+
+    if ((t._type > tStringConst) || (t._subkind > skEscaped)) return false;
+
+    switch (t._type) {
+      case tIdent:
+      case tComment:
+      case tInvStringConst:
+      case tUndefined:
+        if (t._payload.id >= h->nstrings) return false;
+        break;
+
+      case tCharConst:
+      case tStringConst:
+        if ((t._offset >= h->source_size) ||
+            (t._payload.length >= h->source_size - t._offset)) return false;
+        break;
+
+      case tNumber:
+        if (t._offset >= h->source_size) return false;
+        break;
+    }
+  }
+  if (tokens[h->ntokens - 1]._type != tEOF) return false;
+
+  _tokens = tokens;
+  _ntokens = h->ntokens;
+
+  return true;
+}
+
+bool CTokenFile::Write(const string filename, CContext *ctx, const CToken *tokens,
+                       size_t ntokens)
+{
+  assert((ctx != NULL) && (tokens != NULL) && (ntokens > 0));
+  assert(tokens[ntokens-1].GetType() == tEOF);
+
+  CSource *src = ctx->GetSource();
+  src->Load();
+  if (!src->Good() || !src->IsComplete()) return false;
+
+  CInterner *interner = ctx->GetInterner();
+  vector<unsigned int> offsets(1, 0);
+  for (unsigned int i=0; i<interner->GetSize(); i++) {
+    offsets.push_back(offsets.back() + (unsigned int)interner->GetString(i).size());
+  }
+
+  STokenFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, TOKFILE_MAGIC, sizeof(h.magic));
+  h.version = VERSION;
+  h.byte_order = TOKFILE_BYTE_ORDER;
+  h.token_size = sizeof(CToken);
+  h.ntokens = ntokens;
+  h.nstrings = interner->GetSize();
+  h.strings_size = offsets.back();
+  h.source_size = src->GetSize();
+
+  ofstream out(filename.c_str(), ios::out | ios::binary | ios::trunc);
+  static const char zero[16] = { 0 };
+
+  out.write((const char*)&h, sizeof(h));
+
+  out.write((const char*)tokens, ntokens * sizeof(CToken));
+
+  out.write((const char*)offsets.data(), offsets.size() * sizeof(unsigned int));
+  out.write(zero, Align(offsets.size() * sizeof(unsigned int)) -
+                  offsets.size() * sizeof(unsigned int));
+
+  for (unsigned int i=0; i<interner->GetSize(); i++) {
+    out.write(interner->GetString(i).data(), interner->GetString(i).size());
+  }
+  out.write(zero, Align(h.strings_size) - h.strings_size);
+
+  out.write(src->GetData(), src->GetSize());
+
+  return out.good();
+}
@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------------------
+/// @brief SnuPL binary token files
+///
+/// @section license_section License
+/// Copyright (c) 2012-2022, Computer Systems and Platforms Laboratory, SNU
+/// All rights reserved.
+///
+/// Redistribution and use in source and binary forms, with or without modification, are permitted
+/// provided that the following conditions are met:
+///
+/// - Redistributions of source code must retain the above copyright notice, this list of condi-
+///   tions and the following disclaimer.
+/// - Redistributions in binary form must reproduce the above copyright notice, this list of condi-
+///   tions and the following disclaimer in the documentation and/or other materials provided with
+///   the distribution.
+///
+/// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+/// IMPLIED WARRANTIES,  INCLUDING, BUT NOT LIMITED TO,  THE IMPLIED WARRANTIES OF MERCHANTABILITY
+/// AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+/// CONTRIBUTORS BE LIABLE FOR ANY DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,  EXEMPLARY, OR CONSE-
+/// QUENTIAL DAMAGES (INCLUDING,  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+/// LOSS OF USE, DATA,  OR PROFITS;  OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+/// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+/// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+/// DAMAGE.
+//--------------------------------------------------------------------------------------------------
+
+#ifndef __SnuPL_TOKFILE_H__
+#define __SnuPL_TOKFILE_H__
+
+#include <string>
+
+#include "context.h"
+#include "scanner.h"
+using namespace std;
+
+//--------------------------------------------------------------------------------------------------
+/// @brief binary token file (.snutok)
+///
+/// Stores a token array together with everything needed to resolve the tokens: the interned
+/// strings in order of their ids and the source text. The file is read back with mmap(); the
+/// tokens are used in place, without copying or re-lexing.
+///
+/// File layout (host byte order, all sections 16-byte aligned):
+///   - header (STokenFileHeader, 64 bytes)
+///   - token array (ntokens x 16 bytes, terminated by tEOF)
+///   - string offsets (nstrings+1 x 4 bytes, relative to the start of the string data)
+///   - string data (strings_size bytes)
+///   - source text (source_size bytes)
+///
+class CTokenFile {
+  public:
+    /// @name construction/destruction
+    /// @{
+
+    /// @brief open and validate a token file
+    ///
+    /// @param filename name of the file
+    /// @retval CTokenFile instance
+    /// @retval NULL if the file cannot be read or is not a valid token file
+    static CTokenFile* Open(const string filename);
+
+    /// @brief destructor
+    ~CTokenFile(void);
+
+    /// @}
+
+    /// @brief write a token array to a token file
+    ///
+    /// @param filename name of the file
+    /// @param ctx context of the tokens (the entire input is loaded)
+    /// @param tokens token array (terminated by tEOF)
+    /// @param ntokens number of tokens
+    /// @retval true on success
+    /// @retval false on error
+    static bool Write(const string filename, CContext *ctx, const CToken *tokens, size_t ntokens);
+
+    /// @brief return the context of the tokens
+    CContext* GetContext(void) const { return _ctx; };
+
+    /// @brief return the token array
+    const CToken* GetTokens(void) const { return _tokens; };
+
+    /// @brief return the number of tokens (including the terminating tEOF)
+    size_t GetNumTokens(void) const { return _ntokens; };
+
+    const static unsigned int VERSION = 1; ///< version of the file format
+
+  private:
+    /// @brief constructor
+    ///
+    /// @param map mapped file
+    /// @param size size of the mapped file
+    CTokenFile(void *map, size_t size);
+
+    /// @brief validate the contents of the file and set up the context
+    ///
+    /// @retval true if the file is a valid token file
+    bool Load(void);
+
+    void        *_map;              ///< mapped file
+    size_t       _size;             ///< size of the mapped file
+    CContext    *_ctx;              ///< context (source text and interned strings)
+    const CToken *_tokens;          ///< token array (in the mapped file)
+    size_t       _ntokens;          ///< number of tokens
+};
+
+
+#endif // __SnuPL_TOKFILE_H__
@@ -34,6 +34,7 @@
 #include <cassert>
 
 #include "type.h"
+#include "context.h"
 #include "environment.h"
 using namespace std;
 
@@ -42,7 +43,7 @@ using namespace std;
 // CType
 //
 CType::CType(const string name)
-  : _name(name)
+  : _name(name), _id(0)
 {
 }
 
@@ -88,6 +89,9 @@ bool CScalarType::Match(const CType *t) const
 {
   // TODO (phase 3)
 
+  // scalar types are unique
+  if (t == this) return true;
+
   return false;
 }
 
@@ -222,6 +226,9 @@ bool CPointerType::Match(const CType *t) const
 {
   // TODO (phase 3)
 
+  // identical types are identical instances
+  if (t == this) return true;
+
   // check whether t is a pointer
   if ((t == NULL) || !t->IsPointer()) return false;
 
@@ -239,6 +246,9 @@ bool CPointerType::Compare(const CType *t) const
 {
   // TODO (phase 3)
 
+  // identical types are identical instances
+  if (t == this) return true;
+
   // check whether t is a pointer
   if ((t == NULL) || !t->IsPointer()) return false;
 
@@ -318,6 +328,9 @@ bool CArrayType::Match(const CType *t) const
 {
   // TODO (phase 3)
 
+  // identical types are identical instances
+  if (t == this) return true;
+
   // check whether t is an array
   if ((t == NULL) || !t->IsArray()) return false;
 
@@ -335,6 +348,9 @@ bool CArrayType::Compare(const CType *t) const
 {
   // TODO (phase 3)
 
+  // identical types are identical instances
+  if (t == this) return true;
+
   // check whether t is an array
   if ((t == NULL) || !t->IsArray()) return false;
 
@@ -365,17 +381,17 @@ ostream& CArrayType::print(ostream &out, int indent) const
 //--------------------------------------------------------------------------------------------------
 // CTypeManager
 //
-CTypeManager* CTypeManager::_global_tm = NULL;
-
 CTypeManager::CTypeManager(void)
-{
-  _null = new CNullType();
-  _boolean = new CBoolType();
-  _char = new CCharType();
-  _integer = new CIntegerType();
-  _longint = new CLongintType();
-  _voidptr = new CPointerType(_null);
+  : _nid(0)
+{
+  _null = Register(new CNullType());
+  _boolean = Register(new CBoolType());
+  _char = Register(new CCharType());
+  _integer = Register(new CIntegerType());
+  _longint = Register(new CLongintType());
+  _voidptr = Register(new CPointerType(_null));
   _ptr.push_back(_voidptr);
+  _types[STypeKey{ tkPointer, 0, _null->GetId() }] = _voidptr;
 
   unsigned int bits = 8*CEnvironment::Get()->GetTarget()->GetMachineWordSize();
   if (bits == 32) _register = _integer;
@@ -398,9 +414,10 @@ CTypeManager::~CTypeManager(void)
 
 CTypeManager* CTypeManager::Get(void)
 {
-  if (_global_tm == NULL) _global_tm = new CTypeManager();
+  CContext *ctx = CContext::Get();
+  assert(ctx != NULL);
 
-  return _global_tm;
+  return ctx->GetTypeManager();
 }
 
 const CNullType* CTypeManager::GetNull(void) const
@@ -440,14 +457,18 @@ const CPointerType* CTypeManager::GetVoidPtr(void) const
 
 const CPointerType* CTypeManager::GetPointer(const CType *basetype)
 {
-  for (size_t i=0; i<_ptr.size(); i++) {
-    if ((_ptr[i]->GetBaseType()->Compare(basetype))) {
-      return _ptr[i];
-    }
-  }
+  if (basetype == NULL) return NULL;
+
+  STypeKey key{ tkPointer, 0, basetype->GetId() };
+
+  lock_guard<mutex> lock(_lock);
+
+  auto it = _types.find(key);
+  if (it != _types.end()) return static_cast<const CPointerType*>(it->second);
 
-  CPointerType *p = new CPointerType(basetype);
+  CPointerType *p = Register(new CPointerType(basetype));
   _ptr.push_back(p);
+  _types[key] = p;
 
   return p;
 }
@@ -457,20 +478,21 @@ const CArrayType* CTypeManager::GetArray(unsigned int nelem,
 {
   if (innertype == NULL) return NULL;
 
-  for (size_t i=0; i<_array.size(); i++) {
-    if ((_array[i]->GetNElem() == nelem) &&
-        (_array[i]->GetInnerType()->Compare(innertype))) {
-      return _array[i];
-    }
-  }
+  STypeKey key{ tkArray, nelem, innertype->GetId() };
+
+  lock_guard<mutex> lock(_lock);
+
+  auto it = _types.find(key);
+  if (it != _types.end()) return static_cast<const CArrayType*>(it->second);
 
   unsigned long long size = innertype->GetDataSize();
   if (nelem != CArrayType::OPEN) size = size * nelem + 8;
   else size = size + 8; // open arrays have a data size of 0
   if (size > CArrayType::MAX_SIZE) return NULL;
 
-  CArrayType *a = new CArrayType(nelem, innertype);
+  CArrayType *a = Register(new CArrayType(nelem, innertype));
   _array.push_back(a);
+  _types[key] = a;
 
   return a;
 }
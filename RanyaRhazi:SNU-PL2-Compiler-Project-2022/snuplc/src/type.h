@@ -35,6 +35,8 @@
 
 #include <climits>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -42,10 +44,13 @@ using namespace std;
 //--------------------------------------------------------------------------------------------------
 /// @brief SnuPL base type
 ///
-/// abstract base type
+/// abstract base type. All types are created and owned by the type manager which hands out
+/// exactly one instance per distinct type. Identical types are thus identical pointers and
+/// have the same canonical id.
 ///
 class CType {
   friend class CArrayType;
+  friend class CTypeManager;
 
   protected:
     /// @brief constructor
@@ -60,6 +65,10 @@ class CType {
     /// @retval string name of type
     virtual string GetName(void) const { return _name; };
 
+    /// @brief get the canonical id of the type (unique per type manager)
+    /// @retval unsigned int type id
+    unsigned int GetId(void) const { return _id; };
+
     /// @brief return @a true for the NULL type, @a false otherwise
     virtual bool IsNull(void) const { return false; };
 
@@ -147,7 +156,7 @@ class CType {
 
   private:
     string         _name;         ///< name
-
+    unsigned int   _id;           ///< canonical id (assigned by the type manager)
 };
 
 /// @name CType output operators
@@ -515,9 +524,9 @@ class CPointerType : public CScalarType {
 /// type for array types
 ///
 class CArrayType : public CType {
-  //friend class CTypeManager;
+  friend class CTypeManager;
 
-  public: // other than scalar base types, CArrayTypes can be instantiated
+  protected:
     /// @brief constructor
     ///
     /// @param nelem    element count
@@ -612,11 +621,15 @@ class CArrayType : public CType {
 //--------------------------------------------------------------------------------------------------
 /// @brief type manager
 ///
-/// manages all types in a module
+/// manages all types in a module. Each compilation context owns its type manager. Composite
+/// types are hash-consed on their kind, element count, and the canonical id of their base or
+/// inner type; requesting a type that already exists returns the existing instance. Composite
+/// types may be requested concurrently (e.g., by subroutine bodies parsed in parallel).
 ///
 class CTypeManager {
+  friend class CContext;
   public:
-    /// @brief return the global type manager
+    /// @brief return the type manager of the context active in the calling thread
     static CTypeManager* Get(void);
 
     /// @name base types
@@ -663,6 +676,32 @@ class CTypeManager {
 
     /// @}
 
+    /// @brief key of a composite type
+    struct STypeKey {
+      unsigned int kind;            ///< kind of type (tkPointer, tkArray)
+      unsigned int nelem;           ///< number of elements (arrays only)
+      unsigned int inner;           ///< canonical id of the base/inner type
+
+      bool operator==(const STypeKey &k) const {
+        return (kind == k.kind) && (nelem == k.nelem) && (inner == k.inner);
+      };
+    };
+
+    /// @brief hash function for STypeKey
+    struct STypeKeyHash {
+      size_t operator()(const STypeKey &k) const {
+        size_t h = ((size_t)k.inner << 1) | k.kind;
+        return (h * 0x9e3779b97f4a7c15ULL) ^ k.nelem;
+      };
+    };
+
+    /// @brief kinds of composite types
+    enum { tkPointer, tkArray };
+
+    /// @brief assign the next canonical id to type @a t
+    template<typename T>
+    T* Register(T *t) { t->_id = _nid++; return t; };
+
     CNullType     *_null;         ///< null base type
     CBoolType     *_boolean;      ///< boolean base type
     CCharType     *_char;         ///< char base type
@@ -671,10 +710,11 @@ class CTypeManager {
     CIntType      *_register;     ///< register base type (CIntegerType or CLongintType)
     CPointerType  *_voidptr;      ///< void pointer type
 
-    vector<CPointerType*> _ptr;   ///< pointer types
-    vector<CArrayType*> _array;   ///< array types
-
-    static CTypeManager *_global_tm; ///< global type manager instance
+    vector<CPointerType*> _ptr;   ///< pointer types (in order of creation)
+    vector<CArrayType*> _array;   ///< array types (in order of creation)
+    unordered_map<STypeKey, const CType*, STypeKeyHash> _types; ///< composite types by key
+    unsigned int   _nid;          ///< next canonical type id
+    mutex          _lock;         ///< protects _ptr, _array, _types, and _nid
 };
 
 
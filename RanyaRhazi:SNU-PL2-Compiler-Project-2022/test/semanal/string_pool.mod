@@ -0,0 +1,33 @@
+//
+// string_pool.mod
+//
+// string literals of a module are pooled (test_semanal -s)
+// - a string that is a suffix of another one shares its storage
+// - identical strings are emitted once, also across procedure bodies
+// - the empty string aliases the terminating NUL of another string
+//
+// expected data section:
+//   _str_1:
+//       .asciz "hello\012"
+//   _str_3:
+//       .asciz "again"
+//       .set _str_5, _str_1 + 6          // ""
+//       .set _str_4, _str_1 + 5          // "\n"
+//       .set _str_2, _str_1 + 3          // "lo\n"
+//
+
+module string_pool;
+
+procedure greet();
+begin
+  WriteStr("hello\n");
+  WriteStr("lo\n");
+  WriteStr("again")
+end greet;
+
+begin
+  WriteStr("\n");
+  WriteStr("again");
+  WriteStr("");
+  greet()
+end string_pool.